@@ -0,0 +1,60 @@
+/* Author: Nathan Burrows
+ * File: FixedBoardSolver.cpp
+ *
+ * The board sizes FixedBoardSolver is built for (see FixedBoardSolver.h).
+ */
+
+#include "FixedBoardSolver.h"
+
+/*
+ * Function: countFixedTourTable()
+ * @desc: Checks a tour table at compile time, and counts its full tours. Every tour has to start on its own square,
+ *        never visit a square twice, and only make knight's moves.
+ * @param: The table, passed by reference
+ * @return: How many of the tours cover the whole board, or -1 if one of them is not a valid path.
+ */
+template<int Rows, int Cols>
+constexpr int countFixedTourTable(const FixedTourTable<Rows, Cols>& table) {
+    int full = 0;
+    for (int start = 0; start < Rows * Cols; start++) {
+        const FixedTour<Rows, Cols>& tour = table.tours[start];
+        if (tour.length < 1 || tour.length > Rows * Cols || tour.squares[0] != start) return -1;
+        bool seen[Rows * Cols] = {};
+        for (int i = 0; i < tour.length; i++) {
+            int square = tour.squares[i];
+            if (seen[square]) return -1;
+            seen[square] = true;
+            if (i == 0) continue;
+            int rows = square / Cols - tour.squares[i - 1] / Cols;
+            int cols = square % Cols - tour.squares[i - 1] % Cols;
+            if (rows * rows + cols * cols != 5) return -1;
+        }
+        full += (tour.length == Rows * Cols) ? 1 : 0;
+    }
+    return full;
+}
+
+//the compiler runs the fixed search from every square of an 8x8 board. Warnsdorff's rule gets stuck once, from row 2,
+//col 4 (after 60 squares, though solve() never asks for it, since it searches the mirror image, col 3, instead), and
+//Roth's tie-break never does.
+static_assert(countFixedTourTable(knightTourTable<8, 8>(Heuristic::Warnsdorff)) == 63, "the 8x8 tour table has changed");
+static_assert(countFixedTourTable(knightTourTable<8, 8>(Heuristic::Roth)) == 64, "the 8x8 Roth tour table has changed");
+
+/*
+ * Function: searchFixedTour()
+ * @desc: Runs the open tour search on a FixedBoardSolver if there is one for the board size. The sizes built in are
+ *        the ones solved most often (8x8, 10x10 and 12x12); any other size returns 0 so the caller can use the generic
+ *        engine. Boards are canonical here, so only one orientation of each size needs building.
+ * @param1/param2: The board's X/Y dimensions
+ * @param3: The knight's starting square
+ * @param4: How ties between equally good moves are broken
+ * @param5: Filled with the tour, as square indexes. It needs room for every square on the board.
+ * @param6: The stats to count the search in, passed by reference
+ * @return: How many squares are in the tour, or 0 if there is no specialisation for the board size.
+ */
+size_t searchFixedTour(int boardX, int boardY, uint32_t start, Heuristic heuristic, uint32_t* tour, SolverStats& stats) {
+    if (boardX == 8 && boardY == 8) return FixedBoardSolver<8, 8>::solve(start, heuristic, tour, stats);
+    if (boardX == 10 && boardY == 10) return FixedBoardSolver<10, 10>::solve(start, heuristic, tour, stats);
+    if (boardX == 12 && boardY == 12) return FixedBoardSolver<12, 12>::solve(start, heuristic, tour, stats);
+    return 0;
+}
@@ -0,0 +1,244 @@
+/* Author: Nathan Burrows
+ * File: FixedBoardSolver.h
+ *
+ * Open tour search specialised for board sizes known when the program is built. The board size is a template
+ * parameter, so the neighbour lists are worked out by the compiler into read-only data, and the search loops have
+ * fixed bounds with no board edges to check. searchFixedTour() picks a specialisation for the board sizes that are
+ * built in, and searchTour() falls back to the generic engine for everything else.
+ *
+ * The search is constexpr too, so on a small board a tour (or a table of the tour from every start) can be worked out
+ * entirely by the compiler, with knightTour() and knightTourTable(), and looking one up costs a memory load.
+ */
+
+#ifndef FIXEDBOARDSOLVER_H
+#define FIXEDBOARDSOLVER_H
+
+#include "KnightTourSolver.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Struct: FixedGeometry
+ * @desc: The Geometry of a board whose size is fixed at compile time. Every square's knight moves are listed in the
+ *        order findMovesFromSquare() finds them, then padded out to 8 with the padding square (Squares), which is always
+ *        treated as visited. That way every square has exactly 8 entries, and the search loop never has to check how
+ *        many moves a square has.
+ *        neighbours = every square's knight moves, then padding
+ *        degrees    = how many moves each square has on an empty board (the padding square has none)
+ */
+template<int Rows, int Cols>
+struct FixedGeometry {
+    static_assert(Rows > 0 && Cols > 0 && Rows * Cols < 65535, "square indexes have to fit in 16 bits");
+    static constexpr int Squares = Rows * Cols;
+    static constexpr int Padding = Squares;
+    uint16_t neighbours[Squares][8] = {};
+    uint8_t degrees[Squares + 1] = {};
+};
+
+/*
+ * Function: buildFixedGeometry()
+ * @desc: Works out a FixedGeometry. This is constexpr, so the tables are built by the compiler.
+ * @return: The geometry.
+ */
+template<int Rows, int Cols>
+constexpr FixedGeometry<Rows, Cols> buildFixedGeometry() {
+    const int dx[] = { 2, 1, -1, -2, -2, -1, 1, 2 };
+    const int dy[] = { 1, 2, 2, 1, -1, -2, -2, -1 };
+    FixedGeometry<Rows, Cols> geometry{};
+    for (int i = 0; i < Rows; i++) {
+        for (int j = 0; j < Cols; j++) {
+            int square = i * Cols + j;
+            int count = 0;
+            for (int k = 0; k < 8; k++) {
+                int newX = i + dx[k];
+                int newY = j + dy[k];
+                if (newX >= 0 && newX < Rows && newY >= 0 && newY < Cols) {
+                    geometry.neighbours[square][count++] = newX * Cols + newY;
+                }
+            }
+            geometry.degrees[square] = count;
+            while (count < 8) {
+                geometry.neighbours[square][count++] = FixedGeometry<Rows, Cols>::Padding;
+            }
+        }
+    }
+    return geometry;
+}
+
+/*
+ * Class: FixedBoardSolver
+ * @desc: makeMove() for a Rows x Cols board. It picks exactly the same moves as makeMove() (the moves are tried in the
+ *        same order and ties are broken the same way), but its tables are compile-time data, all of its state fits on the
+ *        stack, and the usual Warnsdorff move is picked without branching. It can run at compile time as well.
+ */
+template<int Rows, int Cols>
+class FixedBoardSolver {
+public:
+    static constexpr int Squares = FixedGeometry<Rows, Cols>::Squares;
+    //What a visited square is marked with. It is above any number of continuing moves (at most 8) when or-ed with one.
+    static constexpr uint8_t VISITED = 0xF0;
+    static constexpr FixedGeometry<Rows, Cols> geometry = buildFixedGeometry<Rows, Cols>();
+
+    /*
+     * Function: solve()
+     * @desc: Moves the knight around the board until it runs out of moves, like makeMove().
+     * @param1: The knight's starting square
+     * @param2: How ties between equally good moves are broken
+     * @param3: Filled with the tour, as square indexes. It needs room for Squares.
+     * @param4: The stats to count the search in, passed by reference
+     * @return: How many squares are in the tour.
+     */
+    template<typename Square>
+    static constexpr size_t solve(uint32_t start, Heuristic heuristic, Square* tour, SolverStats& stats) {
+        uint8_t visited[Squares + 1] = {};
+        uint8_t degrees[Squares + 1] = {};
+        for (int i = 0; i <= Squares; i++) {
+            degrees[i] = geometry.degrees[i];
+        }
+        visited[FixedGeometry<Rows, Cols>::Padding] = VISITED;
+        SolverStats counted{};
+        size_t length = 0;
+        uint32_t knight = start;
+        while (true) {
+            //visit the square. The padding square's degree wraps round. The Warnsdorff rank below still reads it, but
+            //or-ed with the padding's VISITED mark, which keeps the rank past every unvisited move's whatever the
+            //degree is, and Roth's tie-break only reads the degrees of unvisited squares.
+            visited[knight] = VISITED;
+            tour[length++] = knight;
+            const uint16_t* next = geometry.neighbours[knight];
+            for (int k = 0; k < 8; k++) {
+                degrees[next[k]]--;
+            }
+            if (heuristic == Heuristic::Warnsdorff) {
+                //the first move with the fewest continuing moves, the same one findMinimumIndex() picks. Each move is
+                //ranked on (continuing moves, position in the list), with visited squares pushed past every unvisited
+                //one, so the smallest rank is the move and there are no branches for the CPU to mispredict.
+                unsigned best = ~0u;
+                for (int k = 0; k < 8; k++) {
+                    unsigned square = next[k];
+                    unsigned rank = (unsigned)(degrees[square] | visited[square]) << 3 | k;
+                    best = rank < best ? rank : best;
+                }
+                if ((best >> 3) >= VISITED) break;
+                KT_COUNT(counted, candidates, countCandidates(next, visited));
+                KT_COUNT(counted, ties, countTies(next, degrees, visited, best >> 3));
+                knight = next[best & 7];
+                continue;
+            }
+            //Roth's tie-break, worked out the same way as findFurthestMinimumIndex()
+            int smallest = 9;
+            for (int k = 0; k < 8; k++) {
+                if (visited[next[k]] == 0 && degrees[next[k]] < smallest) smallest = degrees[next[k]];
+            }
+            if (smallest == 9) break;
+            KT_COUNT(counted, candidates, countCandidates(next, visited));
+            KT_COUNT(counted, ties, countTies(next, degrees, visited, smallest));
+            int bestDistance = -1;
+            for (int k = 0; k < 8; k++) {
+                uint32_t square = next[k];
+                if (visited[square] != 0 || degrees[square] != smallest) continue;
+                int x = 2 * (int)(square / Cols) - (Rows - 1);
+                int y = 2 * (int)(square % Cols) - (Cols - 1);
+                if (x * x + y * y > bestDistance) {
+                    bestDistance = x * x + y * y;
+                    knight = square;
+                }
+            }
+        }
+        KT_COUNT(counted, moves, length);
+        KT_COUNT(counted, deadEnds, length < (size_t)Squares ? 1 : 0);
+        KT_ADD_STATS(stats, counted);
+        return length;
+    }
+
+private:
+    /*
+     * Function: countCandidates()
+     * @desc: Counts the unvisited moves from a square, for the stats.
+     * @param1: The square's 8 neighbour entries
+     * @param2: The visited marks
+     * @return: How many of the moves are unvisited.
+     */
+    static constexpr int countCandidates(const uint16_t* next, const uint8_t* visited) {
+        int count = 0;
+        for (int k = 0; k < 8; k++) {
+            count += (visited[next[k]] == 0) ? 1 : 0;
+        }
+        return count;
+    }
+
+    /*
+     * Function: countTies()
+     * @desc: countMinimumTies() for the fixed tables: finds if more than one unvisited move has the fewest continuing moves.
+     * @param1: The square's 8 neighbour entries
+     * @param2: The number of continuing moves from each square
+     * @param3: The visited marks
+     * @param4: The fewest continuing moves any of the moves has
+     * @return: Returns 1 if there is a tie, 0 if not.
+     */
+    static constexpr int countTies(const uint16_t* next, const uint8_t* degrees, const uint8_t* visited, unsigned smallest) {
+        int found = 0;
+        for (int k = 0; k < 8; k++) {
+            found += (visited[next[k]] == 0 && degrees[next[k]] == smallest) ? 1 : 0;
+        }
+        return found > 1 ? 1 : 0;
+    }
+};
+
+/*
+ * Struct: FixedTour
+ * @desc: A tour on a Rows x Cols board, as a plain value so it can be made at compile time. The squares are square
+ *        indexes, in the order they were visited, and only the first length of them are used.
+ */
+template<int Rows, int Cols>
+struct FixedTour {
+    uint16_t squares[Rows * Cols] = {};
+    uint16_t length = 0;
+};
+
+/*
+ * Function: knightTour()
+ * @desc: Finds the open tour from a square with FixedBoardSolver. It is constexpr, so
+ *            constexpr FixedTour<8, 8> tour = knightTour<8, 8>(0);
+ *        is worked out by the compiler and stored as read-only data.
+ * @param1: The knight's starting square (row * Cols + col)
+ * @param2: How ties between equally good moves are broken
+ * @return: The tour.
+ */
+template<int Rows, int Cols>
+constexpr FixedTour<Rows, Cols> knightTour(uint32_t start, Heuristic heuristic = Heuristic::Warnsdorff) {
+    FixedTour<Rows, Cols> tour{};
+    SolverStats stats{};
+    tour.length = FixedBoardSolver<Rows, Cols>::solve(start, heuristic, tour.squares, stats);
+    return tour;
+}
+
+/*
+ * Struct: FixedTourTable
+ * @desc: The tour from every starting square on a Rows x Cols board. tours[s] is the tour starting on square s.
+ */
+template<int Rows, int Cols>
+struct FixedTourTable {
+    FixedTour<Rows, Cols> tours[Rows * Cols] = {};
+};
+
+/*
+ * Function: knightTourTable()
+ * @desc: knightTour() for every starting square. Made constexpr, the whole table ends up in read-only data (8KB for an
+ *        8x8 board), and finding a tour is an array index.
+ * @param: How ties between equally good moves are broken
+ * @return: The table.
+ */
+template<int Rows, int Cols>
+constexpr FixedTourTable<Rows, Cols> knightTourTable(Heuristic heuristic = Heuristic::Warnsdorff) {
+    FixedTourTable<Rows, Cols> table{};
+    for (int i = 0; i < Rows * Cols; i++) {
+        table.tours[i] = knightTour<Rows, Cols>(i, heuristic);
+    }
+    return table;
+}
+
+size_t searchFixedTour(int boardX, int boardY, uint32_t start, Heuristic heuristic, uint32_t* tour, SolverStats& stats);
+
+#endif
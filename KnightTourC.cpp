@@ -0,0 +1,224 @@
+/* Author: Nathan Burrows
+ * File: KnightTourC.cpp
+ *
+ * The C interface to the solver (see KnightTourC.h). Every function catches everything, since no exception can be
+ * allowed to cross into a caller that is not C++.
+ */
+
+#include "KnightTourC.h"
+#include "KnightTourSolver.h"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <vector>
+
+//The longest board side accepted, and the most squares. The engine works out square indexes (row * cols + col) in int,
+//so a board has to have fewer squares than an int can count.
+const int32_t MAX_C_BOARD_SIZE = 65535;
+const int64_t MAX_C_BOARD_SQUARES = (int64_t)INT32_MAX - 1;
+
+/*
+ * Struct: KnightTourHandle
+ * @desc: What sits behind the opaque handle: the solver, the space it solves into when the caller asked for move
+ *        numbers, and the stats.
+ */
+struct KnightTourHandle {
+    KnightTourSolver solver;
+    std::vector<uint32_t> tour;
+    KnightTourStats stats = {};
+};
+
+/*
+ * Function: readOptions()
+ * @desc: Turns the C options into SolveOptions, checking every value is one the solver knows.
+ * @param1: The C options, or nullptr for the defaults
+ * @param2: Set to the options, passed by reference
+ * @return: Returns true if the options are valid, false if not.
+ */
+bool readOptions(const KnightTourOptions* options, SolveOptions& solveOptions) {
+    solveOptions = SolveOptions();
+    if (options == nullptr) return true;
+    if (options->algorithm != KNIGHT_TOUR_ALGORITHM_WARNSDORFF && options->algorithm != KNIGHT_TOUR_ALGORITHM_TRANSFER
+        && options->algorithm != KNIGHT_TOUR_ALGORITHM_LDS) return false;
+    if (options->heuristic != KNIGHT_TOUR_HEURISTIC_WARNSDORFF && options->heuristic != KNIGHT_TOUR_HEURISTIC_ROTH) return false;
+    solveOptions.algorithm = Algorithm::Warnsdorff;
+    if (options->algorithm == KNIGHT_TOUR_ALGORITHM_TRANSFER) solveOptions.algorithm = Algorithm::TransferMatrix;
+    if (options->algorithm == KNIGHT_TOUR_ALGORITHM_LDS) solveOptions.algorithm = Algorithm::LimitedDiscrepancy;
+    solveOptions.heuristic = (options->heuristic == KNIGHT_TOUR_HEURISTIC_ROTH) ? Heuristic::Roth : Heuristic::Warnsdorff;
+    solveOptions.closed = options->closed != 0;
+    return true;
+}
+
+/*
+ * Function: checkProblem()
+ * @desc: Checks the arguments every solve takes.
+ * @param1: The handle
+ * @param2/param3: The board's rows/cols
+ * @param4/param5: The knight's starting row/col (indexed from 0)
+ * @param6/param7: The caller's buffer, and how many uint32_t it has room for
+ * @return: 0 if they are fine, or one of the KNIGHT_TOUR_ERROR_ values.
+ */
+int checkProblem(const KnightTourHandle* handle, int32_t rows, int32_t cols, int32_t startRow, int32_t startCol,
+                 const uint32_t* buffer, size_t capacity) {
+    if (handle == nullptr || buffer == nullptr || rows < 1 || cols < 1 || rows > MAX_C_BOARD_SIZE || cols > MAX_C_BOARD_SIZE
+        || (int64_t)rows * cols > MAX_C_BOARD_SQUARES || startRow < 0 || startRow >= rows || startCol < 0 || startCol >= cols) {
+        return KNIGHT_TOUR_ERROR_ARGUMENT;
+    }
+    return (capacity < (uint64_t)rows * cols) ? KNIGHT_TOUR_ERROR_BUFFER : 0;
+}
+
+/*
+ * Function: solveInto()
+ * @desc: The shared part of knightTourSolve() and knightTourSolveTour(): sets the board, solves the problem into the
+ *        buffer given, and keeps the stats. The arguments have already been checked.
+ * @param1: The handle
+ * @param2/param3: The board's rows/cols
+ * @param4/param5: The knight's starting row/col (indexed from 0)
+ * @param6: The buffer to solve into, with room for rows * cols squares
+ * @return: The length of the tour.
+ */
+int64_t solveInto(KnightTourHandle* handle, int32_t rows, int32_t cols, int32_t startRow, int32_t startCol, uint32_t* tour) {
+    std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+    handle->solver.setGeometry(rows, cols);
+    size_t length = handle->solver.solve(startRow, startCol, tour);
+    std::chrono::steady_clock::duration taken = std::chrono::steady_clock::now() - began;
+
+    KnightTourStats& stats = handle->stats;
+    stats.solves++;
+    stats.impossible += handle->solver.impossible() ? 1 : 0;
+    //a problem ruled out returns just its start, which is the whole board on 1x1
+    stats.complete += (!handle->solver.impossible() && length == handle->solver.squares()) ? 1 : 0;
+    stats.closed += handle->solver.closed() ? 1 : 0;
+    stats.squares += length;
+    stats.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(taken).count();
+    stats.lastLength = length;
+    stats.lastClosed = handle->solver.closed() ? 1 : 0;
+    stats.lastImpossible = handle->solver.impossible() ? 1 : 0;
+    return length;
+}
+
+/*
+ * Function: knightTourAbiVersion()
+ * @desc: Says which version of KnightTourC.h the library was built from, so callers can check it matches theirs.
+ * @return: KNIGHT_TOUR_ABI_VERSION.
+ */
+uint32_t knightTourAbiVersion(void) {
+    return KNIGHT_TOUR_ABI_VERSION;
+}
+
+/*
+ * Function: knightTourCreate()
+ * @desc: Makes a new solver.
+ * @param: The options to solve with, or NULL for the defaults (an open tour with Warnsdorff's tie-break)
+ * @return: The handle, or NULL if the options are not valid or it could not be allocated.
+ */
+KnightTourHandle* knightTourCreate(const KnightTourOptions* options) {
+    SolveOptions solveOptions;
+    if (!readOptions(options, solveOptions)) return nullptr;
+    KnightTourHandle* handle = new (std::nothrow) KnightTourHandle();
+    if (handle == nullptr) return nullptr;
+    handle->solver.setOptions(solveOptions);
+    return handle;
+}
+
+/*
+ * Function: knightTourDestroy()
+ * @desc: Frees a solver made by knightTourCreate(). NULL is ignored.
+ * @param: The handle
+ */
+void knightTourDestroy(KnightTourHandle* handle) {
+    delete handle;
+}
+
+/*
+ * Function: knightTourSetOptions()
+ * @desc: Changes how the next solves search.
+ * @param1: The handle
+ * @param2: The options, or NULL for the defaults
+ * @return: 0 if they were set, KNIGHT_TOUR_ERROR_ARGUMENT if not.
+ */
+int knightTourSetOptions(KnightTourHandle* handle, const KnightTourOptions* options) {
+    SolveOptions solveOptions;
+    if (handle == nullptr || !readOptions(options, solveOptions)) return KNIGHT_TOUR_ERROR_ARGUMENT;
+    handle->solver.setOptions(solveOptions);
+    return 0;
+}
+
+/*
+ * Function: knightTourSolve()
+ * @desc: Solves a problem into a board of move numbers: moveNumbers[row * cols + col] is the move the knight landed on
+ *        that square (the start is 1), or 0 if it never got there. This is the same layout as the "final" output format.
+ * @param1: The handle
+ * @param2/param3: The board's rows/cols
+ * @param4/param5: The knight's starting row/col (indexed from 0)
+ * @param6: The caller's buffer, filled with the move numbers
+ * @param7: How many uint32_t the buffer has room for (at least rows * cols)
+ * @return: How many squares the tour covers, or one of the KNIGHT_TOUR_ERROR_ values.
+ */
+int64_t knightTourSolve(KnightTourHandle* handle, int32_t rows, int32_t cols, int32_t startRow, int32_t startCol,
+                        uint32_t* moveNumbers, size_t capacity) {
+    try {
+        int error = checkProblem(handle, rows, cols, startRow, startCol, moveNumbers, capacity);
+        if (error != 0) return error;
+        if (handle->tour.size() < (size_t)rows * cols) handle->tour.resize((size_t)rows * cols);
+        int64_t length = solveInto(handle, rows, cols, startRow, startCol, handle->tour.data());
+        memset(moveNumbers, 0, (size_t)rows * cols * sizeof(uint32_t));
+        for (int64_t i = 0; i < length; i++) {
+            moveNumbers[handle->tour[i]] = i + 1;
+        }
+        return length;
+    }
+    catch (...) {
+        return KNIGHT_TOUR_ERROR_INTERNAL;
+    }
+}
+
+/*
+ * Function: knightTourSolveTour()
+ * @desc: Solves a problem into a list of squares in the order the knight visited them. The solver writes straight
+ *        into the caller's buffer, so this is the cheapest way to get a tour out.
+ * @param1: The handle
+ * @param2/param3: The board's rows/cols
+ * @param4/param5: The knight's starting row/col (indexed from 0)
+ * @param6: The caller's buffer, filled with the tour
+ * @param7: How many uint32_t the buffer has room for (at least rows * cols)
+ * @return: How many squares are in the tour, or one of the KNIGHT_TOUR_ERROR_ values.
+ */
+int64_t knightTourSolveTour(KnightTourHandle* handle, int32_t rows, int32_t cols, int32_t startRow, int32_t startCol,
+                            uint32_t* tour, size_t capacity) {
+    try {
+        int error = checkProblem(handle, rows, cols, startRow, startCol, tour, capacity);
+        if (error != 0) return error;
+        return solveInto(handle, rows, cols, startRow, startCol, tour);
+    }
+    catch (...) {
+        return KNIGHT_TOUR_ERROR_INTERNAL;
+    }
+}
+
+/*
+ * Function: knightTourGetStats()
+ * @desc: Copies out a handle's stats. The caller says how big its KnightTourStats is, so fields added in later
+ *        versions never overrun a buffer from an older caller.
+ * @param1: The handle
+ * @param2: Filled with the stats
+ * @param3: sizeof(KnightTourStats) as the caller sees it
+ * @return: 0 if the stats were copied, KNIGHT_TOUR_ERROR_ARGUMENT if not.
+ */
+int knightTourGetStats(const KnightTourHandle* handle, KnightTourStats* stats, size_t statsSize) {
+    if (handle == nullptr || stats == nullptr) return KNIGHT_TOUR_ERROR_ARGUMENT;
+    memcpy(stats, &handle->stats, statsSize < sizeof(KnightTourStats) ? statsSize : sizeof(KnightTourStats));
+    return 0;
+}
+
+/*
+ * Function: knightTourImpossibleReason()
+ * @desc: Says why the last problem was ruled out (see findImpossibility()). The string is static, so it never needs
+ *        freeing and stays valid after the handle is destroyed.
+ * @param: The handle
+ * @return: The reason, or NULL if the last problem was not ruled out.
+ */
+const char* knightTourImpossibleReason(const KnightTourHandle* handle) {
+    return handle == nullptr ? nullptr : handle->solver.impossibleReason();
+}
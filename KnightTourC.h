@@ -0,0 +1,104 @@
+/* Author: Nathan Burrows
+ * File: KnightTourC.h
+ *
+ * A C interface to the solver, for callers that are not C++ (Java through JNI or Panama, Python through ctypes, and so
+ * on). Everything is plain C types, the solver lives behind an opaque handle, and tours are written straight into
+ * buffers the caller owns, so nothing has to be serialised or copied across the boundary.
+ *
+ * Squares are numbered row * cols + col, with rows and columns indexed from 0. A board can have sides of up to 65535,
+ * and fewer than 2^31 - 1 squares (anything bigger is a KNIGHT_TOUR_ERROR_ARGUMENT). No function here throws or keeps a
+ * pointer to a caller's buffer after it returns. A handle must only be used by one thread at a time, but any number of
+ * handles can be used at once.
+ */
+
+#ifndef KNIGHTTOURC_H
+#define KNIGHTTOURC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define KNIGHT_TOUR_API __declspec(dllexport)
+#else
+#define KNIGHT_TOUR_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Bumped whenever a change breaks callers built against an older version of this header.
+#define KNIGHT_TOUR_ABI_VERSION 1
+
+//The values of KnightTourOptions.algorithm and KnightTourOptions.heuristic (see Algorithm and Heuristic).
+#define KNIGHT_TOUR_ALGORITHM_WARNSDORFF 0
+#define KNIGHT_TOUR_ALGORITHM_TRANSFER 1
+#define KNIGHT_TOUR_ALGORITHM_LDS 2
+#define KNIGHT_TOUR_HEURISTIC_WARNSDORFF 0
+#define KNIGHT_TOUR_HEURISTIC_ROTH 1
+
+//The errors the solve functions return (as negative numbers, so they never clash with a tour length).
+#define KNIGHT_TOUR_ERROR_ARGUMENT -1
+#define KNIGHT_TOUR_ERROR_BUFFER -2
+#define KNIGHT_TOUR_ERROR_INTERNAL -3
+
+/*
+ * Struct: KnightTourHandle
+ * @desc: A solver, with everything it needs to solve without allocating once it has been used on a board size.
+ */
+typedef struct KnightTourHandle KnightTourHandle;
+
+/*
+ * Struct: KnightTourOptions
+ * @desc: How tours are searched for (see SolveOptions). closed is 0 for an open tour, anything else for a closed one.
+ */
+typedef struct KnightTourOptions {
+    int32_t algorithm;
+    int32_t heuristic;
+    int32_t closed;
+} KnightTourOptions;
+
+/*
+ * Struct: KnightTourStats
+ * @desc: What a handle has done since it was created.
+ *        solves         = how many solves finished without an error
+ *        impossible     = how many of them were ruled out by the existence oracle
+ *        complete       = how many found a tour over the whole board (a problem ruled out never counts)
+ *        closed         = how many of those were closed tours
+ *        squares        = the total length of every tour returned
+ *        nanoseconds    = the total time spent solving
+ *        lastLength     = the length of the last tour returned
+ *        lastClosed     = 1 if the last tour was closed, 0 if not
+ *        lastImpossible = 1 if the last problem was ruled out, 0 if not
+ */
+typedef struct KnightTourStats {
+    uint64_t solves;
+    uint64_t impossible;
+    uint64_t complete;
+    uint64_t closed;
+    uint64_t squares;
+    uint64_t nanoseconds;
+    uint64_t lastLength;
+    int32_t lastClosed;
+    int32_t lastImpossible;
+} KnightTourStats;
+
+KNIGHT_TOUR_API uint32_t knightTourAbiVersion(void);
+
+KNIGHT_TOUR_API KnightTourHandle* knightTourCreate(const KnightTourOptions* options);
+KNIGHT_TOUR_API void knightTourDestroy(KnightTourHandle* handle);
+KNIGHT_TOUR_API int knightTourSetOptions(KnightTourHandle* handle, const KnightTourOptions* options);
+
+KNIGHT_TOUR_API int64_t knightTourSolve(KnightTourHandle* handle, int32_t rows, int32_t cols, int32_t startRow, int32_t startCol,
+                                        uint32_t* moveNumbers, size_t capacity);
+KNIGHT_TOUR_API int64_t knightTourSolveTour(KnightTourHandle* handle, int32_t rows, int32_t cols, int32_t startRow, int32_t startCol,
+                                            uint32_t* tour, size_t capacity);
+
+KNIGHT_TOUR_API int knightTourGetStats(const KnightTourHandle* handle, KnightTourStats* stats, size_t statsSize);
+KNIGHT_TOUR_API const char* knightTourImpossibleReason(const KnightTourHandle* handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
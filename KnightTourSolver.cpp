@@ -0,0 +1,1677 @@
+/* Author: Nathan Burrows
+ * File: KnightTourSolver.cpp
+ *
+ * The Knight Tour engine: the searches, board symmetries, shared board geometry, the existence oracle and the
+ * KnightTourSolver class that ties them together (see KnightTourSolver.h).
+ */
+
+#include "KnightTourSolver.h"
+#include "TourStore.h"
+#include "FixedBoardSolver.h"
+#include "Trace.h"
+#include "LatencyHistogram.h"
+#include "TransferMatrix.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+/*
+ * Function: findMinimumIndex()
+ * @desc: Takes in an array of integers, and finds the index of the smallest one (the first one, if there is a tie).
+ * @param1: The array
+ * @param2: How many integers are in it
+ * @return: Returns the smallest index.
+ */
+int findMinimumIndex(const int* sizes, int count) {
+    int index = 0;
+    int smallest = sizes[0];
+    for (int i = 1; i < count; i++) {
+        if (sizes[i] < smallest) {
+            smallest = sizes[i];
+            index = i;
+        }
+    }
+    return index;
+}
+
+/*
+ * Function: countMinimumTies()
+ * @desc: Finds if more than one integer in an array shares the smallest value, i.e. if findMinimumIndex() had a tie to
+ *        break. Only used for the stats.
+ * @param1: The array
+ * @param2: How many integers are in it
+ * @param3: The smallest value, as already found by findMinimumIndex()
+ * @return: Returns 1 if there is a tie, 0 if not.
+ */
+int countMinimumTies(const int* sizes, int count, int smallest) {
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        found += (sizes[i] == smallest) ? 1 : 0;
+    }
+    return found > 1 ? 1 : 0;
+}
+
+/*
+ * Function: findFurthestMinimumIndex()
+ * @desc: Like findMinimumIndex(), but ties are broken by picking the move furthest from the centre of the board
+ *        (Roth's tie-break). The distances are worked out in doubled co-ords so they stay whole numbers.
+ * @param1: The number of continuing moves for each move
+ * @param2: The moves themselves, as square indexes (row * boardY + col)
+ * @param3: How many moves there are
+ * @param4/param5: Board dimensions (X/Y)
+ * @return: Returns the index of the chosen move.
+ */
+int findFurthestMinimumIndex(const int* sizes, const uint32_t* moves, int count, int boardX, int boardY) {
+    int index = -1;
+    int bestDistance = 0;
+    int smallest = sizes[findMinimumIndex(sizes, count)];
+    for (int i = 0; i < count; i++) {
+        if (sizes[i] != smallest) continue;
+        int x = 2 * (int)(moves[i] / boardY) - (boardX - 1);
+        int y = 2 * (int)(moves[i] % boardY) - (boardY - 1);
+        int distance = x * x + y * y;
+        if (index < 0 || distance > bestDistance) {
+            bestDistance = distance;
+            index = i;
+        }
+    }
+    return index;
+}
+
+/*
+ * Function: isOnBoard()
+ * @desc: A helper function that finds if an X,Y co-ord is a move that will be on the chessboard.
+ * @param1/param2: X/Y co-ords of a potential move
+ * @param3/param4: Board dimensions (X/Y)
+ * @return: Returns true if move fits on the chessboard, false if not.
+ */
+bool isOnBoard(int x, int y, int boardX, int boardY) {
+    return ((x >= 0) && (boardX > x) && (y >= 0) && (boardY > y));
+}
+
+/*
+ * Function: findMovesFromSquare()
+ * @desc: This function takes in a square location, and finds all potential legal moves for the knight if it was placed there.
+ * @param1/param2: X/Y co-ords of the knight's location
+ * @param3/param4: Board dimensions (X/Y)
+ * @param5: The chessboard, passed by reference
+ * @return: Returns a vector array of int pairs. These are all the knights legal next moves (as X/Y co-ords)
+ *
+ */
+std::vector<std::pair<int,int>> findMovesFromSquare(int x, int y, int boardX, int boardY, std::vector<std::vector<int>>& Board) {
+    std::vector<std::pair<int,int>> moveArray;
+    int dx[] = { 2, 1, -1, -2, -2, -1, 1, 2 };
+    int dy[] = { 1, 2, 2, 1, -1, -2, -2, -1 };
+    for (int i = 0; i < 8; i++) {
+        int newX = x + dx[i];
+        int newY = y + dy[i];
+        if (isOnBoard(newX, newY, boardX, boardY) && Board[newX][newY] != 2) {
+            moveArray.push_back(std::pair<int, int>(newX, newY));
+        }
+    }
+    return moveArray;
+}
+
+/*
+ * Function: applySymmetry()
+ * @desc: Maps a square on the original board onto the transformed board.
+ * @param1: The symmetry to apply
+ * @param2: The square (row/col) on the original board
+ * @param3/param4: The original board's X/Y dimensions
+ * @return: The square on the transformed board.
+ */
+std::pair<int,int> applySymmetry(const Symmetry& symmetry, std::pair<int,int> square, int boardX, int boardY) {
+    int row = symmetry.flipRows ? boardX - 1 - square.first : square.first;
+    int col = symmetry.flipCols ? boardY - 1 - square.second : square.second;
+    return symmetry.transpose ? std::pair<int,int>(col, row) : std::pair<int,int>(row, col);
+}
+
+/*
+ * Function: undoSymmetry()
+ * @desc: The inverse of applySymmetry(). Maps a square on the transformed board back onto the original board.
+ * @param1: The symmetry that was applied
+ * @param2: The square (row/col) on the transformed board
+ * @param3/param4: The original board's X/Y dimensions (not the transformed ones)
+ * @return: The square on the original board.
+ */
+std::pair<int,int> undoSymmetry(const Symmetry& symmetry, std::pair<int,int> square, int boardX, int boardY) {
+    int row = symmetry.transpose ? square.second : square.first;
+    int col = symmetry.transpose ? square.first : square.second;
+    if (symmetry.flipRows) row = boardX - 1 - row;
+    if (symmetry.flipCols) col = boardY - 1 - col;
+    return std::pair<int,int>(row, col);
+}
+
+/*
+ * Function: canonicaliseProblem()
+ * @desc: Picks one representative out of all the problems that are symmetric to this one. The board is transposed if
+ *        needed so it never has more rows than columns, then out of the symmetries that keep that shape (8 for a square
+ *        board, 4 otherwise), the one that moves the start to the smallest row (then smallest column) is chosen. Every
+ *        problem in a symmetry class canonicalises to the same thing, so they can all share one solve.
+ * @param1/param2: The board's X/Y dimensions
+ * @param3: The knight's starting square
+ * @return: The canonical problem, including the symmetry used.
+ */
+CanonicalProblem canonicaliseProblem(int boardX, int boardY, std::pair<int,int> start) {
+    CanonicalProblem best;
+    bool found = false;
+    for (int i = 0; i < 8; i++) {
+        Symmetry symmetry;
+        symmetry.flipRows = (i & 1) != 0;
+        symmetry.flipCols = (i & 2) != 0;
+        symmetry.transpose = (i & 4) != 0;
+        int newX = symmetry.transpose ? boardY : boardX;
+        int newY = symmetry.transpose ? boardX : boardY;
+        if (newX > newY) continue;
+        std::pair<int,int> newStart = applySymmetry(symmetry, start, boardX, boardY);
+        if (!found || newStart < best.start) {
+            best.boardX = newX;
+            best.boardY = newY;
+            best.start = newStart;
+            best.symmetry = symmetry;
+            found = true;
+        }
+    }
+    return best;
+}
+
+/*
+ * Function: fundamentalStartSquares()
+ * @desc: Finds the starting squares that are their own canonical representative, i.e. the fundamental domain of the
+ *        board under its symmetries. A sweep over every starting square only needs to solve these; every other start
+ *        is one of them rotated or reflected. For an 8x8 board this is 10 squares instead of 64.
+ * @param1/param2: The board's X/Y dimensions. The board is treated in canonical orientation (fewer rows than columns).
+ * @return: The starting squares of the canonical board that need solving.
+ */
+std::vector<std::pair<int,int>> fundamentalStartSquares(int boardX, int boardY) {
+    if (boardX > boardY) std::swap(boardX, boardY);
+    std::vector<std::pair<int,int>> squares;
+    for (int i = 0; i < boardX; i++) {
+        for (int j = 0; j < boardY; j++) {
+            std::pair<int,int> square(i, j);
+            if (canonicaliseProblem(boardX, boardY, square).start == square) {
+                squares.push_back(square);
+            }
+        }
+    }
+    return squares;
+}
+
+/*
+ * Function: buildGeometry()
+ * @desc: Works out the Geometry for a board size. The neighbour lists come straight from findMovesFromSquare() on an
+ *        empty board, so every search that uses them tries moves in exactly the same order as before.
+ * @param1/param2: The board's X/Y dimensions
+ * @return: The geometry.
+ */
+std::shared_ptr<Geometry> buildGeometry(int boardX, int boardY) {
+    TraceScope trace("buildGeometry", "setup", (int64_t)boardX * boardY);
+    std::shared_ptr<Geometry> geometry = std::make_shared<Geometry>();
+    geometry->boardX = boardX;
+    geometry->boardY = boardY;
+    size_t squares = (size_t)boardX * boardY;
+    std::vector<std::vector<int>> Board(boardX, std::vector<int>(boardY));
+    geometry->neighbourStart.reserve(squares + 1);
+    geometry->degrees.reserve(squares);
+    for (int i = 0; i < boardX; i++) {
+        for (int j = 0; j < boardY; j++) {
+            geometry->neighbourStart.push_back(geometry->neighbours.size());
+            std::vector<std::pair<int,int>> moves = findMovesFromSquare(i, j, boardX, boardY, Board);
+            for (std::pair<int,int> move : moves) {
+                geometry->neighbours.push_back(move.first * boardY + move.second);
+            }
+            geometry->degrees.push_back(moves.size());
+        }
+    }
+    geometry->neighbourStart.push_back(geometry->neighbours.size());
+    for (int s = 0; s < 8; s++) {
+        Symmetry symmetry;
+        symmetry.flipRows = (s & 1) != 0;
+        symmetry.flipCols = (s & 2) != 0;
+        symmetry.transpose = (s & 4) != 0;
+        if (symmetry.transpose && boardX != boardY) continue;
+        std::vector<uint32_t> map(squares);
+        for (int i = 0; i < boardX; i++) {
+            for (int j = 0; j < boardY; j++) {
+                std::pair<int,int> square = applySymmetry(symmetry, std::pair<int,int>(i, j), boardX, boardY);
+                map[i * boardY + j] = square.first * boardY + square.second;
+            }
+        }
+        geometry->symmetries.push_back(symmetry);
+        geometry->symmetryMaps.push_back(std::move(map));
+    }
+    if (squares <= (size_t)MAX_BITBOARD_SQUARES) {
+        size_t words = (squares + 63) / 64;
+        geometry->bitboardWords = words;
+        geometry->moveSources.assign(8 * words, 0);
+        for (int move = 0; move < 8; move++) {
+            geometry->moveShifts[move] = (long long)MOVE_DX[move] * boardY + MOVE_DY[move];
+            for (int i = 0; i < boardX; i++) {
+                for (int j = 0; j < boardY; j++) {
+                    if (!isOnBoard(i + MOVE_DX[move], j + MOVE_DY[move], boardX, boardY)) continue;
+                    size_t square = (size_t)i * boardY + j;
+                    geometry->moveSources[move * words + square / 64] |= 1ull << (square % 64);
+                }
+            }
+        }
+    }
+    geometry->bytes = sizeof(Geometry) + (geometry->neighbourStart.size() + geometry->neighbours.size()) * sizeof(uint32_t)
+                      + geometry->degrees.size() + geometry->symmetryMaps.size() * squares * sizeof(uint32_t)
+                      + geometry->moveSources.size() * sizeof(uint64_t);
+    return geometry;
+}
+
+/*
+ * Function: get()
+ * @desc: Finds the geometry for a board size, building it if it is not cached.
+ * @param1/param2: The board's X/Y dimensions
+ * @return: The shared geometry.
+ */
+std::shared_ptr<const Geometry> GeometryCache::get(int boardX, int boardY) {
+    uint64_t key = ((uint64_t)boardX << 32) | (uint32_t)boardY;
+    std::unique_lock<std::mutex> lock(mutex);
+    std::unordered_map<uint64_t, Entry>::iterator found = entries.find(key);
+    if (found != entries.end()) {
+        recent.splice(recent.begin(), recent, found->second.position);
+        std::shared_future<std::shared_ptr<const Geometry>> geometry = found->second.geometry;
+        lock.unlock();
+        return geometry.get();
+    }
+    std::promise<std::shared_ptr<const Geometry>> promise;
+    Entry& entry = entries[key];
+    entry.geometry = promise.get_future().share();
+    recent.push_front(key);
+    entry.position = recent.begin();
+    lock.unlock();
+
+    std::shared_ptr<Geometry> geometry = buildGeometry(boardX, boardY);
+    promise.set_value(geometry);
+
+    lock.lock();
+    std::unordered_map<uint64_t, Entry>::iterator built = entries.find(key);
+    if (built != entries.end()) {
+        built->second.bytes = geometry->bytes;
+        used += geometry->bytes;
+    }
+    //drop the least recently used geometries until it fits, never the one just built
+    while (used > budget && recent.size() > 1) {
+        std::unordered_map<uint64_t, Entry>::iterator oldest = entries.find(recent.back());
+        if (oldest->first == key) break;
+        used -= oldest->second.bytes;
+        entries.erase(oldest);
+        recent.pop_back();
+    }
+    return geometry;
+}
+
+/*
+ * Function: findGeometry()
+ * @desc: Gets the geometry for a board size from the cache shared by the whole process (256MB of geometries at most).
+ * @param1/param2: The board's X/Y dimensions
+ * @return: The shared geometry.
+ */
+std::shared_ptr<const Geometry> findGeometry(int boardX, int boardY) {
+    static GeometryCache cache(256 << 20);
+    return cache.get(boardX, boardY);
+}
+
+/*
+ * Function: resetSearchState()
+ * @desc: Clears a SearchState for a fresh search of a board.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The state, passed by reference
+ */
+void resetSearchState(const Geometry& geometry, SearchState& state) {
+    state.visited.assign(geometry.degrees.size(), 0);
+    state.degrees = geometry.degrees;
+    state.tour.clear();
+    state.holes.clear();
+}
+
+/*
+ * Function: blockSquare()
+ * @desc: Takes a square out of the board, for a search on a board with holes. It is marked visited and taken off its
+ *        neighbours' degrees like visitSquare(), so every search steers round it, but it is not added to the tour.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The state, passed by reference. Only holes should have been added to it since it was reset.
+ * @param3: The square
+ */
+void blockSquare(const Geometry& geometry, SearchState& state, uint32_t square) {
+    if (state.visited[square]) return;
+    state.visited[square] = 1;
+    state.holes.push_back(square);
+    for (uint32_t i = geometry.neighbourStart[square]; i < geometry.neighbourStart[square + 1]; i++) {
+        state.degrees[geometry.neighbours[i]]--;
+    }
+}
+
+/*
+ * Function: countTourSquares()
+ * @desc: Finds how many squares a full tour has: every square on the board except the holes.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The state, passed by reference
+ * @return: The number of squares.
+ */
+size_t countTourSquares(const Geometry& geometry, const SearchState& state) {
+    return geometry.degrees.size() - state.holes.size();
+}
+
+/*
+ * Function: visitSquare()
+ * @desc: Moves the knight onto a square: marks it visited, adds it to the tour, and takes one off the degree of every
+ *        square next to it.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The state, passed by reference
+ * @param3: The square
+ */
+void visitSquare(const Geometry& geometry, SearchState& state, uint32_t square) {
+    state.visited[square] = 1;
+    state.tour.push_back(square);
+    for (uint32_t i = geometry.neighbourStart[square]; i < geometry.neighbourStart[square + 1]; i++) {
+        state.degrees[geometry.neighbours[i]]--;
+    }
+}
+
+/*
+ * Function: unvisitSquare()
+ * @desc: The inverse of visitSquare(), for going back on the last move.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The state, passed by reference
+ */
+void unvisitSquare(const Geometry& geometry, SearchState& state) {
+    uint32_t square = state.tour.back();
+    state.tour.pop_back();
+    state.visited[square] = 0;
+    for (uint32_t i = geometry.neighbourStart[square]; i < geometry.neighbourStart[square + 1]; i++) {
+        state.degrees[geometry.neighbours[i]]++;
+    }
+}
+
+/*
+ * Function: makeMove()
+ * @desc: This is the central function, which moves the knight around the chessboard until it runs out of moves.
+ *        It finds the best legal move. This is the move that has the fewest amount of continuing moves. The legal moves
+ *        come from the shared neighbour lists, and the number of continuing moves for each is read straight out of
+ *        the degrees, which visitSquare() keeps up to date, so nothing is recomputed or allocated per move. The move
+ *        with the least amount is picked (ties are broken by the heuristic), and the knight moves there.
+ *
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference. It should be fresh (see resetSearchState()).
+ * @param3: The knight's starting square
+ * @param4: How ties between equally good moves are broken
+ */
+void makeMove(const Geometry& geometry, SearchState& state, uint32_t start, Heuristic heuristic) {
+    uint32_t moves[8];
+    int sizes[8];
+    //counted locally and added on at the end, so the counts stay in registers instead of going through memory every move
+    SolverStats counted;
+    TraceScope trace("makeMove", "search");
+    LatencyHistogram* latencies = state.moveLatencies;
+    uint64_t moved = (latencies != nullptr) ? readLatencyClock() : 0;
+    visitSquare(geometry, state, start);
+    //while there are moves, loop:
+    while (true) {
+        uint32_t knight = state.tour.back();
+        int count = 0;
+        for (uint32_t i = geometry.neighbourStart[knight]; i < geometry.neighbourStart[knight + 1]; i++) {
+            uint32_t square = geometry.neighbours[i];
+            if (state.visited[square]) continue;
+            moves[count] = square;
+            sizes[count] = state.degrees[square];
+            count++;
+        }
+        if (count == 0) {
+            KT_COUNT(counted, deadEnds, state.tour.size() < countTourSquares(geometry, state) ? 1 : 0);
+            break;
+        }
+        //find the one with the fewest
+        int index = (heuristic == Heuristic::Roth) ? findFurthestMinimumIndex(sizes, moves, count, geometry.boardX, geometry.boardY)
+                                                   : findMinimumIndex(sizes, count);
+        KT_COUNT(counted, candidates, count);
+        KT_COUNT(counted, ties, countMinimumTies(sizes, count, sizes[index]));
+        visitSquare(geometry, state, moves[index]);
+        if (latencies != nullptr) moved = latencies->recordSince(moved);
+    }
+    KT_COUNT(counted, moves, state.tour.size());
+    KT_ADD_STATS(state.stats, counted);
+    trace.setValue(state.tour.size());
+}
+
+//How many positions the closed tour backtracking search may try before it gives up.
+const long long CLOSED_TOUR_NODE_BUDGET = 2000000;
+
+//How many moves the limited discrepancy search may make before it gives up.
+const long long DISCREPANCY_NODE_BUDGET = 2000000;
+
+//How many rotations closeTourByRotation() may make per square on the board before it gives up.
+const long long CLOSED_TOUR_ROTATIONS_PER_SQUARE = 100;
+
+//How many squares closeTourByRotation()'s rotations may reverse in all before it gives up, whatever the board. A
+//rotation can reverse most of the path, so on large boards the rotations alone would take quadratic time.
+const long long CLOSED_TOUR_REVERSAL_BUDGET = 1LL << 28;
+
+//How many knight moves isFloodSplit() spreads its flood fill by before it gives up and lets the path through.
+const int FLOOD_SPLIT_ROUNDS = 64;
+
+//Closed tours of boards with a side longer than this are joined together from smaller blocks (see joinBlockTours()).
+const int BLOCK_TOUR_SIDE = 128;
+
+/*
+ * Function: isKnightMove()
+ * @desc: A helper function that finds if two squares are a knight's move apart.
+ * @param1/param2: The two squares (row/col)
+ * @return: Returns true if a knight can move between them, false if not.
+ */
+bool isKnightMove(std::pair<int,int> a, std::pair<int,int> b) {
+    int rows = std::abs(a.first - b.first);
+    int cols = std::abs(a.second - b.second);
+    return rows * cols == 2;
+}
+
+/*
+ * Function: isNextToSquare()
+ * @desc: isKnightMove() for square indexes.
+ * @param1/param2: The two squares, as square indexes (row * boardY + col)
+ * @param3: The board's Y dimension
+ * @return: Returns true if a knight can move between them, false if not.
+ */
+bool isNextToSquare(uint32_t a, uint32_t b, int boardY) {
+    return isKnightMove(std::pair<int,int>(a / boardY, a % boardY), std::pair<int,int>(b / boardY, b % boardY));
+}
+
+/*
+ * Function: isClosedTour()
+ * @desc: Finds if a tour covers the whole board and ends a knight's move away from where it started.
+ * @param1/param2: The boards X/Y dimensions
+ * @param3: The tour, as square indexes
+ * @param4: How many squares are in the tour
+ * @param5: How many squares a full tour has, if the board has holes (see KnightTourSolver::tourSquares()), or 0 for
+ *          every square of the board
+ * @return: Returns true if the tour is closed, false if not.
+ */
+bool isClosedTour(int boardX, int boardY, const uint32_t* tour, size_t length, size_t squares) {
+    if (squares == 0) squares = (size_t)boardX * boardY;
+    return length == squares && length > 1 && isNextToSquare(tour[0], tour[length - 1], boardY);
+}
+
+/*
+ * Function: isClosedState()
+ * @desc: isClosedTour() for a search state.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The state, passed by reference
+ * @return: Returns true if the state's tour is closed, false if not.
+ */
+bool isClosedState(const Geometry& geometry, const SearchState& state) {
+    return isClosedTour(geometry.boardX, geometry.boardY, state.tour.data(), state.tour.size(), countTourSquares(geometry, state));
+}
+
+/*
+ * Function: findClosedMoveIndex()
+ * @desc: Picks the next move for a closed tour. Moves are ranked on their number of continuing moves like makeMove(),
+ *        then squares next to the start are put last in a tie, since the tour needs one of them left over to finish on.
+ *        A move onto the last unvisited square next to the start is never picked unless it is the final square.
+ * @param1: The number of continuing moves for each move
+ * @param2: The moves themselves, as square indexes
+ * @param3: How many moves there are
+ * @param4: The starting square
+ * @param5: How many unvisited squares are next to the start
+ * @param6: How many squares are still unvisited
+ * @param7/param8: Board dimensions (X/Y)
+ * @param9: How ties are broken after that
+ * @return: Returns the index of the chosen move, or -1 if none of them can be part of a closed tour.
+ */
+int findClosedMoveIndex(const int* sizes, const uint32_t* moves, int count, uint32_t start,
+                        int startLinks, int unvisited, int boardX, int boardY, Heuristic heuristic) {
+    int index = -1;
+    int bestSize = 0;
+    bool bestNearStart = false;
+    int bestDistance = 0;
+    for (int i = 0; i < count; i++) {
+        bool nearStart = isNextToSquare(moves[i], start, boardY);
+        if (nearStart && startLinks == 1 && unvisited > 1) continue;
+        if (sizes[i] == 0 && unvisited > 1) continue;
+        int x = 2 * (int)(moves[i] / boardY) - (boardX - 1);
+        int y = 2 * (int)(moves[i] % boardY) - (boardY - 1);
+        int distance = (heuristic == Heuristic::Roth) ? x * x + y * y : 0;
+        if (index < 0 || sizes[i] < bestSize || (sizes[i] == bestSize && (bestNearStart && !nearStart))
+            || (sizes[i] == bestSize && nearStart == bestNearStart && distance > bestDistance)) {
+            index = i;
+            bestSize = sizes[i];
+            bestNearStart = nearStart;
+            bestDistance = distance;
+        }
+    }
+    return index;
+}
+
+/*
+ * Function: findUnvisitedMoves()
+ * @desc: Lists the unvisited squares a knight's move away from a square, and how many continuing moves each one has.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference
+ * @param3: The square
+ * @param4/param5: Filled with the moves and their continuing moves (room for 8 of each)
+ * @return: How many moves there are.
+ */
+int findUnvisitedMoves(const Geometry& geometry, const SearchState& state, uint32_t square, uint32_t* moves, int* sizes) {
+    int count = 0;
+    for (uint32_t i = geometry.neighbourStart[square]; i < geometry.neighbourStart[square + 1]; i++) {
+        uint32_t next = geometry.neighbours[i];
+        if (state.visited[next]) continue;
+        moves[count] = next;
+        sizes[count] = state.degrees[next];
+        count++;
+    }
+    return count;
+}
+
+/*
+ * Function: makeClosedMove()
+ * @desc: The endpoint-aware version of makeMove(). It works the same way, but the moves are picked with
+ *        findClosedMoveIndex() so the tour keeps a way back to the start. The number of unvisited squares next to the
+ *        start is just the start's degree. It stops when it runs out of moves, the same as makeMove().
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference. Only the starting square should have been visited.
+ * @param3: How ties between equally good moves are broken
+ * @return: Returns true if the tour is closed, false if not.
+ */
+bool makeClosedMove(const Geometry& geometry, SearchState& state, Heuristic heuristic) {
+    uint32_t start = state.tour.front();
+    uint32_t moves[8];
+    int sizes[8];
+    TraceScope trace("makeClosedMove", "search");
+    LatencyHistogram* latencies = state.moveLatencies;
+    uint64_t moved = (latencies != nullptr) ? readLatencyClock() : 0;
+    size_t squares = countTourSquares(geometry, state);
+    while (state.tour.size() < squares) {
+        int unvisited = squares - state.tour.size();
+        int count = findUnvisitedMoves(geometry, state, state.tour.back(), moves, sizes);
+        int index = findClosedMoveIndex(sizes, moves, count, start, state.degrees[start], unvisited, geometry.boardX, geometry.boardY, heuristic);
+        KT_COUNT(state.stats, candidates, count);
+        if (index < 0) {
+            KT_COUNT(state.stats, deadEnds, 1);
+            break;
+        }
+        visitSquare(geometry, state, moves[index]);
+        if (latencies != nullptr) moved = latencies->recordSince(moved);
+    }
+    KT_COUNT(state.stats, moves, state.tour.size());
+    trace.setValue(state.tour.size());
+    return isClosedState(geometry, state);
+}
+
+/*
+ * Function: closeTourByRotation()
+ * @desc: Turns a path that nearly works into a closed tour, using Posa's rotations. If the knight's last square still
+ *        has an unvisited neighbour the path is simply extended onto it. Otherwise, for a square P[i] on the path that is a
+ *        knight's move from the end, the part of the path after P[i] is reversed, which gives a path over the same squares
+ *        ending on P[i+1] instead. Once the path covers the board, rotations carry on until the end is a knight's move
+ *        from the start. Rotations whose new end can be extended (or closed) are preferred, otherwise one is picked at
+ *        random (from a fixed seed, so runs are repeatable). Each rotation costs as much as the part it reverses, and
+ *        closing a large board can take a rotation for every few squares, so there is a budget on squares reversed as
+ *        well as on rotations.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state holding the path, passed by reference. It is rewritten in place, and holds a closed tour
+ *          if this succeeds.
+ * @param3: How many rotations to try before giving up
+ * @param4: How many squares the rotations may reverse in all before giving up
+ * @return: Returns true if the path was turned into a closed tour, false if not.
+ */
+bool closeTourByRotation(const Geometry& geometry, SearchState& state, long long rotationBudget, long long reversalBudget) {
+    TraceScope trace("closeTourByRotation", "restart");
+    std::vector<uint32_t>& tour = state.tour;
+    std::vector<int>& position = state.position;
+    position.assign(geometry.degrees.size(), -1);
+    for (size_t i = 0; i < tour.size(); i++) {
+        position[tour[i]] = i;
+    }
+    unsigned int seed = 12345;
+    size_t squares = countTourSquares(geometry, state);
+    long long reversed = 0;
+    for (long long rotation = 0; rotation < rotationBudget && reversed < reversalBudget; rotation++) {
+        uint32_t end = tour.back();
+        if (tour.size() == squares) {
+            if (isClosedState(geometry, state)) return true;
+        }
+        else if (state.degrees[end] > 0) {
+            for (uint32_t k = geometry.neighbourStart[end]; k < geometry.neighbourStart[end + 1]; k++) {
+                uint32_t next = geometry.neighbours[k];
+                if (state.visited[next]) continue;
+                position[next] = tour.size();
+                visitSquare(geometry, state, next);
+                KT_COUNT(state.stats, moves, 1);
+                break;
+            }
+            continue;
+        }
+        //collect the rotations: squares on the path a knight's move from the end, apart from the one just before it
+        int candidates[8];
+        int candidateCount = 0;
+        int preferred = -1;
+        for (uint32_t k = geometry.neighbourStart[end]; k < geometry.neighbourStart[end + 1]; k++) {
+            int i = position[geometry.neighbours[k]];
+            if (i < 0 || i >= (int)tour.size() - 2) continue;
+            candidates[candidateCount++] = i;
+            uint32_t newEnd = tour[i + 1];
+            bool useful = (tour.size() == squares) ? isNextToSquare(newEnd, tour.front(), geometry.boardY) : state.degrees[newEnd] > 0;
+            if (useful && preferred < 0) preferred = i;
+        }
+        if (candidateCount == 0) {
+            //nothing to rotate around, so try from the other end of the path
+            std::reverse(tour.begin(), tour.end());
+            reversed += tour.size();
+            for (size_t i = 0; i < tour.size(); i++) {
+                position[tour[i]] = i;
+            }
+            continue;
+        }
+        seed = seed * 1103515245u + 12345u;
+        int i = (preferred >= 0) ? preferred : candidates[(seed >> 16) % candidateCount];
+        std::reverse(tour.begin() + i + 1, tour.end());
+        reversed += tour.size() - i - 1;
+        for (size_t j = i + 1; j < tour.size(); j++) {
+            position[tour[j]] = j;
+        }
+    }
+    return false;
+}
+
+/*
+ * Function: findKnightMoveWord()
+ * @desc: Moves a whole bitboard of squares by one knight move at once, and returns one word of the result. The squares
+ *        the move would take off the board are masked out first (see Geometry::moveSources), then the rest are shifted
+ *        across the words by the move's shift.
+ * @param1: The board's geometry, passed by reference. It must have bitboards (bitboardWords > 0).
+ * @param2: The knight move (an index into MOVE_DX/MOVE_DY)
+ * @param3: The squares, as a bitboard
+ * @param4: Which word of the moved bitboard to work out
+ * @return: That word.
+ */
+uint64_t findKnightMoveWord(const Geometry& geometry, int move, const uint64_t* squares, size_t word) {
+    size_t words = geometry.bitboardWords;
+    const uint64_t* sources = geometry.moveSources.data() + move * words;
+    long long shift = geometry.moveShifts[move];
+    auto source = [&](long long i) -> uint64_t {
+        return (i >= 0 && i < (long long)words) ? squares[i] & sources[i] : 0;
+    };
+    long long distance = std::abs(shift);
+    long long whole = distance / 64;
+    int bits = distance % 64;
+    if (shift >= 0) {
+        long long i = (long long)word - whole;
+        return (source(i) << bits) | (bits != 0 ? source(i - 1) >> (64 - bits) : 0);
+    }
+    long long i = (long long)word + whole;
+    return (source(i) >> bits) | (bits != 0 ? source(i + 1) << (64 - bits) : 0);
+}
+
+/*
+ * Function: swapIndexSlots()
+ * @desc: Swaps the squares at two places in a DegreeIndex, keeping their slots up to date.
+ * @param1: The index, passed by reference
+ * @param2/param3: The two places
+ */
+void swapIndexSlots(DegreeIndex& index, uint32_t a, uint32_t b) {
+    uint32_t first = index.squares[a];
+    uint32_t second = index.squares[b];
+    index.squares[a] = second;
+    index.squares[b] = first;
+    index.slot[second] = a;
+    index.slot[first] = b;
+}
+
+/*
+ * Function: buildDegreeIndex()
+ * @desc: Sorts a search state's squares into its DegreeIndex, from its visited squares and degrees.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference
+ */
+void buildDegreeIndex(const Geometry& geometry, SearchState& state) {
+    DegreeIndex& index = state.degreeIndex;
+    size_t squares = geometry.degrees.size();
+    //bucket 0 is the visited squares, and bucket d + 1 the unvisited ones of degree d
+    uint32_t counts[10] = {};
+    for (size_t square = 0; square < squares; square++) {
+        counts[state.visited[square] ? 0 : state.degrees[square] + 1]++;
+    }
+    uint32_t next[10];
+    uint32_t total = 0;
+    for (int bucket = 0; bucket < 10; bucket++) {
+        next[bucket] = total;
+        if (bucket > 0) index.bucketStart[bucket - 1] = total;
+        total += counts[bucket];
+    }
+    index.squares.resize(squares);
+    index.slot.resize(squares);
+    for (size_t square = 0; square < squares; square++) {
+        uint32_t at = next[state.visited[square] ? 0 : state.degrees[square] + 1]++;
+        index.squares[at] = square;
+        index.slot[square] = at;
+    }
+}
+
+/*
+ * Function: visitSearchSquare()
+ * @desc: visitSquare() for the backtracking search, which also keeps its DegreeIndex and (if the board has them) its
+ *        bitboard of unvisited squares up to date. The square is moved down a bucket at a time to the end of the visited
+ *        squares, and each of its unvisited neighbours down one bucket.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The state, passed by reference
+ * @param3: The square
+ */
+void visitSearchSquare(const Geometry& geometry, SearchState& state, uint32_t square) {
+    DegreeIndex& index = state.degreeIndex;
+    for (int degree = state.degrees[square]; degree >= 0; degree--) {
+        swapIndexSlots(index, index.slot[square], index.bucketStart[degree]++);
+    }
+    for (uint32_t i = geometry.neighbourStart[square]; i < geometry.neighbourStart[square + 1]; i++) {
+        uint32_t next = geometry.neighbours[i];
+        if (state.visited[next]) continue;
+        swapIndexSlots(index, index.slot[next], index.bucketStart[state.degrees[next]]++);
+    }
+    visitSquare(geometry, state, square);
+    if (geometry.bitboardWords > 0) state.unvisitedBits[square / 64] &= ~(1ull << (square % 64));
+}
+
+/*
+ * Function: unvisitSearchSquare()
+ * @desc: The inverse of visitSearchSquare(), for going back on the last move.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The state, passed by reference
+ */
+void unvisitSearchSquare(const Geometry& geometry, SearchState& state) {
+    DegreeIndex& index = state.degreeIndex;
+    uint32_t square = state.tour.back();
+    unvisitSquare(geometry, state);
+    for (uint32_t i = geometry.neighbourStart[square]; i < geometry.neighbourStart[square + 1]; i++) {
+        uint32_t next = geometry.neighbours[i];
+        if (state.visited[next]) continue;
+        swapIndexSlots(index, index.slot[next], --index.bucketStart[state.degrees[next]]);
+    }
+    for (int degree = 0; degree <= state.degrees[square]; degree++) {
+        swapIndexSlots(index, index.slot[square], --index.bucketStart[degree]);
+    }
+    if (geometry.bitboardWords > 0) state.unvisitedBits[square / 64] |= 1ull << (square % 64);
+}
+
+/*
+ * Function: isCutApart()
+ * @desc: The full version of isDeadPath()'s check that the unvisited squares have not split apart, which also finds
+ *        the squares they would split apart without (articulation points), with Tarjan's depth first search. The rest
+ *        of the tour is a path through the unvisited squares, so it passes through such a square once, and can only
+ *        cover two of the pieces it holds together: the one before it and the one after it. More than two, and the
+ *        path would have to go back through it. With exactly two, one of them has to have the path's first square (next
+ *        to the knight) and the other its last (next to the start). A knight move whose removal would split the squares
+ *        (a bridge) is covered too, since either it leads to a square with one neighbour, which the degree check
+ *        catches, or both its ends are articulation points. This matters most on boards with holes, whose squares can
+ *        hang together by a single square anywhere, and not just next to where the knight has been.
+ *        The search runs on a stack of its own (see CutFrame), since the unvisited squares can be thousands deep. It
+ *        starts from scratch each time, so it costs a walk over the unvisited squares, which is why searchClosedTour()
+ *        only runs it where a search that big has just failed.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference. Its cutOrder and cutNear must be all zero (they are left that way),
+ *          and cutLow sized for the board.
+ * @return: Returns true if the unvisited squares are split apart, or held together by a square in a way no path can
+ *          get through, false if not.
+ */
+bool isCutApart(const Geometry& geometry, SearchState& state) {
+    uint32_t start = state.tour.front();
+    uint32_t knight = state.tour.back();
+    const DegreeIndex& index = state.degreeIndex;
+    size_t unvisited = countTourSquares(geometry, state) - state.tour.size();
+    std::vector<uint32_t>& order = state.cutOrder;
+    std::vector<uint32_t>& low = state.cutLow;
+    std::vector<CutFrame>& stack = state.cutStack;
+    //the pieces have to hold the path's ends between them: one with a square next to the knight, the other next to the start
+    auto canJoin = [](int first, int second) {
+        return ((first & 1) && (second & 2)) || ((second & 1) && (first & 2));
+    };
+    //marks the unvisited squares next to the knight (bit 0) and the start (bit 1) in cutNear
+    std::vector<uint8_t>& near = state.cutNear;
+    uint32_t allKnight = 0;
+    uint32_t allStart = 0;
+    for (uint32_t i = geometry.neighbourStart[knight]; i < geometry.neighbourStart[knight + 1]; i++) {
+        uint32_t next = geometry.neighbours[i];
+        if (state.visited[next]) continue;
+        near[next] |= 1;
+        allKnight++;
+    }
+    for (uint32_t i = geometry.neighbourStart[start]; i < geometry.neighbourStart[start + 1]; i++) {
+        uint32_t next = geometry.neighbours[i];
+        if (state.visited[next]) continue;
+        near[next] |= 2;
+        allStart++;
+    }
+
+    uint32_t reached = 0;
+    uint32_t seenKnight = 0;
+    uint32_t seenStart = 0;
+    bool dead = false;
+    auto enter = [&](uint32_t square, uint32_t parent) {
+        order[square] = ++reached;
+        low[square] = reached;
+        stack.push_back({ square, parent, geometry.neighbourStart[square], seenKnight, seenStart, 0, { 0, 0 }, 0, 0 });
+        seenKnight += near[square] & 1;
+        seenStart += near[square] >> 1;
+    };
+    uint32_t root = index.squares[index.bucketStart[0]];
+    stack.clear();
+    enter(root, root);
+    while (!stack.empty() && !dead) {
+        CutFrame& frame = stack.back();
+        uint32_t square = frame.square;
+        if (frame.next < geometry.neighbourStart[square + 1]) {
+            uint32_t next = geometry.neighbours[frame.next++];
+            if (state.visited[next]) continue;
+            if (order[next] == 0) enter(next, square);
+            else if (next != frame.parent) low[square] = std::min(low[square], order[next]);
+            continue;
+        }
+        //every square reachable through this one has been reached, so its pieces are all known
+        CutFrame done = frame;
+        stack.pop_back();
+        if (square != root && done.pieces > 0) {
+            //the rest of the squares, on the root's side, are one more piece
+            int rest = ((allKnight - done.cutKnight - (near[square] & 1)) > 0 ? 1 : 0)
+                       | ((allStart - done.cutStart - (near[square] >> 1)) > 0 ? 2 : 0);
+            dead = done.pieces > 1 || !canJoin(done.ends[0], rest);
+        }
+        else if (square == root && done.pieces > 1) {
+            dead = done.pieces > 2 || !canJoin(done.ends[0], done.ends[1]);
+        }
+        if (stack.empty()) break;
+        CutFrame& parent = stack.back();
+        low[parent.square] = std::min(low[parent.square], low[square]);
+        if (low[square] >= order[parent.square]) {
+            //nothing below this square reaches above its parent, so they are a piece of their own without the parent
+            uint32_t pieceKnight = seenKnight - done.nearKnight;
+            uint32_t pieceStart = seenStart - done.nearStart;
+            if (parent.pieces < 2) parent.ends[parent.pieces] = (pieceKnight > 0 ? 1 : 0) | (pieceStart > 0 ? 2 : 0);
+            parent.pieces++;
+            parent.cutKnight += pieceKnight;
+            parent.cutStart += pieceStart;
+        }
+    }
+    dead = dead || reached < unvisited;
+    //only unvisited squares can have been reached or marked
+    for (size_t i = index.bucketStart[0]; i < index.squares.size(); i++) {
+        order[index.squares[i]] = 0;
+        near[index.squares[i]] = 0;
+    }
+    return dead;
+}
+
+/*
+ * Function: isFloodSplit()
+ * @desc: isDeadPath()'s quick check that the unvisited squares have not split apart, on boards with bitboards. The
+ *        search only moves onto a square while they are in one piece (a full board starts that way, since a board with
+ *        a closed tour never splits when one square is taken out), so they can only have split if the square the knight
+ *        just took was holding its unvisited neighbours together. That is checked with a flood fill from one of those
+ *        neighbours, over the unvisited squares, one knight move in every direction at a time, until it has reached the
+ *        others or cannot spread any further. It only looks at the words of the bitboard it could have reached by then,
+ *        so when the neighbours meet up nearby (as they nearly always do) it costs a few words, not the whole board. On a
+ *        long narrow board they can be hundreds of moves apart, so it stops after FLOOD_SPLIT_ROUNDS and lets the path
+ *        through unchecked.
+ * @param1: The board's geometry, passed by reference. It must have bitboards (bitboardWords > 0).
+ * @param2: The search state, passed by reference. Its unvisitedBits must be up to date, and its floodBits all zero
+ *          (they are left that way).
+ * @return: Returns true if the knight's square split the unvisited squares apart, false if not (or if it gave up).
+ */
+bool isFloodSplit(const Geometry& geometry, SearchState& state) {
+    size_t words = geometry.bitboardWords;
+    uint32_t square = state.tour.back();
+    const uint64_t* open = state.unvisitedBits.data();
+    uint32_t targets[8];
+    int targetCount = 0;
+    for (uint32_t i = geometry.neighbourStart[square]; i < geometry.neighbourStart[square + 1]; i++) {
+        if (!state.visited[geometry.neighbours[i]]) targets[targetCount++] = geometry.neighbours[i];
+    }
+    if (targetCount < 2) return false;
+    uint64_t* flood = state.floodBits.data();
+    uint64_t* spread = flood + words;
+    size_t low = targets[0] / 64;
+    size_t high = low;
+    flood[low] = 1ull << (targets[0] % 64);
+    //how many words a knight move can shift a bit by
+    size_t reach = (2 * geometry.boardY + 2) / 64 + 1;
+    bool split = false;
+    for (int round = 0; round < FLOOD_SPLIT_ROUNDS; round++) {
+        size_t first = low > reach ? low - reach : 0;
+        size_t last = std::min(high + reach, words - 1);
+        for (size_t w = first; w <= last; w++) {
+            uint64_t bits = flood[w];
+            for (int move = 0; move < 8; move++) {
+                bits |= findKnightMoveWord(geometry, move, flood, w);
+            }
+            spread[w] = bits & open[w];
+        }
+        bool grew = false;
+        for (size_t w = first; w <= last; w++) {
+            if (spread[w] == flood[w]) continue;
+            grew = true;
+            flood[w] = spread[w];
+            low = std::min(low, w);
+            high = std::max(high, w);
+        }
+        int found = 0;
+        for (int i = 0; i < targetCount; i++) {
+            found += (flood[targets[i] / 64] >> (targets[i] % 64)) & 1;
+        }
+        if (found == targetCount) break;
+        if (!grew) {
+            split = true;
+            break;
+        }
+    }
+    std::fill(flood + low, flood + high + 1, 0);
+    return split;
+}
+
+/*
+ * Function: isDeadPath()
+ * @desc: Checks whether the backtracking search's path can still be finished into a closed tour, after it has just
+ *        moved the knight onto a square. The rest of the tour has to be a path through every unvisited square, starting
+ *        a knight's move from where the knight is and ending a knight's move from the start. So:
+ *        - An unvisited square with fewer than two unvisited neighbours has to be one end of that path. There can be two
+ *          of them at most, the first one next to the knight and the last one next to the start, and none can have no
+ *          unvisited neighbours at all. They are the first two buckets of the DegreeIndex, so this costs the same
+ *          however big the board is, and notices a square that has been cut off as soon as it happens, long before the
+ *          knight would get stuck next to it.
+ *        - The unvisited squares have to stay in one piece, which isFloodSplit() checks on boards with bitboards.
+ *        The fuller check of how the unvisited squares hang together, isCutApart(), costs a walk over all of them, so
+ *        searchClosedTour() only runs it once a position has already wasted that much search.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference. Its degreeIndex and unvisitedBits must be up to date (see
+ *          visitSearchSquare()), and its floodBits all zero.
+ * @return: Returns true if no closed tour can follow from here, false if one still might.
+ */
+bool isDeadPath(const Geometry& geometry, SearchState& state) {
+    size_t unvisited = countTourSquares(geometry, state) - state.tour.size();
+    if (unvisited < 3) return false;
+    uint32_t start = state.tour.front();
+    uint32_t square = state.tour.back();
+    const DegreeIndex& index = state.degreeIndex;
+
+    //an unvisited square with no unvisited neighbours, or more than two with one
+    if (index.bucketStart[1] != index.bucketStart[0] || index.bucketStart[2] - index.bucketStart[1] > 2) return true;
+    const uint32_t* ends = index.squares.data() + index.bucketStart[1];
+    int endCount = index.bucketStart[2] - index.bucketStart[1];
+    for (int i = 0; i < endCount; i++) {
+        if (!isNextToSquare(ends[i], square, geometry.boardY) && !isNextToSquare(ends[i], start, geometry.boardY)) return true;
+    }
+    if (endCount == 2) {
+        bool inOrder = isNextToSquare(ends[0], square, geometry.boardY) && isNextToSquare(ends[1], start, geometry.boardY);
+        bool reversed = isNextToSquare(ends[1], square, geometry.boardY) && isNextToSquare(ends[0], start, geometry.boardY);
+        if (!inOrder && !reversed) return true;
+    }
+    return geometry.bitboardWords > 0 && isFloodSplit(geometry, state);
+}
+
+/*
+ * Function: orderClosedMoves()
+ * @desc: Lists the moves from the knight's square in the order the backtracking search should try them, using the same
+ *        ranking as findClosedMoveIndex(). Moves that obviously cannot lead to a closed tour are left out: the last
+ *        square next to the start (unless it is the final square), and a square with no continuing moves (unless it is
+ *        the final square).
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference
+ * @param3: Filled with the moves to try, in order, passed by reference
+ * @param4: How ties are broken
+ */
+void orderClosedMoves(const Geometry& geometry, SearchState& state, SearchFrame& frame, Heuristic heuristic) {
+    uint32_t moves[8];
+    int sizes[8];
+    int count = findUnvisitedMoves(geometry, state, state.tour.back(), moves, sizes);
+    KT_COUNT(state.stats, candidates, count);
+    uint32_t start = state.tour.front();
+    int unvisited = countTourSquares(geometry, state) - state.tour.size();
+    frame.count = 0;
+    frame.next = 0;
+    while (true) {
+        int index = findClosedMoveIndex(sizes, moves, count, start, state.degrees[start], unvisited, geometry.boardX, geometry.boardY, heuristic);
+        if (index < 0) break;
+        frame.moves[frame.count++] = moves[index];
+        count--;
+        for (int i = index; i < count; i++) {
+            moves[i] = moves[i + 1];
+            sizes[i] = sizes[i + 1];
+        }
+    }
+}
+
+/*
+ * Function: searchClosedTour()
+ * @desc: The backtracking fallback for closed tours. It is a depth first search that tries moves in the same order
+ *        makeClosedMove() would pick them, going back on a move whenever it runs out of options. It keeps its stack in
+ *        the state instead of recursing, since a tour can be a million squares long. It gives up after nodeBudget positions.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference. Only the starting square should have been visited. It holds the
+ *          closed tour if one is found, or just the starting square if not.
+ * @param3: How ties between equally good moves are broken
+ * @param4: How many positions to try before giving up
+ * @return: Returns true if a closed tour was found, false if not.
+ */
+bool searchClosedTour(const Geometry& geometry, SearchState& state, Heuristic heuristic, long long nodeBudget) {
+    uint32_t start = state.tour.front();
+    size_t squares = countTourSquares(geometry, state);
+    std::vector<SearchFrame>& stack = state.stack;
+    buildDegreeIndex(geometry, state);
+    if (geometry.bitboardWords > 0) {
+        state.unvisitedBits.assign(geometry.bitboardWords, 0);
+        for (size_t square = 0; square < geometry.degrees.size(); square++) {
+            if (!state.visited[square]) state.unvisitedBits[square / 64] |= 1ull << (square % 64);
+        }
+        state.floodBits.assign(2 * geometry.bitboardWords, 0);
+    }
+    state.cutOrder.assign(geometry.degrees.size(), 0);
+    state.cutLow.resize(geometry.degrees.size());
+    state.cutNear.assign(geometry.degrees.size(), 0);
+    stack.assign(1, SearchFrame());
+    orderClosedMoves(geometry, state, stack.back(), heuristic);
+    TraceScope trace("searchClosedTour", "restart");
+    //when tracing, the subtree under each move made from the first few levels gets an event of its own. The move made
+    //from stack[level] starts a subtree, which ends when that move is taken back.
+    bool traced = tracingEnabled();
+    uint64_t subtreeBegan[TRACE_SUBTREE_DEPTH] = {};
+    auto endSubtree = [&](size_t level) {
+        if (traced && level < (size_t)TRACE_SUBTREE_DEPTH) {
+            recordTraceEvent("subtree", "backtrack", subtreeBegan[level], traceNow() - subtreeBegan[level], level + 1);
+        }
+    };
+    //a move's latency runs from the last move forward, so any backtracking before it shows up as one slow move
+    LatencyHistogram* latencies = state.moveLatencies;
+    uint64_t moved = (latencies != nullptr) ? readLatencyClock() : 0;
+    long long nodes = 0;
+    while (!stack.empty()) {
+        bool full = state.tour.size() == squares;
+        if (full && isNextToSquare(state.tour.back(), start, geometry.boardY)) {
+            for (size_t level = 0; level + 1 < stack.size(); level++) endSubtree(level);
+            return true;
+        }
+        SearchFrame& frame = stack.back();
+        if (full || frame.next == frame.count || ++nodes > nodeBudget) {
+            if (nodes > nodeBudget) break;
+            KT_COUNT(state.stats, deadEnds, (!full && frame.count == 0) ? 1 : 0);
+            //out of options, so go back on the last move
+            stack.pop_back();
+            if (stack.empty()) break;
+            unvisitSearchSquare(geometry, state);
+            KT_COUNT(state.stats, backtracks, 1);
+            endSubtree(stack.size() - 1);
+            //once the last move has cost as much search as isCutApart() would, see whether the rest are worth trying
+            SearchFrame& parent = stack.back();
+            if (!state.holes.empty() && parent.next < parent.count
+                && nodes - parent.began >= (long long)(squares - state.tour.size()) && isCutApart(geometry, state)) {
+                KT_COUNT(state.stats, pruneChecks, parent.count - parent.next);
+                KT_COUNT(state.stats, pruned, parent.count - parent.next);
+                parent.next = parent.count;
+            }
+            continue;
+        }
+        uint64_t began = traced ? traceNow() : 0;
+        frame.began = nodes;
+        uint32_t square = frame.moves[frame.next++];
+        visitSearchSquare(geometry, state, square);
+        KT_COUNT(state.stats, moves, 1);
+        KT_COUNT(state.stats, pruneChecks, 1);
+        if (isDeadPath(geometry, state)) {
+            KT_COUNT(state.stats, pruned, 1);
+            unvisitSearchSquare(geometry, state);
+            continue;
+        }
+        if (traced && stack.size() - 1 < (size_t)TRACE_SUBTREE_DEPTH) subtreeBegan[stack.size() - 1] = began;
+        if (latencies != nullptr) moved = latencies->recordSince(moved);
+        stack.emplace_back();
+        orderClosedMoves(geometry, state, stack.back(), heuristic);
+    }
+    for (size_t level = 0; level + 1 < stack.size(); level++) endSubtree(level);
+    while (state.tour.size() > 1) {
+        unvisitSquare(geometry, state);
+    }
+    return false;
+}
+
+/*
+ * Function: orderOpenMoves()
+ * @desc: Lists the moves from the knight's square in the order makeMove() would rank them, best first, for the limited
+ *        discrepancy search. If an unvisited square next to the knight has no continuing moves and is not the last
+ *        square, there are none: the knight is the only way onto it, so going anywhere else strands it, and going onto
+ *        it is a dead end.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference
+ * @param3: Filled with the moves to try, in order, passed by reference
+ * @param4: How ties are broken
+ */
+void orderOpenMoves(const Geometry& geometry, SearchState& state, SearchFrame& frame, Heuristic heuristic) {
+    uint32_t moves[8];
+    int sizes[8];
+    int count = findUnvisitedMoves(geometry, state, state.tour.back(), moves, sizes);
+    KT_COUNT(state.stats, candidates, count);
+    frame.count = 0;
+    frame.next = 0;
+    bool last = state.tour.size() + 1 == countTourSquares(geometry, state);
+    for (int i = 0; i < count; i++) {
+        if (sizes[i] == 0 && !last) return;
+    }
+    while (count > 0) {
+        int index = (heuristic == Heuristic::Roth) ? findFurthestMinimumIndex(sizes, moves, count, geometry.boardX, geometry.boardY)
+                                                   : findMinimumIndex(sizes, count);
+        frame.moves[frame.count++] = moves[index];
+        count--;
+        for (int i = index; i < count; i++) {
+            moves[i] = moves[i + 1];
+            sizes[i] = sizes[i + 1];
+        }
+    }
+}
+
+/*
+ * Function: searchDiscrepancyTour()
+ * @desc: Limited discrepancy search for an open tour (Harvey and Ginsberg, 1995). When Warnsdorff's rule fails, it
+ *        is nearly always one or two bad choices from a tour, so rather than a depth first search, which would go
+ *        back over the last few moves forever, this tries every path that goes against makeMove()'s choice (a
+ *        discrepancy) at one move, then every path with two, and so on. Each pass is a depth first search that takes
+ *        the best move first, so the discrepancies nearest the end of the greedy path, where it went wrong, are tried
+ *        first. Moves are made and taken back on one state (see visitSquare()), with a stack of its own, like
+ *        searchClosedTour(). Each pass goes back over the paths of the ones before it, but since each has far more paths
+ *        than all of them put together, that costs little. A pass that never had to turn down a move for having used
+ *        up its discrepancies has searched every path, so with no limit on moves the search is complete: it finds a
+ *        tour if the start has one, and otherwise stops.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference. Only the starting square should have been visited. It holds the
+ *          tour if one is found, or just the starting square if not.
+ * @param3: How ties between equally good moves are broken
+ * @param4: How many moves to make before giving up
+ * @return: Returns true if a tour covering every square was found, false if not.
+ */
+bool searchDiscrepancyTour(const Geometry& geometry, SearchState& state, Heuristic heuristic, long long nodeBudget) {
+    size_t squares = countTourSquares(geometry, state);
+    std::vector<SearchFrame>& stack = state.stack;
+    TraceScope trace("searchDiscrepancyTour", "restart");
+    LatencyHistogram* latencies = state.moveLatencies;
+    uint64_t moved = (latencies != nullptr) ? readLatencyClock() : 0;
+    long long nodes = 0;
+    for (int allowed = 1; nodes <= nodeBudget; allowed++) {
+        KT_COUNT(state.stats, restarts, 1);
+        bool limited = false;
+        stack.assign(1, SearchFrame());
+        orderOpenMoves(geometry, state, stack.back(), heuristic);
+        while (!stack.empty()) {
+            if (state.tour.size() == squares) {
+                trace.setValue(allowed);
+                return true;
+            }
+            SearchFrame& frame = stack.back();
+            //any move after the first is a discrepancy, which the path may not have room for
+            bool blocked = frame.next > 0 && frame.next < frame.count && frame.discrepancies == allowed;
+            limited = limited || blocked;
+            if (frame.next == frame.count || blocked || ++nodes > nodeBudget) {
+                if (nodes > nodeBudget) break;
+                KT_COUNT(state.stats, deadEnds, (frame.count == 0) ? 1 : 0);
+                stack.pop_back();
+                if (stack.empty()) break;
+                unvisitSquare(geometry, state);
+                KT_COUNT(state.stats, backtracks, 1);
+                continue;
+            }
+            int discrepancies = frame.discrepancies + ((frame.next > 0) ? 1 : 0);
+            visitSquare(geometry, state, frame.moves[frame.next++]);
+            KT_COUNT(state.stats, moves, 1);
+            if (latencies != nullptr) moved = latencies->recordSince(moved);
+            stack.emplace_back();
+            stack.back().discrepancies = discrepancies;
+            orderOpenMoves(geometry, state, stack.back(), heuristic);
+        }
+        while (state.tour.size() > 1) {
+            unvisitSquare(geometry, state);
+        }
+        //nothing was turned down, so every path has been tried
+        if (!limited) break;
+    }
+    trace.setValue(0);
+    return false;
+}
+
+/*
+ * Function: findImpossibility()
+ * @desc: The existence oracle. Works out in constant time whether a tour is ruled out before any search is run, using
+ *        what is known about rectangular boards (with m <= n being the shorter and longer sides):
+ *        - Open tours exist on every board except 1xn (n > 1), 2xn, 3x3, 3x5, 3x6 and 4x4 (Conrad et al., 1994).
+ *        - Closed tours exist on every board except when m and n are both odd, m is 1, 2 or 4, or the board is 3x4,
+ *          3x6 or 3x8 (Schwenk, 1991).
+ *        - Every move changes the colour of the knight's square, so on a board with an odd number of squares an open
+ *          tour has to start (and end) on the colour with more squares, the colour of the corners.
+ *        - On a 4xn board, squares on the two outer rows can only be reached from the two inner rows, and there are as
+ *          many of one as the other. A tour starting on an inner row would have to alternate outer and inner squares
+ *          the whole way, and since it also alternates colours it could only ever visit half the board. So open tours
+ *          on a 4xn board have to start on an outer row.
+ *        Anything not ruled out here has a tour on the board, but not necessarily from every remaining start (some
+ *        squares on narrow 3xn boards have none), so the search can still come back empty.
+ * @param1/param2: The board's X/Y dimensions
+ * @param3: The knight's starting square (indexed from 0)
+ * @param4: Whether the tour has to be closed
+ * @return: Returns why no tour can exist, or nullptr if one might.
+ */
+const char* findImpossibility(int boardX, int boardY, std::pair<int,int> start, bool closed) {
+    int shorter = std::min(boardX, boardY);
+    int longer = std::max(boardX, boardY);
+    if (closed) {
+        if (shorter % 2 == 1 && longer % 2 == 1) return "boards with an odd number of squares have no closed tour";
+        if (shorter == 1 || shorter == 2 || shorter == 4) return "boards with a side of 1, 2 or 4 have no closed tour";
+        if (shorter == 3 && (longer == 4 || longer == 6 || longer == 8)) return "3x4, 3x6 and 3x8 boards have no closed tour";
+        return nullptr;
+    }
+    if (shorter == 1 && longer > 1) return "boards with a side of 1 have no tour";
+    if (shorter == 2) return "boards with a side of 2 have no tour";
+    if (shorter == 3 && (longer == 3 || longer == 5 || longer == 6)) return "3x3, 3x5 and 3x6 boards have no tour";
+    if (shorter == 4 && longer == 4) return "4x4 boards have no tour";
+    if ((boardX * boardY) % 2 == 1 && (start.first + start.second) % 2 == 1) {
+        return "on a board with an odd number of squares, a tour has to start on the same colour as the corners";
+    }
+    int startRow = (boardX == 4) ? start.first : start.second;
+    if (shorter == 4 && (startRow == 1 || startRow == 2)) {
+        return "on a board with a side of 4, a tour has to start on one of the two outer rows";
+    }
+    return nullptr;
+}
+
+/*
+ * Function: findHoleImpossibility()
+ * @desc: What findImpossibility() can still say about a board with holes, where the published results no longer apply.
+ *        The knight's moves alternate colours, so a closed tour visits as many light squares as dark ones. An open tour
+ *        visits at most one more of one colour, and then it starts (and ends) on that colour. Holes that take too many
+ *        squares off one colour leave no tour at all, and without this the search only finds that out when its budget
+ *        runs out.
+ * @param1/param2: The board's X/Y dimensions
+ * @param3: The holes (row/col), sorted, passed by reference
+ * @param4: The knight's starting square (indexed from 0)
+ * @param5: Whether the tour has to be closed
+ * @return: Returns why no tour can exist, or nullptr if one might.
+ */
+const char* findHoleImpossibility(int boardX, int boardY, const std::vector<std::pair<int,int>>& holes, std::pair<int,int> start,
+                                  bool closed) {
+    if (std::binary_search(holes.begin(), holes.end(), start)) return "the knight cannot start on a hole";
+    //the corners' colour has the extra square on a board with an odd number of them
+    long long light = ((long long)boardX * boardY + 1) / 2;
+    long long dark = (long long)boardX * boardY / 2;
+    for (std::pair<int,int> hole : holes) {
+        if ((hole.first + hole.second) % 2 == 0) light--;
+        else dark--;
+    }
+    if (closed && light != dark) return "a closed tour has to visit as many squares of each colour, and the holes leave more of one";
+    if (std::abs(light - dark) > 1) return "a tour can only visit one more square of one colour, and the holes leave more than that";
+    bool startLight = (start.first + start.second) % 2 == 0;
+    if (light != dark && startLight != (light > dark)) {
+        return "with one more square of one colour left by the holes, a tour has to start on that colour";
+    }
+    return nullptr;
+}
+
+
+/*
+ * Function: splitBlockSide()
+ * @desc: Cuts one side of a board into the sides of the blocks joinBlockTours() builds it from. A side up to
+ *        BLOCK_TOUR_SIDE is left whole, and a longer one is cut into parts of at least half that and at most that. The
+ *        parts are all even apart from the last one of an odd side, so a block only has two odd sides if the board does
+ *        (and then it has no closed tour anyway).
+ * @param: The length of the side
+ * @return: The lengths of the parts, in order.
+ */
+std::vector<int> splitBlockSide(int length) {
+    if (length <= BLOCK_TOUR_SIDE) return std::vector<int>(1, length);
+    int count = length / (BLOCK_TOUR_SIDE / 2);
+    int part = (length / count) & ~1;
+    std::vector<int> parts(count, part);
+    int left = length - count * part;
+    for (int i = 0; left >= 2; i++, left -= 2) {
+        parts[i] += 2;
+    }
+    parts.back() += left;
+    return parts;
+}
+
+/*
+ * Function: joinBlockTours()
+ * @desc: Builds a closed tour of a large board out of closed tours of blocks of it, since closeTourByRotation() slows
+ *        down with the square of the board's size. The board is cut into blocks (see splitBlockSide()), and each size
+ *        of block is solved once with searchTour(). Then each block's tour is joined onto the tour built so far, through
+ *        the block to its left (or above it, for the first block of a row): if a step a-b of the tour so far and a step
+ *        c-d of the block's tour have a knight's move from a to c and the same move from b to d, dropping those two
+ *        steps and adding a-c and b-d leaves one closed tour over both.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference. It should be fresh, and holds the closed tour from the start if this
+ *          succeeds. If not, it is left as it was.
+ * @param3: The knight's starting square
+ * @param4: How to solve the blocks, passed by reference
+ * @return: Returns true if the tour was built, false if a block has no closed tour or two blocks could not be joined.
+ */
+bool joinBlockTours(const Geometry& geometry, SearchState& state, uint32_t start, const SolveOptions& options) {
+    TraceScope trace("joinBlockTours", "search");
+    int boardX = geometry.boardX;
+    int boardY = geometry.boardY;
+    std::vector<int> rowParts = splitBlockSide(boardX);
+    std::vector<int> colParts = splitBlockSide(boardY);
+    struct BlockTour {
+        int rows;
+        int cols;
+        std::vector<uint32_t> tour;
+    };
+    std::vector<BlockTour> blockTours;
+    //each square's two neighbours on the tour
+    std::vector<uint32_t> links(geometry.degrees.size() * 2);
+    auto relink = [&](uint32_t square, uint32_t from, uint32_t to) {
+        links[square * 2 + ((links[square * 2] == from) ? 0 : 1)] = to;
+    };
+    int top = 0;
+    for (size_t row = 0; row < rowParts.size(); row++) {
+        int left = 0;
+        for (size_t col = 0; col < colParts.size(); col++) {
+            int rows = rowParts[row];
+            int cols = colParts[col];
+            auto found = std::find_if(blockTours.begin(), blockTours.end(), [&](const BlockTour& block) {
+                return block.rows == rows && block.cols == cols;
+            });
+            if (found == blockTours.end()) {
+                //blocks are solved on the canonical board, with the short side as rows
+                std::shared_ptr<const Geometry> blockGeometry = findGeometry(std::min(rows, cols), std::max(rows, cols));
+                SearchState blockState;
+                SearchState blockScratch;
+                resetSearchState(*blockGeometry, blockState);
+                searchTour(*blockGeometry, blockState, blockScratch, 0, options, true);
+                state.stats.add(blockState.stats);
+                state.stats.add(blockScratch.stats);
+                if (!isClosedState(*blockGeometry, blockState)) {
+                    trace.setValue(0);
+                    return false;
+                }
+                BlockTour block = {rows, cols, blockState.tour};
+                if (rows > cols) {
+                    for (uint32_t& square : block.tour) {
+                        square = (square % rows) * cols + square / rows;
+                    }
+                }
+                found = blockTours.insert(blockTours.end(), block);
+            }
+            const std::vector<uint32_t>& tour = found->tour;
+            auto onBoard = [&](uint32_t square) {
+                return (uint32_t)((top + square / cols) * boardY + left + square % cols);
+            };
+            for (size_t i = 0; i < tour.size(); i++) {
+                uint32_t square = onBoard(tour[i]);
+                links[square * 2] = onBoard(tour[(i + tour.size() - 1) % tour.size()]);
+                links[square * 2 + 1] = onBoard(tour[(i + 1) % tour.size()]);
+            }
+            if (row > 0 || col > 0) {
+                //the two rows or columns of the tour so far next to the block, which is where a can be
+                int nearTop = (col > 0) ? top : top - 2;
+                int nearLeft = (col > 0) ? left - 2 : left;
+                int nearRows = (col > 0) ? rows : 2;
+                int nearCols = (col > 0) ? 2 : cols;
+                auto inBlock = [&](int x, int y) {
+                    return x >= top && x < top + rows && y >= left && y < left + cols;
+                };
+                bool joined = false;
+                for (int x = nearTop; x < nearTop + nearRows && !joined; x++) {
+                    for (int y = nearLeft; y < nearLeft + nearCols && !joined; y++) {
+                        uint32_t a = x * boardY + y;
+                        for (int side = 0; side < 2 && !joined; side++) {
+                            uint32_t b = links[a * 2 + side];
+                            int bx = b / boardY;
+                            int by = b % boardY;
+                            for (int move = 0; move < 8 && !joined; move++) {
+                                if (!inBlock(x + MOVE_DX[move], y + MOVE_DY[move])) continue;
+                                if (!inBlock(bx + MOVE_DX[move], by + MOVE_DY[move])) continue;
+                                uint32_t c = (x + MOVE_DX[move]) * boardY + y + MOVE_DY[move];
+                                uint32_t d = (bx + MOVE_DX[move]) * boardY + by + MOVE_DY[move];
+                                if (links[c * 2] != d && links[c * 2 + 1] != d) continue;
+                                relink(a, b, c);
+                                relink(b, a, d);
+                                relink(c, d, a);
+                                relink(d, c, b);
+                                joined = true;
+                            }
+                        }
+                    }
+                }
+                if (!joined) {
+                    trace.setValue(0);
+                    return false;
+                }
+            }
+            left += cols;
+        }
+        top += rowParts[row];
+    }
+    //walk the joined tour round from the start
+    uint32_t previous = links[start * 2];
+    uint32_t square = start;
+    for (size_t i = 0; i < geometry.degrees.size(); i++) {
+        visitSquare(geometry, state, square);
+        uint32_t next = (links[square * 2] == previous) ? links[square * 2 + 1] : links[square * 2];
+        previous = square;
+        square = next;
+    }
+    KT_COUNT(state.stats, moves, state.tour.size());
+    trace.setValue(blockTours.size());
+    return true;
+}
+
+/*
+ * Function: searchTour()
+ * @desc: Runs the search for one problem on a board. Open tours come from makeMove(), or from a FixedBoardSolver
+ *        when the board is one of the sizes built in (see searchFixedTour()) and moves are not being timed. Closed tours are looked for with
+ *        makeClosedMove() first. If that gets stuck, closeTourByRotation() tries to repair its path, and
+ *        searchClosedTour() is the last resort (mostly needed on narrow boards, where the rotations run out). Boards
+ *        with a side over BLOCK_TOUR_SIDE try joinBlockTours() before any of those, since rotations on a path that long
+ *        take too long. With Algorithm::TransferMatrix, boards with a side of 3 or 4 are solved exactly by findStripTour() instead, and only
+ *        fall through to those if the start has no tour. Boards with holes always use the generic searches. With
+ *        Algorithm::LimitedDiscrepancy, an open tour the greedy pass could not finish is looked for with
+ *        searchDiscrepancyTour(), and if that gives up too, the greedy path is what is left.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference. It should be fresh (see resetSearchState()), apart from any holes
+ *          (see blockSquare()), and holds the tour afterwards, always starting on the start (stored tours are rebuilt
+ *          from it). A closed tour search that fails leaves whatever path it got stuck on.
+ * @param3: A second state for the backtracking search to use, passed by reference
+ * @param4: The knight's starting square
+ * @param5: How to search, passed by reference
+ * @param6: Whether to search for a closed tour
+ */
+void searchTour(const Geometry& geometry, SearchState& state, SearchState& scratch, uint32_t start, const SolveOptions& options, bool closed) {
+    //canonical boards have the short side as rows, so a strip is always rows x length here
+    bool holes = !state.holes.empty();
+    if (options.algorithm == Algorithm::TransferMatrix && (geometry.boardX == 3 || geometry.boardX == 4) && !holes) {
+        if (findStripTour(geometry.boardX, geometry.boardY, start / geometry.boardY, start % geometry.boardY, closed, state.tour)) {
+            KT_COUNT(state.stats, moves, state.tour.size());
+            return;
+        }
+        state.tour.clear();
+    }
+    if (!closed) {
+        state.tour.resize(geometry.degrees.size());
+        size_t length = 0;
+        //the fixed size search does not time its moves, so makeMove() (which finds the same tour) does it instead
+        if (state.moveLatencies == nullptr && !holes) {
+            TraceScope trace("searchFixedTour", "search");
+            length = searchFixedTour(geometry.boardX, geometry.boardY, start, options.heuristic, state.tour.data(), state.stats);
+            trace.setValue(length);
+        }
+        state.tour.resize(length);
+        if (length == 0) makeMove(geometry, state, start, options.heuristic);
+        if (options.algorithm != Algorithm::LimitedDiscrepancy || state.tour.size() == countTourSquares(geometry, state)) return;
+        //the fixed size search leaves the board untouched, so only makeMove()'s path has to be taken back
+        bool greedy = length == 0;
+        while (greedy && state.tour.size() > 0) {
+            unvisitSquare(geometry, state);
+        }
+        state.tour.clear();
+        visitSquare(geometry, state, start);
+        if (searchDiscrepancyTour(geometry, state, options.heuristic, DISCREPANCY_NODE_BUDGET)) return;
+        //no luck, so the result is the greedy path, the same as without it
+        unvisitSquare(geometry, state);
+        makeMove(geometry, state, start, options.heuristic);
+        return;
+    }
+    if (geometry.boardY > BLOCK_TOUR_SIDE && !holes && joinBlockTours(geometry, state, start, options)) return;
+    visitSquare(geometry, state, start);
+    if (makeClosedMove(geometry, state, options.heuristic)) return;
+    KT_COUNT(state.stats, restarts, 1);
+    long long rotations = CLOSED_TOUR_ROTATIONS_PER_SQUARE * (long long)geometry.degrees.size();
+    //rotations never move the path's first square, but reversing the whole path swaps its ends
+    if (closeTourByRotation(geometry, state, rotations, CLOSED_TOUR_REVERSAL_BUDGET)) {
+        std::rotate(state.tour.begin(), std::find(state.tour.begin(), state.tour.end(), start), state.tour.end());
+        return;
+    }
+    if (state.tour.front() != start) std::reverse(state.tour.begin(), state.tour.end());
+    KT_COUNT(state.stats, restarts, 1);
+    resetSearchState(geometry, scratch);
+    for (uint32_t hole : state.holes) blockSquare(geometry, scratch, hole);
+    visitSquare(geometry, scratch, start);
+    if (searchClosedTour(geometry, scratch, options.heuristic, CLOSED_TOUR_NODE_BUDGET)) {
+        state.tour.swap(scratch.tour);
+    }
+}
+
+/*
+ * Function: KnightTourSolver::setGeometry()
+ * @desc: Sets the board size the next solves are for. The geometry comes from the shared cache (in canonical
+ *        orientation, since that is what is searched), and the search state is sized for it here, so solve() does not
+ *        have to. Setting the size it already has does nothing.
+ * @param1/param2: The board's X/Y dimensions
+ */
+void KnightTourSolver::setGeometry(int boardX, int boardY) {
+    if (geometry != nullptr && boardX == rows && boardY == cols) return;
+    KT_TIME_PHASE(totals, PHASE_SETUP);
+    TraceScope trace("setGeometry", "setup", (int64_t)boardX * boardY);
+    rows = boardX;
+    cols = boardY;
+    holes.clear();
+    geometry = findGeometry(std::min(boardX, boardY), std::max(boardX, boardY));
+    resetSearchState(*geometry, state);
+    resetSearchState(*geometry, scratch);
+    state.tour.reserve(squares());
+    scratch.tour.reserve(squares());
+}
+
+/*
+ * Function: KnightTourSolver::setHoles()
+ * @desc: Takes squares out of the board set with setGeometry(), for the solves after it: tours go round them, and a
+ *        full tour covers every other square (see tourSquares()). Setting a new board size clears them.
+ * @param: The squares (row/col, indexed from 0), passed by reference. An empty list puts the whole board back.
+ * @return: Returns true if the holes were set, false if one of them is not on the board (and nothing was changed).
+ */
+bool KnightTourSolver::setHoles(const std::vector<std::pair<int,int>>& squares) {
+    for (std::pair<int,int> square : squares) {
+        if (!isOnBoard(square.first, square.second, rows, cols)) return false;
+    }
+    holes = squares;
+    std::sort(holes.begin(), holes.end());
+    holes.erase(std::unique(holes.begin(), holes.end()), holes.end());
+    return true;
+}
+
+/*
+ * Function: KnightTourSolver::solve()
+ * @desc: Solves one problem on the board set with setGeometry(). findImpossibility() rejects problems that have no
+ *        answer first, so they never reach a search. Since a closed tour can start anywhere, it is always searched for
+ *        from the corner and rotated round to the start afterwards, so every start on the board shares the same search.
+ *        If no closed tour turns up, an open tour from the start is found instead. impossible() and closed() say what
+ *        happened afterwards. On a board with holes, the oracle does not apply (findHoleImpossibility() only checks the
+ *        start and the colours), and closed tours are searched for from the start itself, since the corner might be a
+ *        hole.
+ * @param1/param2: The knight's starting row/col (indexed from 0)
+ * @param3: Filled with the tour, as square indexes on the board that was asked for. It needs room for squares().
+ * @return: How many squares are in the tour (1 if it is impossible, which is just the start).
+ */
+size_t KnightTourSolver::solve(int startRow, int startCol, uint32_t* tour) {
+    KT_TIME_PHASE(totals, PHASE_SOLVE);
+    TraceScope trace("solve", "search");
+    std::pair<int,int> start(startRow, startCol);
+    if (holes.empty()) {
+        reason = findImpossibility(rows, cols, start, options.closed);
+    }
+    else {
+        reason = findHoleImpossibility(rows, cols, holes, start, options.closed);
+    }
+    lastClosed = false;
+    if (reason != nullptr) {
+        tour[0] = startRow * cols + startCol;
+        return 1;
+    }
+    if (options.closed) {
+        CanonicalProblem problem = canonicaliseProblem(rows, cols, holes.empty() ? std::pair<int,int>(0, 0) : start);
+        findCanonicalTour(problem, true);
+        if (isClosedState(*geometry, state)) {
+            size_t length = writeTour(problem, tour);
+            std::rotate(tour, std::find(tour, tour + length, (uint32_t)(startRow * cols + startCol)), tour + length);
+            lastClosed = true;
+            return length;
+        }
+        //no closed tour, so fall back to an open one from the start that was asked for
+        KT_COUNT(totals, restarts, 1);
+        if (tracingEnabled()) recordTraceEvent("openFallback", "restart", traceNow(), 0, -1);
+    }
+    CanonicalProblem problem = canonicaliseProblem(rows, cols, start);
+    findCanonicalTour(problem, false);
+    lastClosed = isClosedState(*geometry, state);
+    return writeTour(problem, tour);
+}
+
+/*
+ * Function: KnightTourSolver::stats()
+ * @desc: Says what this solver has done since it was made: its own counts and timings, plus everything counted by the
+ *        searches on its two search states. Everything is 0 unless the stats were compiled in (see SolverStats.h).
+ * @return: The stats.
+ */
+SolverStats KnightTourSolver::stats() const {
+    SolverStats stats = totals;
+    stats.add(state.stats);
+    stats.add(scratch.stats);
+    return stats;
+}
+
+/*
+ * Function: KnightTourSolver::findCanonicalTour()
+ * @desc: Finds the tour for a canonical problem, leaving it in the search state. The tour database is tried first,
+ *        then the tour cache, then it is searched for (and the cache is given the result). Both only hold tours of full
+ *        boards, so with holes it is always searched for, with the holes mapped onto the canonical board.
+ * @param1: The canonical problem, passed by reference
+ * @param2: Whether to search for a closed tour
+ */
+void KnightTourSolver::findCanonicalTour(const CanonicalProblem& problem, bool closedSearch) {
+    bool stored = holes.empty();
+    //a tour read back is for the whole board
+    state.holes.clear();
+    if (stored && database != nullptr && readDatabaseTour(*database, problem, options, closedSearch, state.tour)) {
+        return;
+    }
+    TourKey key;
+    if (stored && cache != nullptr) {
+        key = makeTourKey(problem, options, closedSearch);
+        if (readCachedTour(*cache, key, state.tour)) return;
+    }
+    resetSearchState(*geometry, state);
+    for (std::pair<int,int> hole : holes) {
+        hole = applySymmetry(problem.symmetry, hole, rows, cols);
+        blockSquare(*geometry, state, hole.first * problem.boardY + hole.second);
+    }
+    searchTour(*geometry, state, scratch, problem.start.first * problem.boardY + problem.start.second, options, closedSearch);
+    if (stored && cache != nullptr) {
+        writeCachedTour(*cache, key, state.tour);
+    }
+}
+
+/*
+ * Function: KnightTourSolver::writeTour()
+ * @desc: Maps the tour in the search state back from the canonical board onto the board that was asked for.
+ * @param1: The canonical problem it was solved for, passed by reference
+ * @param2: Filled with the tour, as square indexes
+ * @return: How many squares are in the tour.
+ */
+size_t KnightTourSolver::writeTour(const CanonicalProblem& problem, uint32_t* tour) const {
+    for (size_t i = 0; i < state.tour.size(); i++) {
+        std::pair<int,int> square(state.tour[i] / problem.boardY, state.tour[i] % problem.boardY);
+        square = undoSymmetry(problem.symmetry, square, rows, cols);
+        tour[i] = square.first * cols + square.second;
+    }
+    return state.tour.size();
+}
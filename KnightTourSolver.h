@@ -0,0 +1,339 @@
+/* Author: Nathan Burrows
+ * File: KnightTourSolver.h
+ *
+ * The Knight Tour engine, with no console input or output, so it can be embedded in other programs.
+ * KnightTourSolver is the main entry point: set the board size once, then call solve() as many times as needed.
+ * The free functions underneath it (the searches, symmetry handling and existence oracle) are declared here too, for
+ * the tools that need to work at that level, like the tour database builder.
+ *
+ * Squares are numbered row * boardY + col throughout, with rows and columns indexed from 0.
+ */
+
+#ifndef KNIGHTTOURSOLVER_H
+#define KNIGHTTOURSOLVER_H
+
+#include "SolverStats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct TourCache;
+struct TourDatabase;
+class LatencyHistogram;
+
+/*
+ * Enum: Heuristic
+ * @desc: How makeMove() picks between moves that have the same (fewest) number of continuing moves.
+ *        Warnsdorff = the first one found, in the order findMovesFromSquare() lists them (the original behaviour)
+ *        Roth       = the one furthest from the centre of the board, which fails far less often on big boards
+ */
+enum class Heuristic { Warnsdorff, Roth };
+
+/*
+ * Enum: Algorithm
+ * @desc: Which search is used to find the tour.
+ *        Warnsdorff     = a single greedy pass, never going back on a move
+ *        TransferMatrix = on boards with a side of 3 or 4, an exact search column by column (see TransferMatrix.h),
+ *                         which always finds a tour if there is one. Other boards are searched as with Warnsdorff.
+ *        LimitedDiscrepancy = if the greedy pass does not find an open tour, the paths that go against it at one
+ *                         move, then two, and so on (see searchDiscrepancyTour()). Closed tours are searched as with
+ *                         Warnsdorff.
+ */
+enum class Algorithm { Warnsdorff, TransferMatrix, LimitedDiscrepancy };
+
+/*
+ * Struct: SolveOptions
+ * @desc: Everything about how a tour should be searched for, apart from the board and the starting square.
+ */
+struct SolveOptions {
+    Algorithm algorithm = Algorithm::Warnsdorff;
+    Heuristic heuristic = Heuristic::Warnsdorff;
+    bool closed = false;
+};
+
+/*
+ * Struct: Symmetry
+ * @desc: One of the 8 symmetries of a rectangular board (the dihedral group). The flips are applied first, in the
+ *        original board's frame, then the board is optionally transposed. Knight moves are preserved by all of them, so
+ *        a tour on the transformed board maps straight back onto a tour of the original one. A transposed R x C board
+ *        becomes a C x R board, which is how a rectangular problem and its transpose share the same answer.
+ */
+struct Symmetry {
+    bool flipRows = false;
+    bool flipCols = false;
+    bool transpose = false;
+};
+
+/*
+ * Struct: CanonicalProblem
+ * @desc: A tour problem (board size and starting square) rewritten in its canonical orientation, along with the
+ *        symmetry that got it there so the answer can be mapped back.
+ */
+struct CanonicalProblem {
+    int boardX;
+    int boardY;
+    std::pair<int,int> start;
+    Symmetry symmetry;
+};
+
+//The biggest board the closed tour backtracking search keeps a bitboard of, to check the unvisited squares have not
+//split apart (see isFloodSplit()). Past this, the flood fills cost more than the branches they save.
+const int MAX_BITBOARD_SQUARES = 4096;
+
+/*
+ * Struct: Geometry
+ * @desc: Everything about a board size that does not change while a knight moves around it, worked out once so any
+ *        number of searches can share it read-only.
+ *        neighbours         = every square's knight moves, listed in the order findMovesFromSquare() finds them. The
+ *                             moves from square s are neighbours[neighbourStart[s]] up to neighbours[neighbourStart[s + 1]].
+ *        degrees            = how many moves each square has on an empty board
+ *        symmetries         = the board's symmetries that keep its shape (8 for a square board, 4 otherwise)
+ *        symmetryMaps       = for each of those, where every square ends up (see applySymmetry())
+ *        bitboardWords      = how many 64 bit words a bitboard of the board takes (bit s is square s), or 0 if the
+ *                             board is bigger than MAX_BITBOARD_SQUARES
+ *        moveShifts         = for each knight move (in MOVE_DX/MOVE_DY order), how far it moves a square's bit
+ *        moveSources        = for each knight move, a bitboard of the squares it can be made from without leaving the
+ *                             board. Move m's words are moveSources[m * bitboardWords] onwards.
+ *        bytes              = roughly how much memory all of that takes, for the cache's budget
+ */
+struct Geometry {
+    int boardX = 0;
+    int boardY = 0;
+    std::vector<uint32_t> neighbourStart;
+    std::vector<uint32_t> neighbours;
+    std::vector<uint8_t> degrees;
+    std::vector<Symmetry> symmetries;
+    std::vector<std::vector<uint32_t>> symmetryMaps;
+    size_t bitboardWords = 0;
+    long long moveShifts[8] = {};
+    std::vector<uint64_t> moveSources;
+    size_t bytes = 0;
+};
+
+/*
+ * Class: GeometryCache
+ * @desc: A thread-safe, least recently used cache of Geometry, keyed by board size. Geometries are handed out as
+ *        shared_ptrs, so every search on the same size shares one copy, and one that is pushed out of the cache stays
+ *        alive until the last search using it lets go. When a size is asked for that is not cached, the first thread to
+ *        ask builds it (outside the lock) and any others asking at the same time wait for that one instead of building
+ *        it again. Once the geometries held go over the byte budget, the least recently used ones are dropped.
+ */
+class GeometryCache {
+public:
+    explicit GeometryCache(size_t budgetBytes) : budget(budgetBytes) {}
+    std::shared_ptr<const Geometry> get(int boardX, int boardY);
+
+private:
+    struct Entry {
+        std::shared_future<std::shared_ptr<const Geometry>> geometry;
+        std::list<uint64_t>::iterator position;
+        size_t bytes = 0;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    std::list<uint64_t> recent;
+    size_t budget;
+    size_t used = 0;
+};
+
+/*
+ * Struct: SearchFrame
+ * @desc: One level of the closed tour backtracking search: the moves that can be tried from a square, best first, how
+ *        many of them have been tried so far, and how many positions the search had tried when the last one was made.
+ *        The limited discrepancy search also keeps how many discrepancies the path to the square has.
+ */
+struct SearchFrame {
+    uint32_t moves[8];
+    int count = 0;
+    int next = 0;
+    long long began = 0;
+    int discrepancies = 0;
+};
+
+/*
+ * Struct: DegreeIndex
+ * @desc: The unvisited squares, sorted by degree (how many unvisited squares are a knight's move from them), so how
+ *        many have any given degree, and which they are, is known straight away. squares holds the visited squares
+ *        first, then the unvisited ones of degree 0, then degree 1, and so on up to 8.
+ *        squares     = every square, in that order
+ *        slot        = where each square is in squares
+ *        bucketStart = where the squares of each degree start (bucketStart[d] for degree d). The visited squares are the
+ *                      ones before bucketStart[0], and degree 8 runs to the end.
+ *        A square's degree changes by one at a time, which moves it across one boundary with a single swap.
+ */
+struct DegreeIndex {
+    std::vector<uint32_t> squares;
+    std::vector<uint32_t> slot;
+    uint32_t bucketStart[9] = {};
+};
+
+/*
+ * Struct: CutFrame
+ * @desc: One level of the depth first search isCutApart() uses to find the squares the unvisited squares would split
+ *        apart without (articulation points).
+ *        square     = the square
+ *        parent     = the square it was reached from (itself for the first square)
+ *        next       = the next of its neighbours (an index into Geometry::neighbours) to look at
+ *        nearKnight = how many unvisited squares next to the knight had been reached when this square was
+ *        nearStart  = how many unvisited squares next to the start had been reached when this square was
+ *        pieces     = how many pieces the squares reached through it would split into without it
+ *        ends       = for the first two of those pieces, bit 0 if one of its squares is next to the knight, and bit 1 if
+ *                     one is next to the start
+ *        cutKnight/cutStart = how many squares next to the knight/start are in those pieces
+ */
+struct CutFrame {
+    uint32_t square;
+    uint32_t parent;
+    uint32_t next;
+    uint32_t nearKnight;
+    uint32_t nearStart;
+    int pieces;
+    int ends[2];
+    uint32_t cutKnight;
+    uint32_t cutStart;
+};
+
+/*
+ * Struct: SearchState
+ * @desc: The state one search keeps for itself while it moves the knight around a board whose Geometry it shares.
+ *        visited  = 1 for every square the knight has been on (including the one it is on)
+ *        degrees  = how many unvisited squares are a knight's move from each square, kept up to date on every move
+ *        tour     = the squares visited, in order
+ *        holes    = squares that are not part of the board (see blockSquare()). They are marked visited, but the tour
+ *                   never goes on them, so a full tour has every other square.
+ *        position = scratch space for closeTourByRotation(): where each square is in the tour
+ *        stack    = scratch space for searchClosedTour() and searchDiscrepancyTour()
+ *        unvisitedBits = scratch space for searchClosedTour(): the unvisited squares, as a bitboard
+ *        degreeIndex   = scratch space for searchClosedTour(): the unvisited squares by degree (see DegreeIndex)
+ *        floodBits     = scratch space for isFloodSplit(): two bitboards for its flood fill
+ *        cutOrder/cutLow/cutNear/cutStack = scratch space for isCutApart(): when it reached each square (0 for not
+ *                        yet), the earliest square reachable from below it, which squares are next to the knight or
+ *                        the start, and its search stack
+ *        stats    = what the searches run on this state have done (see SolverStats). resetSearchState() leaves it alone.
+ *        moveLatencies = where to record how long each move takes, or nullptr to not time them (see LatencyHistogram)
+ *        Once it has been used on a board, searching the same board again allocates nothing.
+ */
+struct SearchState {
+    std::vector<uint8_t> visited;
+    std::vector<uint8_t> degrees;
+    std::vector<uint32_t> tour;
+    std::vector<uint32_t> holes;
+    std::vector<int> position;
+    std::vector<SearchFrame> stack;
+    std::vector<uint64_t> unvisitedBits;
+    DegreeIndex degreeIndex;
+    std::vector<uint64_t> floodBits;
+    std::vector<uint32_t> cutOrder;
+    std::vector<uint32_t> cutLow;
+    std::vector<uint8_t> cutNear;
+    std::vector<CutFrame> cutStack;
+    SolverStats stats;
+    LatencyHistogram* moveLatencies = nullptr;
+};
+
+/*
+ * Class: KnightTourSolver
+ * @desc: The embeddable solver. setGeometry() picks the board size and allocates everything a search needs, then
+ *        solve() can be called any number of times, for any start, without allocating. Each solve canonicalises the
+ *        problem, finds the tour on the canonical board (from the tour database, the tour cache, or by searching), and
+ *        writes it mapped back onto the board asked for into a buffer the caller owns. A solver is not thread-safe,
+ *        but any number of them can run at once, sharing their geometry. setHoles() takes squares out of the board, for
+ *        boards that are not full rectangles; those are always searched (the cache, database and existence oracle are
+ *        only for full boards).
+ */
+class KnightTourSolver {
+public:
+    KnightTourSolver() = default;
+    explicit KnightTourSolver(const SolveOptions& options) : options(options) {}
+
+    void setGeometry(int boardX, int boardY);
+    bool setHoles(const std::vector<std::pair<int,int>>& squares);
+    void setOptions(const SolveOptions& newOptions) { options = newOptions; }
+    void setCache(const TourCache* newCache) { cache = newCache; }
+    void setDatabase(const TourDatabase* newDatabase) { database = newDatabase; }
+    void setMoveLatencies(LatencyHistogram* histogram) { state.moveLatencies = histogram; scratch.moveLatencies = histogram; }
+
+    size_t solve(int startRow, int startCol, uint32_t* tour);
+
+    int boardX() const { return rows; }
+    int boardY() const { return cols; }
+    size_t squares() const { return (size_t)rows * cols; }
+    size_t tourSquares() const { return squares() - holes.size(); }
+    const SolveOptions& solveOptions() const { return options; }
+    bool impossible() const { return reason != nullptr; }
+    const char* impossibleReason() const { return reason; }
+    bool closed() const { return lastClosed; }
+    SolverStats stats() const;
+
+private:
+    void findCanonicalTour(const CanonicalProblem& problem, bool closedSearch);
+    size_t writeTour(const CanonicalProblem& problem, uint32_t* tour) const;
+
+    SolveOptions options;
+    const TourCache* cache = nullptr;
+    const TourDatabase* database = nullptr;
+    std::shared_ptr<const Geometry> geometry;
+    SearchState state;
+    SearchState scratch;
+    int rows = 0;
+    int cols = 0;
+    std::vector<std::pair<int,int>> holes;
+    const char* reason = nullptr;
+    bool lastClosed = false;
+    SolverStats totals;
+};
+
+int findMinimumIndex(const int* sizes, int count);
+int countMinimumTies(const int* sizes, int count, int smallest);
+int findFurthestMinimumIndex(const int* sizes, const uint32_t* moves, int count, int boardX, int boardY);
+bool isOnBoard(int x, int y, int boardX, int boardY);
+std::vector<std::pair<int,int>> findMovesFromSquare(int x, int y, int boardX, int boardY, std::vector<std::vector<int>>& Board);
+
+std::pair<int,int> applySymmetry(const Symmetry& symmetry, std::pair<int,int> square, int boardX, int boardY);
+std::pair<int,int> undoSymmetry(const Symmetry& symmetry, std::pair<int,int> square, int boardX, int boardY);
+CanonicalProblem canonicaliseProblem(int boardX, int boardY, std::pair<int,int> start);
+std::vector<std::pair<int,int>> fundamentalStartSquares(int boardX, int boardY);
+
+std::shared_ptr<Geometry> buildGeometry(int boardX, int boardY);
+std::shared_ptr<const Geometry> findGeometry(int boardX, int boardY);
+
+void resetSearchState(const Geometry& geometry, SearchState& state);
+void blockSquare(const Geometry& geometry, SearchState& state, uint32_t square);
+size_t countTourSquares(const Geometry& geometry, const SearchState& state);
+void visitSquare(const Geometry& geometry, SearchState& state, uint32_t square);
+void unvisitSquare(const Geometry& geometry, SearchState& state);
+void makeMove(const Geometry& geometry, SearchState& state, uint32_t start, Heuristic heuristic = Heuristic::Warnsdorff);
+
+bool isKnightMove(std::pair<int,int> a, std::pair<int,int> b);
+bool isNextToSquare(uint32_t a, uint32_t b, int boardY);
+bool isClosedTour(int boardX, int boardY, const uint32_t* tour, size_t length, size_t squares = 0);
+bool isClosedState(const Geometry& geometry, const SearchState& state);
+bool makeClosedMove(const Geometry& geometry, SearchState& state, Heuristic heuristic);
+bool closeTourByRotation(const Geometry& geometry, SearchState& state, long long rotationBudget, long long reversalBudget);
+uint64_t findKnightMoveWord(const Geometry& geometry, int move, const uint64_t* squares, size_t word);
+void buildDegreeIndex(const Geometry& geometry, SearchState& state);
+void visitSearchSquare(const Geometry& geometry, SearchState& state, uint32_t square);
+void unvisitSearchSquare(const Geometry& geometry, SearchState& state);
+bool isCutApart(const Geometry& geometry, SearchState& state);
+bool isFloodSplit(const Geometry& geometry, SearchState& state);
+bool isDeadPath(const Geometry& geometry, SearchState& state);
+bool searchClosedTour(const Geometry& geometry, SearchState& state, Heuristic heuristic, long long nodeBudget);
+void orderOpenMoves(const Geometry& geometry, SearchState& state, SearchFrame& frame, Heuristic heuristic);
+bool searchDiscrepancyTour(const Geometry& geometry, SearchState& state, Heuristic heuristic, long long nodeBudget);
+std::vector<int> splitBlockSide(int length);
+bool joinBlockTours(const Geometry& geometry, SearchState& state, uint32_t start, const SolveOptions& options);
+void searchTour(const Geometry& geometry, SearchState& state, SearchState& scratch, uint32_t start, const SolveOptions& options, bool closed);
+
+const char* findImpossibility(int boardX, int boardY, std::pair<int,int> start, bool closed);
+const char* findHoleImpossibility(int boardX, int boardY, const std::vector<std::pair<int,int>>& holes, std::pair<int,int> start,
+                                  bool closed);
+
+#endif
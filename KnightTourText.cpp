@@ -5,13 +5,36 @@
  * The user specifies the board size (can be square or rectangular) and chooses the starting square for the knight.
  * The program then computes a valid Knight Tour (if it exists) for that board size, and outputs a console display
  * at each stage, for every move.
+ * This file is the console front end; the solving itself is done by KnightTourSolver (see KnightTourSolver.h).
  */
 
+#include "KnightTourSolver.h"
+#include "TourStore.h"
+#include "Trace.h"
+#include "LatencyHistogram.h"
+#include "TourCounter.h"
+#include "TransferMatrix.h"
+#include "TourDiagram.h"
+
 #include <iostream>
 #include <utility>
 #include <vector>
 #include <string>
 #include <limits>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 /* Function: printBoard()
@@ -25,8 +48,8 @@
  * @param Board: Passing the chessboard into the function by reference.
  */
 void printBoard(std::vector<std::vector<int>>& Board) {
-    for (int i = 0; i < Board.size(); i++) {
-        for (int j = 0; j < Board[i].size(); j++) {
+    for (size_t i = 0; i < Board.size(); i++) {
+        for (size_t j = 0; j < Board[i].size(); j++) {
             switch(Board[i][j]) {
                 case 1:
                     std::cout << "[K]";
@@ -44,97 +67,87 @@ void printBoard(std::vector<std::vector<int>>& Board) {
     std::cout << std::endl;
 }
 
+
+
 /*
- * Function: findMinimumIndex()
- * @desc: Takes in a vector of integers, and finds the index of the smallest one.
- * @param: Passing the vector into the function.
- * @return: Returns the smallest index.
+ * Struct: LatencyReport
+ * @desc: The latencies recorded with --latency. moves is every move the solver makes, render is every board shown (one
+ *        per move when every move is printed) or every result written.
  */
-int findMinimumIndex(std::vector<int> vec) {
-    int index = 0;
-    int smallest = vec[0];
-    for (int i = 1; i < vec.size(); i++) {
-        if (vec[i] < smallest) {
-            smallest = vec[i];
-            index = i;
-        }
-    }
-    return index;
+struct LatencyReport {
+    LatencyHistogram moves;
+    LatencyHistogram render;
+};
+
+//Set by the SIGUSR1 handler, and cleared once the report it asks for has been printed. Only the main thread reads it.
+volatile std::sig_atomic_t latencyReportRequested = 0;
+
+/*
+ * Function: requestLatencyReport()
+ * @desc: The SIGUSR1 handler. Printing is not safe inside a signal handler, so it only sets a flag, and the report is
+ *        printed the next time the main thread checks (see checkLatencyReport()).
+ * @param: The signal
+ */
+void requestLatencyReport(int) {
+    latencyReportRequested = 1;
 }
 
 /*
- * Function: isOnBoard()
- * @desc: A helper function that finds if an X,Y co-ord is a move that will be on the chessboard.
- * @param1/param2: X/Y co-ords of a potential move
- * @param3/param4: Board dimensions (X/Y)
- * @return: Returns true if move fits on the chessboard, false if not.
+ * Function: printLatencyReport()
+ * @desc: Prints how many latencies each histogram has, and their p50, p99, p99.9 and max, to stderr.
+ * @param: The latencies, passed by reference
  */
-bool isOnBoard(int x, int y, int boardX, int boardY) {
-    return ((x >= 0) && (boardX > x) && (y >= 0) && (boardY > y));
+void printLatencyReport(const LatencyReport& latencies) {
+    auto printHistogram = [](const char* name, const LatencyHistogram& histogram) {
+        std::cerr << "  " << name << ": " << histogram.count() << " recorded, p50 " << histogram.percentile(0.5) / 1e3
+                  << " us, p99 " << histogram.percentile(0.99) / 1e3 << " us, p99.9 " << histogram.percentile(0.999) / 1e3
+                  << " us, max " << histogram.max() / 1e3 << " us\n";
+    };
+    std::cerr << "Latency:\n";
+    printHistogram("solver moves", latencies.moves);
+    printHistogram("render", latencies.render);
+    std::cerr.flush();
 }
 
 /*
- * Function: findMovesFromSquare()
- * @desc: This function takes in a square location, and finds all potential legal moves for the knight if it was placed there.
- * @param1/param2: X/Y co-ords of the knight's location
- * @param3/param4: Board dimensions (X/Y)
- * @param5: The chessboard, passed by reference
- * @return: Returns a vector array of int pairs. These are all the knights legal next moves (as X/Y co-ords)
- *
+ * Function: checkLatencyReport()
+ * @desc: Prints the latency report if SIGUSR1 has asked for one since the last check.
+ * @param: The latencies, or nullptr if they are not being recorded
  */
-std::vector<std::pair<int,int>> findMovesFromSquare(int x, int y, int boardX, int boardY, std::vector<std::vector<int>>& Board) {
-    std::vector<std::pair<int,int>> moveArray;
-    int dx[] = { 2, 1, -1, -2, -2, -1, 1, 2 };
-    int dy[] = { 1, 2, 2, 1, -1, -2, -2, -1 };
-    for (int i = 0; i < 8; i++) {
-        int newX = x + dx[i];
-        int newY = y + dy[i];
-        if (isOnBoard(newX, newY, boardX, boardY) && Board[newX][newY] != 2) {
-            moveArray.push_back(std::pair<int, int>(newX, newY));
-        }
+void checkLatencyReport(const LatencyReport* latencies) {
+    if (latencies != nullptr && latencyReportRequested) {
+        latencyReportRequested = 0;
+        printLatencyReport(*latencies);
     }
-    return moveArray;
 }
 
-
 /*
- * Function: makeMove()
- * @desc: This is the central function that calls itself recursively, which moves the knight around the chessboard.
- *        It finds the best legal move. This is the move that has the fewest amount of continuing moves. It calls
- *        findMovesFromSquare() twice, to get the inital and continuing moves, and finds the square with the least
- *        amount, by storing them all and sorting their continuing move sizes in descending order. Once it has the
- *        best move, it sets the current board square to visited (2), and the next board square to the current one (1).
- *        It will keep calling itself while it still has legal moves to make.
- *
- * @param1: This is the Board itself
- * @param2/param3: The boards X/Y dimensions
- * @param4/param5: The current Knight's X/Y co-ords
- * @param6: The amount of moves made, passed by reference from main(). This is used to deduce the final text output.
- */
-void makeMove(std::vector<std::vector<int>> Board, int boardX, int boardY, int knightRow, int knightCol, int& movesMade) {
-    std::vector<int> sizes;
-    std::vector<std::pair<int, int>> array = findMovesFromSquare(knightRow, knightCol, boardX, boardY, Board);
-    //while there are moves, loop:
-    if (!array.empty()) {
-        //get the amount of continuing moves for each legal move
-        for (std::pair<int, int> p : array) {
-            sizes.push_back(findMovesFromSquare(p.first, p.second, boardX, boardY, Board).size());
-        }
-        //find the one with the fewest
-        int index = findMinimumIndex(sizes);
-        std::pair<int, int> nextMove = array[index];
-        //set up a knight move to the new square, then call this function again
-        Board[knightRow][knightCol] = 2;
-        Board[nextMove.first][nextMove.second] = 1;
-        knightRow = nextMove.first;
-        knightCol = nextMove.second;
+ * Function: printTour()
+ * @desc: Replays a finished tour on an empty board, printing the board after the knight is placed and after every move,
+ *        exactly as the knight moved through it.
+ * @param1/param2: The boards X/Y dimensions
+ * @param3: The tour to replay (the squares in the order they were visited, as square indexes)
+ * @param4: How many squares are in the tour
+ * @param5: Where to record how long each board takes to print, or nullptr to not time them
+ */
+void printTour(int boardX, int boardY, const uint32_t* tour, size_t length, LatencyReport* latencies) {
+    std::vector<std::vector<int>> Board(boardX, std::vector<int>(boardY));
+    for (size_t i = 0; i < length; i++) {
+        uint64_t began = (latencies != nullptr) ? readLatencyClock() : 0;
+        if (i > 0) {
+            Board[tour[i - 1] / boardY][tour[i - 1] % boardY] = 2;
+        }
+        Board[tour[i] / boardY][tour[i] % boardY] = 1;
         printBoard(Board);
-        movesMade++;
-        makeMove(Board, boardX, boardY, knightRow, knightCol, movesMade);
-
+        if (latencies != nullptr) {
+            latencies->render.recordSince(began);
+            checkLatencyReport(latencies);
+        }
     }
 }
 
+
+
 /*
  * Function: inputInteger()
  * @desc: A small helper function that gets an integer from the command line. It will repeat until iit finds an
@@ -174,29 +187,1112 @@ std::pair<int,int> getPairFromUser(int lowerBound, int upperBound, int lowerBoun
 }
 
 
-//This is the main method. First a string description of the program is printed, then the user inputs a board size (X/Y), then the Knight's starting square.
-//The board is initialised internally as a vector array with 0s. The knight is placed on a starting square and this board state is printed. makeMove() is
-//then called, which calls itself while there are still valid moves to make. Once there are no more moves, based on the number of moves successfully made,
-//a final text output showing the result of the tour is printed.
-int main() {
-    std::cout << "This program attempts an open Knight Tour using Warnsdorff's algorithm. Please specify square/rectangular board dimensions, and the Knight's starting square." << std::endl;
-    std::pair<int,int> boardSize = getPairFromUser(3,10,3,10,"Enter number of rows (between 3-10):","Enter number of columns (between 3-10):", 0);
-    std::pair<int,int> start = getPairFromUser(1,boardSize.first, 1, boardSize.second, "Enter starting row of knight:", "Enter starting column of knight:", 1);
+//Board sides accepted from the command line and in batch mode. There is no display to fit on screen, so this is only
+//here to keep one bad line from allocating an enormous board. The interactive prompts stick to 3-10 (apart from strips).
+const int MAX_BOARD_SIZE = 1000;
+
+//Strips (boards with a side of 3 or 4) can be far longer than that, up to this many columns, since the transfer matrix
+//search (see TransferMatrix.h) works along them a column at a time. --count takes strips of up to 10^18 columns.
+const int MAX_STRIP_LENGTH = 2000000;
+const uint64_t MAX_COUNT_STRIP_LENGTH = 1000000000000000000ull;
+
+/*
+ * Function: isBoardSizeAllowed()
+ * @desc: Checks a board size from the command line or a batch line against MAX_BOARD_SIZE and MAX_STRIP_LENGTH.
+ * @param1/param2: The board's X/Y dimensions
+ * @return: Returns true if the board can be solved, false if it is too big (or has a side under 1).
+ */
+bool isBoardSizeAllowed(int boardX, int boardY) {
+    int shortSide = std::min(boardX, boardY);
+    int longSide = std::max(boardX, boardY);
+    if (shortSide < 1) return false;
+    return longSide <= ((shortSide == 3 || shortSide == 4) ? MAX_STRIP_LENGTH : MAX_BOARD_SIZE);
+}
+
+/*
+ * Struct: TourJob
+ * @desc: One line of a batch file, once it has been parsed. A line looks like "rows cols startRow startCol [options]",
+ *        with the starting square indexed from 1 like the interactive prompts. The options are "notour", which leaves the
+ *        tour itself out of the result, "closed", which asks for a closed tour, "holes=R,C;R,C", which takes those
+ *        squares off the board, and "algorithm=NAME"/"heuristic=NAME", which override the defaults given on the command
+ *        line. If the line could not be parsed, error says why.
+ */
+struct TourJob {
+    int boardX = 0;
+    int boardY = 0;
+    std::pair<int,int> start;
+    std::vector<std::pair<int,int>> holes;
+    SolveOptions options;
+    bool includeTour = true;
+    std::string error;
+};
+
+/*
+ * Struct: InputBuffer
+ * @desc: The whole batch input, as one block of memory. Regular files are memory mapped, anything else (stdin, pipes)
+ *        is read into storage, since those cannot be mapped.
+ */
+struct InputBuffer {
+    const char* data = nullptr;
+    size_t size = 0;
+    void* mapping = nullptr;
+    std::vector<char> storage;
+};
+
+/*
+ * Function: openInputBuffer()
+ * @desc: Loads the batch input into an InputBuffer. "-" means stdin.
+ * @param1: The path of the batch file, passed by reference
+ * @param2: The buffer to fill, passed by reference
+ * @return: Returns true if the input could be read, false if not.
+ */
+bool openInputBuffer(const std::string& path, InputBuffer& buffer) {
+    int fd = (path == "-") ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+            buffer.mapping = mapping;
+            buffer.data = static_cast<const char*>(mapping);
+            buffer.size = info.st_size;
+            if (fd != STDIN_FILENO) close(fd);
+            return true;
+        }
+    }
+    //not mappable, so read it all in
+    char chunk[1 << 16];
+    ssize_t bytesRead;
+    while ((bytesRead = read(fd, chunk, sizeof(chunk))) > 0) {
+        buffer.storage.insert(buffer.storage.end(), chunk, chunk + bytesRead);
+    }
+    if (fd != STDIN_FILENO) close(fd);
+    if (bytesRead < 0) return false;
+    buffer.data = buffer.storage.data();
+    buffer.size = buffer.storage.size();
+    return true;
+}
+
+/*
+ * Function: closeInputBuffer()
+ * @desc: Releases the memory behind an InputBuffer.
+ * @param: The buffer, passed by reference
+ */
+void closeInputBuffer(InputBuffer& buffer) {
+    if (buffer.mapping != nullptr) {
+        munmap(buffer.mapping, buffer.size);
+        buffer.mapping = nullptr;
+    }
+    buffer.storage.clear();
+    buffer.data = nullptr;
+    buffer.size = 0;
+}
+
+/*
+ * Function: splitLines()
+ * @desc: Finds the start of every job line in the buffer. Blank lines and lines starting with '#' are skipped, but
+ *        line numbers still count them so errors point at the right place in the file.
+ * @param1: The batch input, passed by reference
+ * @param2/param3: Filled with the offset of each job line, and its line number in the file (from 1)
+ */
+void splitLines(const InputBuffer& buffer, std::vector<size_t>& offsets, std::vector<size_t>& lineNumbers) {
+    size_t lineNumber = 0;
+    size_t position = 0;
+    while (position < buffer.size) {
+        lineNumber++;
+        const char* end = static_cast<const char*>(memchr(buffer.data + position, '\n', buffer.size - position));
+        size_t next = (end == nullptr) ? buffer.size : (end - buffer.data) + 1;
+        size_t first = position;
+        while (first < next && (buffer.data[first] == ' ' || buffer.data[first] == '\t')) first++;
+        if (first < next && buffer.data[first] != '\n' && buffer.data[first] != '\r' && buffer.data[first] != '#') {
+            offsets.push_back(position);
+            lineNumbers.push_back(lineNumber);
+        }
+        position = next;
+    }
+}
+
+/*
+ * Function: parseAlgorithm()
+ * @desc: Turns an algorithm name from the command line or a batch line into an Algorithm.
+ * @param1: The name, passed by reference
+ * @param2: Set to the algorithm, passed by reference
+ * @return: Returns true if the name is known, false if not.
+ */
+bool parseAlgorithm(const std::string& name, Algorithm& algorithm) {
+    if (name == "warnsdorff") {
+        algorithm = Algorithm::Warnsdorff;
+        return true;
+    }
+    if (name == "transfer") {
+        algorithm = Algorithm::TransferMatrix;
+        return true;
+    }
+    if (name == "lds") {
+        algorithm = Algorithm::LimitedDiscrepancy;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Function: parseHeuristic()
+ * @desc: Turns a heuristic name from the command line or a batch line into a Heuristic.
+ * @param1: The name, passed by reference
+ * @param2: Set to the heuristic, passed by reference
+ * @return: Returns true if the name is known, false if not.
+ */
+bool parseHeuristic(const std::string& name, Heuristic& heuristic) {
+    if (name == "warnsdorff") {
+        heuristic = Heuristic::Warnsdorff;
+        return true;
+    }
+    if (name == "roth") {
+        heuristic = Heuristic::Roth;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Function: parseSquareList()
+ * @desc: Reads a list of squares like "2,3;5,5" (each "row,col", indexed from 1, separated by ';'), as used for holes.
+ * @param1: The text, passed by reference
+ * @param2: Set to the squares, indexed from 0, passed by reference
+ * @return: Returns true if the whole text is such a list, false if not.
+ */
+bool parseSquareList(const std::string& text, std::vector<std::pair<int,int>>& squares) {
+    squares.clear();
+    const char* first = text.data();
+    const char* last = first + text.size();
+    while (true) {
+        int row;
+        int col;
+        std::from_chars_result result = std::from_chars(first, last, row);
+        if (result.ec != std::errc() || result.ptr == last || *result.ptr != ',') return false;
+        result = std::from_chars(result.ptr + 1, last, col);
+        if (result.ec != std::errc() || row < 1 || col < 1) return false;
+        squares.push_back(std::pair<int,int>(row - 1, col - 1));
+        if (result.ptr == last) return true;
+        if (*result.ptr != ';') return false;
+        first = result.ptr + 1;
+    }
+}
+
+/*
+ * Function: parseTourJob()
+ * @desc: Parses one batch line with std::from_chars, straight out of the buffer. Bad lines are not fatal, they just
+ *        carry an error into their result.
+ * @param1/param2: The first character of the line, and the end of the whole buffer
+ * @param3: The options used when the line does not override them, passed by reference
+ * @return: The parsed job.
+ */
+TourJob parseTourJob(const char* first, const char* last, const SolveOptions& defaults) {
+    TourJob job;
+    job.options = defaults;
+    const char* end = static_cast<const char*>(memchr(first, '\n', last - first));
+    if (end != nullptr) last = end;
+    auto skipSpaces = [&]() {
+        while (first < last && (*first == ' ' || *first == '\t' || *first == '\r')) first++;
+    };
+    int values[4];
+    for (int& value : values) {
+        skipSpaces();
+        std::from_chars_result result = std::from_chars(first, last, value);
+        if (result.ec != std::errc()) {
+            job.error = "expected: rows cols startRow startCol [options]";
+            return job;
+        }
+        first = result.ptr;
+    }
+    job.boardX = values[0];
+    job.boardY = values[1];
+    if (!isBoardSizeAllowed(job.boardX, job.boardY)) {
+        job.error = "board size must be between 1 and " + std::to_string(MAX_BOARD_SIZE) + " (or up to "
+                    + std::to_string(MAX_STRIP_LENGTH) + " long with a side of 3 or 4)";
+        return job;
+    }
+    if (values[2] < 1 || values[2] > job.boardX || values[3] < 1 || values[3] > job.boardY) {
+        job.error = "starting square is not on the board";
+        return job;
+    }
+    job.start = std::pair<int,int>(values[2] - 1, values[3] - 1);
+    while (true) {
+        skipSpaces();
+        if (first == last) break;
+        const char* word = first;
+        while (first < last && *first != ' ' && *first != '\t' && *first != '\r') first++;
+        std::string option(word, first);
+        bool known = false;
+        if (option == "notour") {
+            job.includeTour = false;
+            known = true;
+        }
+        else if (option == "closed") {
+            job.options.closed = true;
+            known = true;
+        }
+        else if (option.compare(0, 10, "algorithm=") == 0) {
+            known = parseAlgorithm(option.substr(10), job.options.algorithm);
+        }
+        else if (option.compare(0, 10, "heuristic=") == 0) {
+            known = parseHeuristic(option.substr(10), job.options.heuristic);
+        }
+        else if (option.compare(0, 6, "holes=") == 0) {
+            known = parseSquareList(option.substr(6), job.holes);
+            for (const std::pair<int,int>& hole : job.holes) {
+                if (known && (hole.first >= job.boardX || hole.second >= job.boardY)) {
+                    job.error = "hole is not on the board";
+                    return job;
+                }
+            }
+        }
+        if (!known) {
+            job.error = "unknown option: " + option;
+            return job;
+        }
+    }
+    return job;
+}
+
+/*
+ * Function: appendNumber()
+ * @desc: A small helper that appends an integer to a string, for building JSON without going through a stream.
+ * @param1: The string to append to, passed by reference
+ * @param2: The number
+ */
+void appendNumber(std::string& out, long long number) {
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), number);
+    out.append(digits, result.ptr);
+}
+
+/*
+ * Function: appendTourJson()
+ * @desc: Appends the result of a solved job as JSON fields (without the surrounding braces). Squares are indexed from
+ *        1, the same as the input. "complete" is only true if the job was answered: the tour covers the board, the
+ *        problem was not impossible, and for a closed job, the tour is closed (an open tour found instead is not).
+ * @param1: The string to append to, passed by reference
+ * @param2: The job, passed by reference
+ * @param3: The solver that solved it, passed by reference
+ * @param4/param5: The tour it found (as square indexes), and how many squares are in it
+ */
+void appendTourJson(std::string& out, const TourJob& job, const KnightTourSolver& solver, const uint32_t* tour, size_t length) {
+    out += "\"rows\":";
+    appendNumber(out, job.boardX);
+    out += ",\"cols\":";
+    appendNumber(out, job.boardY);
+    out += ",\"start\":[";
+    appendNumber(out, job.start.first + 1);
+    out += ',';
+    appendNumber(out, job.start.second + 1);
+    out += "],\"moves\":";
+    appendNumber(out, length - 1);
+    out += ",\"complete\":";
+    bool closed = isClosedTour(job.boardX, job.boardY, tour, length, solver.tourSquares());
+    bool complete = length == solver.tourSquares() && !solver.impossible() && (closed || !job.options.closed);
+    out += complete ? "true" : "false";
+    out += ",\"closed\":";
+    out += closed ? "true" : "false";
+    out += ",\"impossible\":";
+    out += solver.impossible() ? "true" : "false";
+    if (solver.impossible()) {
+        out += ",\"reason\":\"";
+        out += solver.impossibleReason();
+        out += '"';
+    }
+    if (job.includeTour) {
+        out += ",\"tour\":[";
+        for (size_t i = 0; i < length; i++) {
+            if (i > 0) out += ',';
+            out += '[';
+            appendNumber(out, tour[i] / job.boardY + 1);
+            out += ',';
+            appendNumber(out, tour[i] % job.boardY + 1);
+            out += ']';
+        }
+        out += ']';
+    }
+}
+
+/*
+ * Function: runTourJob()
+ * @desc: Runs one batch job and writes its result as a single line of JSON.
+ * @param1: The job, passed by reference
+ * @param2: The line number the job came from
+ * @param3: The solver to run it on, passed by reference
+ * @param4: Space for the tour, passed by reference. It is grown to fit if needed.
+ * @param5: The stats to time writing the result in, passed by reference
+ * @param6: Where to record how long writing the result takes, or nullptr to not time it
+ * @return: The JSON line, including its newline.
+ */
+std::string runTourJob(const TourJob& job, size_t lineNumber, KnightTourSolver& solver, std::vector<uint32_t>& tour, SolverStats& stats,
+                       LatencyReport* latencies) {
+    std::string out = "{\"line\":";
+    appendNumber(out, lineNumber);
+    if (!job.error.empty()) {
+        out += ",\"error\":\"";
+        for (char c : job.error) {
+            if (c == '"' || c == '\\') out += '\\';
+            if ((unsigned char)c >= 0x20) out += c;
+        }
+        out += "\"}\n";
+        return out;
+    }
+    solver.setGeometry(job.boardX, job.boardY);
+    solver.setHoles(job.holes);
+    solver.setOptions(job.options);
+    if (tour.size() < solver.squares()) tour.resize(solver.squares());
+    size_t length = solver.solve(job.start.first, job.start.second, tour.data());
+    KT_TIME_PHASE(stats, PHASE_RENDER);
+    TraceScope trace("appendTourJson", "render", length);
+    uint64_t began = (latencies != nullptr) ? readLatencyClock() : 0;
+    out += ',';
+    appendTourJson(out, job, solver, tour.data(), length);
+    out += "}\n";
+    if (latencies != nullptr) latencies->render.recordSince(began);
+    return out;
+}
+
+/*
+ * Function: printStats()
+ * @desc: Prints what the solver did (see SolverStats) to stderr, so it never mixes with the tours on stdout. In batch
+ *        mode the stats of every thread are added together, so the phase times are summed over the threads too.
+ * @param: The stats, passed by reference
+ */
+void printStats([[maybe_unused]] const SolverStats& stats) {
+#ifdef KT_ENABLE_STATS
+    const char* phaseNames[PHASE_COUNT] = { "input", "setup", "solve", "render" };
+    std::cerr << "Stats:\n"
+              << "  moves made            " << stats.moves << "\n"
+              << "  candidates evaluated  " << stats.candidates << "\n"
+              << "  degree ties           " << stats.ties << "\n"
+              << "  dead-ends             " << stats.deadEnds << "\n"
+              << "  backtracks            " << stats.backtracks << "\n"
+              << "  restarts              " << stats.restarts << "\n"
+              << "  pruned                " << stats.pruned << " of " << stats.pruneChecks << " moves checked";
+    if (stats.pruneChecks > 0) std::cerr << " (" << 100.0 * stats.pruned / stats.pruneChecks << "%)";
+    std::cerr << "\n";
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        std::cerr << "  " << phaseNames[i] << " time" << std::string(17 - strlen(phaseNames[i]), ' ')
+                  << stats.phaseNanoseconds[i] / 1e6 << " ms\n";
+    }
+    std::cerr.flush();
+#else
+    std::cerr << "Stats were not compiled in (build with -DKNIGHTTOUR_STATS=ON)" << std::endl;
+#endif
+}
+
+/*
+ * Function: runBatch()
+ * @desc: Batch mode. Reads every job from the input, solves them on a pool of threads, and writes one JSON line per job
+ *        to stdout in the same order as the input. Every thread has its own KnightTourSolver, and takes the next job off a
+ *        shared atomic counter. The
+ *        main thread writes results out as soon as the next one in order is ready, and solves jobs itself while it
+ *        waits, so a single thread works too.
+ * @param1: The path of the batch file ("-" for stdin), passed by reference
+ * @param2: How many threads to solve on, including the main thread. 0 means one per core.
+ * @param3: The options used for lines that do not override them, passed by reference
+ * @param4: The tour cache to use, or nullptr for none. It is shared by every thread.
+ * @param5: The tour database to use, or nullptr for none. It is shared by every thread.
+ * @param6: Whether to print the stats of every thread added together at the end (see printStats())
+ * @param7: Where every thread records its latencies, or nullptr to not time them
+ * @return: The exit code for main().
+ */
+int runBatch(const std::string& path, int threadCount, const SolveOptions& defaults, const TourCache* cache, const TourDatabase* database,
+             bool showStats, LatencyReport* latencies) {
+    SolverStats stats;
+    InputBuffer buffer;
+    std::vector<size_t> offsets;
+    std::vector<size_t> lineNumbers;
+    {
+        KT_TIME_PHASE(stats, PHASE_INPUT);
+        if (!openInputBuffer(path, buffer)) {
+            std::cerr << "Could not read batch input: " << path << std::endl;
+            return 1;
+        }
+        splitLines(buffer, offsets, lineNumbers);
+    }
+
+    size_t jobCount = offsets.size();
+    std::vector<std::string> results(jobCount);
+    std::unique_ptr<std::atomic<bool>[]> ready(new std::atomic<bool>[jobCount]);
+    for (size_t i = 0; i < jobCount; i++) ready[i].store(false, std::memory_order_relaxed);
+    std::atomic<size_t> nextJob(0);
+
+    //solves the next unclaimed job on the calling thread's solver, returns false once there are none left
+    auto solveNext = [&](KnightTourSolver& solver, std::vector<uint32_t>& tour, SolverStats& threadStats) {
+        size_t i = nextJob.fetch_add(1, std::memory_order_relaxed);
+        if (i >= jobCount) return false;
+        TourJob job;
+        {
+            KT_TIME_PHASE(threadStats, PHASE_INPUT);
+            job = parseTourJob(buffer.data + offsets[i], buffer.data + buffer.size, defaults);
+        }
+        results[i] = runTourJob(job, lineNumbers[i], solver, tour, threadStats, latencies);
+        ready[i].store(true, std::memory_order_release);
+        return true;
+    };
+
+    if (threadCount <= 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    auto makeSolver = [&]() {
+        KnightTourSolver solver(defaults);
+        solver.setCache(cache);
+        solver.setDatabase(database);
+        if (latencies != nullptr) solver.setMoveLatencies(&latencies->moves);
+        return solver;
+    };
+    //every thread counts into its own stats, and adds them onto the shared ones once when it finishes
+    std::mutex statsMutex;
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threadCount; t++) {
+        workers.emplace_back([&]() {
+            nameTraceThread("batch worker");
+            KnightTourSolver solver = makeSolver();
+            std::vector<uint32_t> tour;
+            SolverStats threadStats;
+            while (solveNext(solver, tour, threadStats)) {}
+            std::lock_guard<std::mutex> lock(statsMutex);
+            stats.add(solver.stats());
+            stats.add(threadStats);
+        });
+    }
+    KnightTourSolver solver = makeSolver();
+    std::vector<uint32_t> tour;
+    SolverStats threadStats;
+    std::ios::sync_with_stdio(false);
+    for (size_t written = 0; written < jobCount; written++) {
+        while (!ready[written].load(std::memory_order_acquire)) {
+            if (!solveNext(solver, tour, threadStats)) std::this_thread::yield();
+        }
+        KT_TIME_PHASE(threadStats, PHASE_RENDER);
+        TraceScope trace("write", "output", results[written].size());
+        std::cout.write(results[written].data(), results[written].size());
+        std::string().swap(results[written]);
+        checkLatencyReport(latencies);
+    }
+    {
+        TraceScope trace("flush", "output");
+        std::cout.flush();
+    }
+    for (std::thread& worker : workers) worker.join();
+    closeInputBuffer(buffer);
+    if (showStats) {
+        stats.add(solver.stats());
+        stats.add(threadStats);
+        printStats(stats);
+    }
+    return 0;
+}
+
+/*
+ * Enum: OutputFormat
+ * @desc: How a single tour is shown once it has been found.
+ *        Board = every move, one board after another (the original display)
+ *        Final = one board, with the move number the knight landed on each square
+ *        Moves = the squares visited, one "row col" pair per line
+ *        Json  = one line of JSON, the same as a batch result
+ *        None  = just whether the tour was completed
+ */
+enum class OutputFormat { Board, Final, Moves, Json, None };
+
+/*
+ * Struct: CommandLine
+ * @desc: Everything that can be given on the command line. A board size or starting square left at 0 was not given,
+ *        and will be asked for with the prompts instead.
+ */
+struct CommandLine {
+    int boardX = 0;
+    int boardY = 0;
+    std::pair<int,int> start = std::pair<int,int>(0, 0);
+    std::vector<std::pair<int,int>> holes;
+    SolveOptions options;
+    bool algorithmGiven = false;
+    uint64_t countLength = 0;
+    OutputFormat format = OutputFormat::Board;
+    int threads = 0;
+    std::string batchPath;
+    std::string cachePath;
+    std::string databasePath;
+    std::string buildDatabasePath;
+    int maxSize = 64;
+    bool stats = false;
+    std::string tracePath;
+    bool latency = false;
+    bool count = false;
+    int splitDepth = 8;
+    bool diagram = false;
+    std::string spillPath;
+    int memoryLimit = 2048;
+};
+
+/*
+ * Function: printUsage()
+ * @desc: Prints the command line options.
+ * @param: The name the program was run as
+ */
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --rows N               number of rows on the board\n"
+              << "  --cols N               number of columns on the board\n"
+              << "  --size RxC             both at once, e.g. 8x8\n"
+              << "  --start R,C            the knight's starting square, indexed from 1\n"
+              << "  --algorithm NAME       warnsdorff, transfer (exact, for boards with a side of 3 or 4; the default for\n"
+              << "                         them outside batch mode), or lds (warnsdorff, then a limited discrepancy search\n"
+              << "                         if it fails)\n"
+              << "  --heuristic NAME       tie-break between equal moves: warnsdorff (default) or roth\n"
+              << "  --closed               look for a closed tour (one that ends a knight's move from the start)\n"
+              << "  --holes R,C;R,C        squares taken off the board, indexed from 1, which the tour has to go around\n"
+              << "  --format NAME          board (default), final, moves, json or none\n"
+              << "  --threads N            threads used in batch mode (default: one per core)\n"
+              << "  --cache DIR            keep found tours in DIR and reuse them on later runs\n"
+              << "  --database FILE        look tours up in a database made with --build-database first\n"
+              << "  --build-database FILE  solve every board up to --max-size and store the tours in FILE\n"
+              << "  --max-size N           the largest board side --build-database covers (default 64)\n"
+              << "  --batch FILE           solve every line of FILE (- for stdin) and print JSON Lines\n"
+              << "  --stats                print what the solver did and how long each phase took, to stderr\n"
+              << "  --latency              time every move and every board shown, and print percentiles to stderr at exit\n"
+              << "                         (or whenever SIGUSR1 is received)\n"
+              << "  --trace FILE           write a timeline of what every thread did to FILE (Chrome trace JSON) at exit\n"
+              << "  --count                count every tour (or with --closed, every closed tour) from --start, or from every\n"
+              << "                         square, on a board of up to 64 squares, using --threads. Strips (3xN or 4xN)\n"
+              << "                         of any length up to 10^18 are counted modulo 1000000007 instead.\n"
+              << "  --split-depth N        how many moves in --count splits the search into tasks (default 8)\n"
+              << "  --diagram              count closed tours with a decision diagram instead (the default for boards over\n"
+              << "                         64 squares), using --threads\n"
+              << "  --spill DIR            with --diagram, write levels bigger than --memory-limit to files in DIR\n"
+              << "  --memory-limit MB      how much memory a level being built may take before --spill writes it out\n"
+              << "                         (default 2048). The level before it can take as much again.\n"
+              << "Anything not given is asked for interactively." << std::endl;
+}
+
+/*
+ * Function: parseIntegerArgument()
+ * @desc: Reads a whole integer out of a command line argument (or part of one), with bounds (inclusive).
+ * @param1: The text, passed by reference
+ * @param2/param3: lower/upper integer bounds
+ * @param4: Set to the integer, passed by reference
+ * @return: Returns true if the text is an integer within the bounds, false if not.
+ */
+bool parseIntegerArgument(const std::string& text, int lowerBound, int upperBound, int& value) {
+    std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size() && value >= lowerBound && value <= upperBound;
+}
+
+/*
+ * Function: parseIntegerPair()
+ * @desc: Reads two integers separated by a character, like "8x8" or "1,1".
+ * @param1: The text, passed by reference
+ * @param2: The separator
+ * @param3/param4: lower/upper bounds for both integers (inclusive)
+ * @param5: Set to the pair, passed by reference
+ * @return: Returns true if both parts are integers within the bounds, false if not.
+ */
+bool parseIntegerPair(const std::string& text, char separator, int lowerBound, int upperBound, std::pair<int,int>& value) {
+    size_t split = text.find(separator);
+    return split != std::string::npos
+           && parseIntegerArgument(text.substr(0, split), lowerBound, upperBound, value.first)
+           && parseIntegerArgument(text.substr(split + 1), lowerBound, upperBound, value.second);
+}
+
+/*
+ * Function: parseCountStripSize()
+ * @desc: Reads a --size too long for a board to be solved, but not too long for its tours to be counted: "3xN" or
+ *        "4xN", with N up to MAX_COUNT_STRIP_LENGTH.
+ * @param1: The text, passed by reference
+ * @param2: Set to the number of rows, passed by reference
+ * @param3: Set to the length, passed by reference
+ * @return: Returns true if the text is such a size, false if not.
+ */
+bool parseCountStripSize(const std::string& text, int& rows, uint64_t& length) {
+    size_t split = text.find('x');
+    if (split == std::string::npos || !parseIntegerArgument(text.substr(0, split), 3, 4, rows)) return false;
+    const char* first = text.data() + split + 1;
+    const char* last = text.data() + text.size();
+    std::from_chars_result result = std::from_chars(first, last, length);
+    return result.ec == std::errc() && result.ptr == last && length > (uint64_t)MAX_STRIP_LENGTH && length <= MAX_COUNT_STRIP_LENGTH;
+}
 
-    //initialise board with 0s
-    std::vector<std::vector<int>> Board(boardSize.first, std::vector<int>(boardSize.second));
+/*
+ * Function: parseCommandLine()
+ * @desc: Reads the command line options into a CommandLine. Errors are reported to stderr.
+ * @param1/param2: main()'s argc/argv
+ * @param3: Filled with the options, passed by reference
+ * @return: Returns 0 if the program should carry on, or the exit code it should stop with (--help exits straight away).
+ */
+int parseCommandLine(int argc, char* argv[], CommandLine& commandLine) {
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage(argv[0]);
+            return -1;
+        }
+        if (option == "--closed") {
+            commandLine.options.closed = true;
+            continue;
+        }
+        if (option == "--stats") {
+            commandLine.stats = true;
+            continue;
+        }
+        if (option == "--latency") {
+            commandLine.latency = true;
+            continue;
+        }
+        if (option == "--count") {
+            commandLine.count = true;
+            continue;
+        }
+        if (option == "--diagram") {
+            commandLine.diagram = true;
+            continue;
+        }
+        const std::vector<std::string> options = { "--rows", "--cols", "--size", "--start", "--holes", "--algorithm", "--heuristic", "--format", "--threads", "--batch", "--cache",
+                                                 "--database", "--build-database", "--max-size", "--trace",
+                                                 "--split-depth", "--spill", "--memory-limit" };
+        if (std::find(options.begin(), options.end(), option) == options.end()) {
+            std::cerr << "Unknown option: " << option << " (see --help)" << std::endl;
+            return 1;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << option << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        bool valid;
+        if (option == "--rows") {
+            valid = parseIntegerArgument(value, 1, MAX_STRIP_LENGTH, commandLine.boardX);
+        }
+        else if (option == "--cols") {
+            valid = parseIntegerArgument(value, 1, MAX_STRIP_LENGTH, commandLine.boardY);
+        }
+        else if (option == "--size") {
+            std::pair<int,int> size;
+            commandLine.countLength = 0;
+            valid = parseIntegerPair(value, 'x', 1, MAX_STRIP_LENGTH, size);
+            if (!valid && parseCountStripSize(value, size.first, commandLine.countLength)) {
+                size.second = MAX_STRIP_LENGTH;
+                valid = true;
+            }
+            commandLine.boardX = size.first;
+            commandLine.boardY = size.second;
+        }
+        else if (option == "--start") {
+            valid = parseIntegerPair(value, ',', 1, MAX_STRIP_LENGTH, commandLine.start);
+        }
+        else if (option == "--holes") {
+            valid = parseSquareList(value, commandLine.holes);
+        }
+        else if (option == "--algorithm") {
+            valid = parseAlgorithm(value, commandLine.options.algorithm);
+            commandLine.algorithmGiven = true;
+        }
+        else if (option == "--heuristic") {
+            valid = parseHeuristic(value, commandLine.options.heuristic);
+        }
+        else if (option == "--format") {
+            valid = true;
+            if (value == "board") commandLine.format = OutputFormat::Board;
+            else if (value == "final") commandLine.format = OutputFormat::Final;
+            else if (value == "moves") commandLine.format = OutputFormat::Moves;
+            else if (value == "json") commandLine.format = OutputFormat::Json;
+            else if (value == "none") commandLine.format = OutputFormat::None;
+            else valid = false;
+        }
+        else if (option == "--threads") {
+            valid = parseIntegerArgument(value, 0, 1024, commandLine.threads);
+        }
+        else if (option == "--database") {
+            commandLine.databasePath = value;
+            valid = !value.empty();
+        }
+        else if (option == "--build-database") {
+            commandLine.buildDatabasePath = value;
+            valid = !value.empty();
+        }
+        else if (option == "--max-size") {
+            valid = parseIntegerArgument(value, 1, MAX_BOARD_SIZE, commandLine.maxSize);
+        }
+        else if (option == "--cache") {
+            commandLine.cachePath = value;
+            valid = !value.empty();
+        }
+        else if (option == "--trace") {
+            commandLine.tracePath = value;
+            valid = !value.empty();
+        }
+        else if (option == "--split-depth") {
+            valid = parseIntegerArgument(value, 0, MAX_COUNT_SQUARES, commandLine.splitDepth);
+        }
+        else if (option == "--spill") {
+            commandLine.spillPath = value;
+            valid = !value.empty();
+        }
+        else if (option == "--memory-limit") {
+            valid = parseIntegerArgument(value, 1, 1 << 24, commandLine.memoryLimit);
+        }
+        else {
+            commandLine.batchPath = value;
+            valid = true;
+        }
+        if (!valid) {
+            std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+            return 1;
+        }
+    }
+    if (commandLine.countLength > 0 && !commandLine.count) {
+        std::cerr << "Strips longer than " << MAX_STRIP_LENGTH << " can only be counted (--count)" << std::endl;
+        return 1;
+    }
+    if (commandLine.boardX > 0 && commandLine.boardY > 0 && !isBoardSizeAllowed(commandLine.boardX, commandLine.boardY)) {
+        std::cerr << "Board sides can be at most " << MAX_BOARD_SIZE << ", or " << MAX_STRIP_LENGTH
+                  << " when the other side is 3 or 4" << std::endl;
+        return 1;
+    }
+    if (commandLine.start.first > 0 && commandLine.boardX > 0 && commandLine.boardY > 0
+        && (commandLine.start.first > commandLine.boardX || commandLine.start.second > commandLine.boardY)) {
+        std::cerr << "The starting square is not on the board" << std::endl;
+        return 1;
+    }
+    if (!commandLine.holes.empty() && (commandLine.count || !commandLine.batchPath.empty() || !commandLine.buildDatabasePath.empty())) {
+        std::cerr << "--holes only applies to solving one board (batch lines take holes=R,C;R,C instead)" << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
-    //place knight on starting square
-    Board[start.first][start.second] = 1;
-    printBoard(Board);
+/*
+ * Function: printMoveNumbers()
+ * @desc: Prints the whole tour as one board, with the move number the knight landed on each square (the start is 1).
+ *        Squares the knight never reached are left blank.
+ * @param1/param2: The boards X/Y dimensions
+ * @param3: The tour, as square indexes
+ * @param4: How many squares are in the tour
+ */
+void printMoveNumbers(int boardX, int boardY, const uint32_t* tour, size_t length) {
+    std::vector<std::vector<int>> Board(boardX, std::vector<int>(boardY));
+    for (size_t i = 0; i < length; i++) {
+        Board[tour[i] / boardY][tour[i] % boardY] = i + 1;
+    }
+    int width = std::to_string(boardX * boardY).size();
+    for (int i = 0; i < boardX; i++) {
+        for (int j = 0; j < boardY; j++) {
+            std::string number = Board[i][j] > 0 ? std::to_string(Board[i][j]) : "";
+            std::cout << "[" << std::string(width - number.size(), ' ') << number << "]";
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::endl;
+}
 
-    int movesMade = 0;
-    makeMove(Board, boardSize.first, boardSize.second, start.first, start.second, movesMade);
-    if (movesMade == (boardSize.first * boardSize.second) - 1) {
+/*
+ * Function: showTour()
+ * @desc: Shows a single tour in the format asked for on the command line, then (apart from JSON) a line saying how
+ *        the tour went.
+ * @param1: The command line, passed by reference
+ * @param2: The solver that found the tour, passed by reference
+ * @param3: The board's dimensions (X/Y)
+ * @param4: The knight's starting square (indexed from 0)
+ * @param5/param6: The tour (as square indexes), and how many squares are in it
+ * @param7: The stats to time this in, passed by reference
+ * @param8: Where to record how long showing the tour takes, or nullptr to not time it. When every move is printed, each
+ *          board is timed on its own.
+ */
+void showTour(const CommandLine& commandLine, const KnightTourSolver& solver, std::pair<int,int> boardSize, std::pair<int,int> start,
+              const uint32_t* tour, size_t length, SolverStats& stats, LatencyReport* latencies) {
+    KT_TIME_PHASE(stats, PHASE_RENDER);
+    TraceScope trace("showTour", "render", length);
+    uint64_t began = (latencies != nullptr) ? readLatencyClock() : 0;
+    switch (commandLine.format) {
+        case OutputFormat::Board:
+            printTour(boardSize.first, boardSize.second, tour, length, latencies);
+            break;
+        case OutputFormat::Final:
+            printMoveNumbers(boardSize.first, boardSize.second, tour, length);
+            break;
+        case OutputFormat::Moves:
+            for (size_t i = 0; i < length; i++) {
+                std::cout << tour[i] / boardSize.second + 1 << " " << tour[i] % boardSize.second + 1 << "\n";
+            }
+            break;
+        case OutputFormat::Json: {
+            TourJob job;
+            job.boardX = boardSize.first;
+            job.boardY = boardSize.second;
+            job.start = start;
+            job.options = commandLine.options;
+            std::string out = "{";
+            appendTourJson(out, job, solver, tour, length);
+            std::cout << out << "}" << std::endl;
+            if (latencies != nullptr) latencies->render.recordSince(began);
+            return;
+        }
+        case OutputFormat::None:
+            break;
+    }
+    if (latencies != nullptr && commandLine.format != OutputFormat::Board) latencies->render.recordSince(began);
+
+    int movesMade = length - 1;
+    if (solver.impossible()) {
+        std::cout << (commandLine.options.closed ? "No Closed Tour Exists! " : "No Tour Exists! ") << "(" << solver.impossibleReason() << ")" << std::endl;
+    }
+    else if (commandLine.options.closed && solver.closed()) {
+        std::cout << "Closed Tour Completed!" << std::endl;
+    }
+    else if (commandLine.options.closed && movesMade == (int)solver.tourSquares() - 1) {
+        std::cout << "No Closed Tour Found, Open Tour Completed!" << std::endl;
+    }
+    else if (movesMade == (int)solver.tourSquares() - 1) {
         std::cout << "Tour Completed!" << std::endl;
     }
     else {
         std::cout << "No More Moves!" << std::endl;
     }
+}
+
+/*
+ * Function: runStripCount()
+ * @desc: Count mode for strips with more than MAX_COUNT_SQUARES squares, which are too big to search exhaustively.
+ *        Their tours are counted in all (not from each start) with countStripTours(), modulo STRIP_COUNT_MODULUS.
+ * @param1: The command line, passed by reference
+ * @param2/param3: The strip's height (3 or 4) and length
+ * @return: The exit code for main().
+ */
+int runStripCount(const CommandLine& commandLine, int rows, uint64_t length) {
+    if (commandLine.start.first > 0) {
+        std::cerr << "Tours on boards of more than " << MAX_COUNT_SQUARES << " squares are only counted in all, leave out --start" << std::endl;
+        return 1;
+    }
+    auto began = std::chrono::steady_clock::now();
+    bool closed = commandLine.options.closed;
+    uint64_t tours = countStripTours(rows, length, closed);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+    std::cout << (closed ? "Closed" : "Open") << " tours on " << rows << "x" << length << ", modulo " << STRIP_COUNT_MODULUS << ": "
+              << tours;
+    if (!closed) std::cout << " undirected, " << 2 * tours % STRIP_COUNT_MODULUS << " directed";
+    std::cout << "\nCounted with a transfer matrix in " << seconds << " s" << std::endl;
+    return 0;
+}
+
+/*
+ * Function: runDiagramCount()
+ * @desc: Count mode for closed tours on boards too big to search, with countDiagramTours(). Every closed tour passes
+ *        through every square, so there is just the one total, however the start was given.
+ * @param1: The command line, passed by reference
+ * @param2/param3: The board's X/Y dimensions
+ * @return: The exit code for main().
+ */
+int runDiagramCount(const CommandLine& commandLine, int boardX, int boardY) {
+    if (!commandLine.options.closed) {
+        std::cerr << "Only closed tours can be counted with a decision diagram (add --closed)" << std::endl;
+        return 1;
+    }
+    DiagramOptions options;
+    options.threads = commandLine.threads;
+    options.spillDirectory = commandLine.spillPath;
+    options.memoryLimit = (size_t)commandLine.memoryLimit << 20;
+    //big boards take hours, so show how far it has got when someone is watching
+    if (isatty(STDERR_FILENO)) {
+        options.progress = [](int level, uint64_t nodes, size_t bytes) {
+            std::cerr << "\rLevel " << level << ": " << nodes << " nodes, " << (bytes >> 20) << " MB in use   " << std::flush;
+        };
+    }
+    DiagramReport report;
+    bool counted = countDiagramTours(boardX, boardY, options, report);
+    if (options.progress) std::cerr << "\r" << std::string(60, ' ') << "\r" << std::flush;
+    if (!counted && report.spillFailed) {
+        std::cerr << "Could not write or read back the diagram's levels in " << commandLine.spillPath << std::endl;
+        return 1;
+    }
+    if (!counted) {
+        std::cerr << "The board is too wide to count: its frontier has " << report.frontier << " squares, and at most "
+                  << MAX_DIAGRAM_FRONTIER << " fit" << std::endl;
+        return 1;
+    }
+    double speedup = report.seconds > 0 ? report.cpuSeconds / report.seconds : 0;
+    std::cout << "Closed tours: " << report.tours << "\n"
+              << "Decision diagram: " << report.edges << " levels, a frontier of up to " << report.frontier << " squares, "
+              << report.nodes << " nodes (at most " << report.peakNodes << " in level " << report.peakLevel << ")\n"
+              << "Peak memory " << (report.peakBytes + (1 << 20) - 1) / (1 << 20) << " MB, "
+              << (report.spilledBytes >> 20) << " MB spilled, built in " << report.seconds
+              << " s on " << report.threads << " threads, speedup " << speedup << ", scaling efficiency "
+              << (int)(100 * speedup / report.threads + 0.5) << "%" << std::endl;
+    return 0;
+}
+
+/*
+ * Function: runCount()
+ * @desc: Count mode. Counts every tour on the board from the starting square given, or from every square (shown as a
+ *        board of counts), then how many tours the board has in all, and how hard the search worked for them.
+ * @param: The command line, passed by reference
+ * @return: The exit code for main().
+ */
+int runCount(const CommandLine& commandLine) {
+    int boardX = commandLine.boardX;
+    int boardY = commandLine.boardY;
+    if (boardX == 0 || boardY == 0) {
+        std::cerr << "--count needs the board size (--size)" << std::endl;
+        return 1;
+    }
+    int shortSide = std::min(boardX, boardY);
+    if ((shortSide == 3 || shortSide == 4) && (commandLine.countLength > 0 || boardX * boardY > MAX_COUNT_SQUARES)) {
+        uint64_t length = commandLine.countLength > 0 ? commandLine.countLength : (uint64_t)std::max(boardX, boardY);
+        return runStripCount(commandLine, shortSide, length);
+    }
+    if (commandLine.diagram || (commandLine.options.closed && boardX * boardY > MAX_COUNT_SQUARES)) {
+        return runDiagramCount(commandLine, boardX, boardY);
+    }
+    std::vector<std::pair<int,int>> starts;
+    if (commandLine.start.first > 0) {
+        starts.push_back(std::pair<int,int>(commandLine.start.first - 1, commandLine.start.second - 1));
+    }
+    else {
+        for (int i = 0; i < boardX; i++) {
+            for (int j = 0; j < boardY; j++) {
+                starts.push_back(std::pair<int,int>(i, j));
+            }
+        }
+    }
+    CountOptions options;
+    options.closed = commandLine.options.closed;
+    options.splitDepth = commandLine.splitDepth;
+    options.threads = commandLine.threads;
+    CountReport report;
+    if (!countTours(boardX, boardY, starts, options, report)) {
+        std::cerr << "Open tours can only be counted on boards of up to " << MAX_COUNT_SQUARES << " squares, or strips" << std::endl;
+        return 1;
+    }
+
+    const char* kind = options.closed ? "closed" : "open";
+    uint64_t total = 0;
+    for (uint64_t tours : report.tours) total += tours;
+    if (starts.size() == 1) {
+        std::cout << report.tours[0] << " " << kind << " tours from " << starts[0].first + 1 << "," << starts[0].second + 1
+                  << " (each direction counted)" << std::endl;
+    }
+    else {
+        std::cout << "Directed " << kind << " tours from each starting square:" << std::endl;
+        int width = std::to_string(*std::max_element(report.tours.begin(), report.tours.end())).size();
+        for (size_t i = 0; i < starts.size(); i++) {
+            std::string number = std::to_string(report.tours[i]);
+            std::cout << "[" << std::string(width - number.size(), ' ') << number << "]";
+            if ((i + 1) % boardY == 0) std::cout << "\n";
+        }
+        //a closed tour passes through every square, so each start sees every one of them, in both directions
+        if (options.closed) {
+            std::cout << "Closed tours: " << report.tours[0] / 2 << std::endl;
+        }
+        else {
+            std::cout << "Open tours: " << total << " directed, " << total / 2 << " undirected" << std::endl;
+        }
+    }
+    double speedup = report.seconds > 0 ? report.cpuSeconds / report.seconds : 0;
+    std::cout << "Searched " << report.nodes << " positions (" << report.pruned << " pruned) in " << report.seconds << " s, "
+              << (report.seconds > 0 ? (uint64_t)(report.nodes / report.seconds) : 0) << " positions/s\n"
+              << report.tasks << " tasks on " << report.threads << " threads (" << report.steals << " stolen), speedup "
+              << speedup << ", scaling efficiency " << (int)(100 * speedup / report.threads + 0.5) << "%" << std::endl;
+    return 0;
+}
+
+//This is the main method. Options given on the command line (see printUsage()) are read first; "--batch" runs batch
+//mode instead (see runBatch()), and "--count" counts tours (see runCount()). Otherwise, if the board size or starting
+//square were not given, a string description of the program is printed and the user is asked for them. The problem is solved with a KnightTourSolver, which rewrites it
+//in its canonical orientation (see canonicaliseProblem()), moves the knight with makeMove() while there are still valid
+//moves to make, and maps the tour back onto the board the user asked for. The tour is then shown in the chosen format, and
+//based on the number of moves successfully made, a final text output showing the result of the tour is printed (see
+//showTour()). With "--stats", what the solver did is printed to stderr last.
+int main(int argc, char* argv[]) {
+    CommandLine commandLine;
+    int exitCode = parseCommandLine(argc, argv, commandLine);
+    if (exitCode != 0) {
+        return exitCode < 0 ? 0 : exitCode;
+    }
+    if (!commandLine.tracePath.empty()) {
+        if (!startTracing(commandLine.tracePath)) {
+            std::cerr << "Could not write trace: " << commandLine.tracePath << std::endl;
+            return 1;
+        }
+        nameTraceThread("main");
+    }
+    //the histograms are 15KB each, so they live on the heap and only when asked for
+    std::unique_ptr<LatencyReport> latencyReport;
+    if (commandLine.latency) {
+        latencyReport.reset(new LatencyReport());
+        std::signal(SIGUSR1, requestLatencyReport);
+    }
+    LatencyReport* latencies = latencyReport.get();
+    if (commandLine.count) {
+        return runCount(commandLine);
+    }
+    if (!commandLine.buildDatabasePath.empty()) {
+        if (!buildTourDatabase(commandLine.buildDatabasePath, commandLine.maxSize, commandLine.options, commandLine.threads)) {
+            std::cerr << "Could not write tour database: " << commandLine.buildDatabasePath << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    TourDatabase database;
+    if (!commandLine.databasePath.empty() && !openTourDatabase(commandLine.databasePath, database)) {
+        std::cerr << "Could not open tour database: " << commandLine.databasePath << std::endl;
+        return 1;
+    }
+    const TourDatabase* tourDatabase = commandLine.databasePath.empty() ? nullptr : &database;
+    TourCache cache;
+    cache.directory = commandLine.cachePath;
+    if (!cache.directory.empty()) {
+        mkdir(cache.directory.c_str(), 0755);
+    }
+    const TourCache* tourCache = cache.directory.empty() ? nullptr : &cache;
+    if (!commandLine.batchPath.empty()) {
+        int batchExitCode = runBatch(commandLine.batchPath, commandLine.threads, commandLine.options, tourCache, tourDatabase, commandLine.stats,
+                                     latencies);
+        if (latencies != nullptr) printLatencyReport(*latencies);
+        return batchExitCode;
+    }
+
+    SolverStats stats;
+    std::pair<int,int> boardSize(commandLine.boardX, commandLine.boardY);
+    std::pair<int,int> start(commandLine.start.first - 1, commandLine.start.second - 1);
+    {
+        KT_TIME_PHASE(stats, PHASE_INPUT);
+        if (boardSize.first == 0 || boardSize.second == 0 || start.first < 0) {
+            std::cout << "This program attempts " << (commandLine.options.closed ? "a closed" : "an open")
+                      << " Knight Tour using Warnsdorff's algorithm. Please specify square/rectangular board dimensions, and the Knight's starting square." << std::endl;
+        }
+        if (boardSize.first == 0 || boardSize.second == 0) {
+            //a strip can be much longer, since it is solved with the transfer matrix (below)
+            boardSize.first = inputInteger(3, 10, "Enter number of rows (between 3-10):");
+            int maxCols = (boardSize.first <= 4) ? MAX_STRIP_LENGTH : 10;
+            boardSize.second = inputInteger(3, maxCols, "Enter number of columns (between 3-" + std::to_string(maxCols) + "):");
+        }
+        if (start.first < 0 || start.first >= boardSize.first || start.second >= boardSize.second) {
+            start = getPairFromUser(1,boardSize.first, 1, boardSize.second, "Enter starting row of knight:", "Enter starting column of knight:", 1);
+        }
+    }
+
+    //Warnsdorff's rule is at its worst on strips, so they get the exact search unless another was asked for
+    SolveOptions options = commandLine.options;
+    int shortSide = std::min(boardSize.first, boardSize.second);
+    if (!commandLine.algorithmGiven && (shortSide == 3 || shortSide == 4)) {
+        options.algorithm = Algorithm::TransferMatrix;
+    }
+    KnightTourSolver solver(options);
+    solver.setCache(tourCache);
+    solver.setDatabase(tourDatabase);
+    if (latencies != nullptr) solver.setMoveLatencies(&latencies->moves);
+    solver.setGeometry(boardSize.first, boardSize.second);
+    if (!solver.setHoles(commandLine.holes)) {
+        std::cerr << "A hole is not on the board" << std::endl;
+        return 1;
+    }
+    std::vector<uint32_t> tour(solver.squares());
+    size_t length = solver.solve(start.first, start.second, tour.data());
+    showTour(commandLine, solver, boardSize, start, tour.data(), length, stats, latencies);
+    if (commandLine.stats) {
+        stats.add(solver.stats());
+        printStats(stats);
+    }
+    if (latencies != nullptr) printLatencyReport(*latencies);
     return 0;
 }
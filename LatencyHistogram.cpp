@@ -0,0 +1,106 @@
+/* Author: Nathan Burrows
+ * File: LatencyHistogram.cpp
+ *
+ * The lock-free log-linear latency histogram (see LatencyHistogram.h).
+ */
+
+#include "LatencyHistogram.h"
+
+#include <chrono>
+
+/*
+ * Function: readLatencyClock()
+ * @desc: Reads the clock latencies are measured on.
+ * @return: The time, in nanoseconds from an arbitrary point.
+ */
+uint64_t readLatencyClock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Function: findLatencyBucket()
+ * @desc: Finds which bucket a latency goes in. Values below LATENCY_SUB_BUCKETS have a bucket each. Above that, the
+ *        power of two a value is in picks a group of LATENCY_SUB_BUCKETS buckets, and the bits just below its top bit
+ *        pick the bucket in the group.
+ * @param: The latency, in nanoseconds
+ * @return: The bucket.
+ */
+int findLatencyBucket(uint64_t nanoseconds) {
+    if (nanoseconds < (uint64_t)LATENCY_SUB_BUCKETS) return (int)nanoseconds;
+    int topBit = 63 - __builtin_clzll(nanoseconds);
+    int shift = topBit - LATENCY_SUB_BUCKET_BITS;
+    int group = topBit - LATENCY_SUB_BUCKET_BITS + 1;
+    return group * LATENCY_SUB_BUCKETS + (int)((nanoseconds >> shift) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+/*
+ * Function: findLatencyBucketTop()
+ * @desc: The inverse of findLatencyBucket(): the largest latency that goes in a bucket.
+ * @param: The bucket
+ * @return: The largest latency in it, in nanoseconds.
+ */
+uint64_t findLatencyBucketTop(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+    int group = bucket / LATENCY_SUB_BUCKETS;
+    int shift = group - 1;
+    uint64_t bottom = ((uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS)) << shift;
+    return bottom + ((1ull << shift) - 1);
+}
+
+/*
+ * Function: LatencyHistogram()
+ * @desc: Makes an empty histogram.
+ */
+LatencyHistogram::LatencyHistogram() : total(0), largest(0) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * Function: record()
+ * @desc: Adds a latency to the histogram. Safe to call from any number of threads at once.
+ * @param: The latency, in nanoseconds
+ */
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    buckets[findLatencyBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    uint64_t seen = largest.load(std::memory_order_relaxed);
+    while (nanoseconds > seen && !largest.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed)) {}
+}
+
+/*
+ * Function: recordSince()
+ * @desc: Records the time from an earlier reading of readLatencyClock() until now. The time now is handed back, so a
+ *        loop can time each step from the end of the last one with a single clock read per step.
+ * @param: The earlier reading
+ * @return: The clock now.
+ */
+uint64_t LatencyHistogram::recordSince(uint64_t began) {
+    uint64_t now = readLatencyClock();
+    record(now - began);
+    return now;
+}
+
+/*
+ * Function: percentile()
+ * @desc: Finds the latency that a fraction of the recorded latencies were at or below. It is the top of the bucket the
+ *        fraction falls in (so it never understates), capped at the largest latency recorded.
+ * @param: The fraction, e.g. 0.99 for the 99th percentile
+ * @return: The latency, in nanoseconds, or 0 if nothing has been recorded.
+ */
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t recorded = count();
+    if (recorded == 0) return 0;
+    uint64_t wanted = (uint64_t)(fraction * recorded + 0.5);
+    if (wanted < 1) wanted = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= wanted) {
+            uint64_t top = findLatencyBucketTop(i);
+            return top < max() ? top : max();
+        }
+    }
+    return max();
+}
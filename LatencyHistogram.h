@@ -0,0 +1,49 @@
+/* Author: Nathan Burrows
+ * File: LatencyHistogram.h
+ *
+ * A histogram of latencies that any number of threads can record into at once without locking (see --latency). It is
+ * log-linear, like an HDR histogram: every power of two is split into LATENCY_SUB_BUCKETS equal buckets, so a value
+ * is always placed within about 3% of what it really was, from nanoseconds up to hours, in a fixed 15KB.
+ */
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+
+//Each power of two is split into 2^LATENCY_SUB_BUCKET_BITS buckets.
+const int LATENCY_SUB_BUCKET_BITS = 5;
+const int LATENCY_SUB_BUCKETS = 1 << LATENCY_SUB_BUCKET_BITS;
+//Values below LATENCY_SUB_BUCKETS get a bucket each; above that, each of the powers of two up to 2^63 gets LATENCY_SUB_BUCKETS.
+const int LATENCY_BUCKETS = (64 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS;
+
+/*
+ * Class: LatencyHistogram
+ * @desc: Counts how many latencies (in nanoseconds) fell in each bucket, along with how many there were in total and
+ *        the largest. Recording is three relaxed atomic updates, so threads never wait on each other; reading while
+ *        others are recording gives a consistent enough picture for a report.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t nanoseconds);
+    uint64_t recordSince(uint64_t began);
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return largest.load(std::memory_order_relaxed); }
+    uint64_t percentile(double fraction) const;
+
+private:
+    std::atomic<uint64_t> buckets[LATENCY_BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> largest;
+};
+
+uint64_t readLatencyClock();
+int findLatencyBucket(uint64_t nanoseconds);
+uint64_t findLatencyBucketTop(int bucket);
+
+#endif
@@ -0,0 +1,101 @@
+/* Author: Nathan Burrows
+ * File: SolverStats.h
+ *
+ * Counters and phase timers for the solver (shown with --stats). They are only compiled in when KT_ENABLE_STATS is
+ * defined (the KNIGHTTOUR_STATS CMake option, on by default). Without it, KT_COUNT(), KT_ADD_STATS() and KT_TIME_PHASE()
+ * compile to nothing, and their arguments are never evaluated. With it, every counter is a plain add on a struct the search
+ * already owns (each SearchState has its own), so there is nothing shared between threads and nothing to lock.
+ */
+
+#ifndef SOLVERSTATS_H
+#define SOLVERSTATS_H
+
+#include <chrono>
+#include <cstdint>
+
+/*
+ * Enum: StatsPhase
+ * @desc: The phases a run's time is split into.
+ *        Input  = reading the command line, the prompts, or the batch input
+ *        Setup  = setting up a board (KnightTourSolver::setGeometry())
+ *        Solve  = finding tours (KnightTourSolver::solve())
+ *        Render = showing or writing the results
+ */
+enum StatsPhase { PHASE_INPUT, PHASE_SETUP, PHASE_SOLVE, PHASE_RENDER, PHASE_COUNT };
+
+/*
+ * Struct: SolverStats
+ * @desc: What the solver has done.
+ *        moves            = squares the knight was moved onto (including where it starts)
+ *        candidates       = unvisited moves looked at when picking each move
+ *        ties             = picks where more than one move shared the fewest continuing moves
+ *        deadEnds         = times the knight ran out of moves before covering the board
+ *        backtracks       = moves taken back by the backtracking search
+ *        restarts         = times one search gave up and another was started (rotations, backtracking, or an open
+ *                           tour after a closed one was not found)
+ *        pruneChecks      = moves the backtracking search checked could still lead to a tour
+ *        pruned           = how many of those could not, and were taken straight back
+ *        phaseNanoseconds = time spent in each StatsPhase
+ */
+struct SolverStats {
+    uint64_t moves = 0;
+    uint64_t candidates = 0;
+    uint64_t ties = 0;
+    uint64_t deadEnds = 0;
+    uint64_t backtracks = 0;
+    uint64_t restarts = 0;
+    uint64_t pruneChecks = 0;
+    uint64_t pruned = 0;
+    uint64_t phaseNanoseconds[PHASE_COUNT] = {};
+
+    /*
+     * Function: add()
+     * @desc: Adds another set of stats onto these.
+     * @param: The other stats, passed by reference
+     */
+    constexpr void add(const SolverStats& other) {
+        moves += other.moves;
+        candidates += other.candidates;
+        ties += other.ties;
+        deadEnds += other.deadEnds;
+        backtracks += other.backtracks;
+        restarts += other.restarts;
+        pruneChecks += other.pruneChecks;
+        pruned += other.pruned;
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            phaseNanoseconds[i] += other.phaseNanoseconds[i];
+        }
+    }
+};
+
+/*
+ * Class: PhaseTimer
+ * @desc: Adds the time from its construction to its destruction onto one phase of a SolverStats.
+ */
+class PhaseTimer {
+public:
+    PhaseTimer(SolverStats& stats, StatsPhase phase) : stats(stats), phase(phase), began(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() {
+        stats.phaseNanoseconds[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - began).count();
+    }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    SolverStats& stats;
+    StatsPhase phase;
+    std::chrono::steady_clock::time_point began;
+};
+
+#ifdef KT_ENABLE_STATS
+#define KT_COUNT(stats, counter, amount) ((stats).counter += (amount))
+#define KT_TIME_PHASE(stats, phase) PhaseTimer phaseTimer((stats), (phase))
+#define KT_ADD_STATS(stats, other) ((stats).add(other))
+#else
+//the arguments only go in sizeof, which never evaluates them, so stats that are only counted in are not unused
+#define KT_COUNT(stats, counter, amount) ((void)sizeof((stats).counter + (amount)))
+#define KT_TIME_PHASE(stats, phase) ((void)sizeof((stats).phaseNanoseconds[phase]))
+#define KT_ADD_STATS(stats, other) ((void)sizeof(&(stats) == &(other)))
+#endif
+
+#endif
@@ -0,0 +1,359 @@
+/* Author: Nathan Burrows
+ * File: TourCounter.cpp
+ *
+ * Counting every tour on a small board (see TourCounter.h).
+ */
+
+#include "TourCounter.h"
+#include "KnightTourSolver.h"
+#include "TourStore.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <time.h>
+
+/*
+ * Struct: CountBoard
+ * @desc: A board laid out for bitboard counting. Square (row, col) is bit row * boardY + col.
+ *        neighbours = the squares a knight can reach from each square
+ *        shifts     = for each knight move that fits on the board, how far it moves a bit (negative is down)
+ *        sources    = for each of those moves, the squares it can be made from without leaving the board
+ */
+struct CountBoard {
+    int boardX = 0;
+    int boardY = 0;
+    int squares = 0;
+    uint64_t neighbours[MAX_COUNT_SQUARES] = {};
+    int moveCount = 0;
+    int shifts[8] = {};
+    uint64_t sources[8] = {};
+};
+
+/*
+ * Struct: CountSearch
+ * @desc: The search from one starting square.
+ *        startBit = the start's bit, which a closed tour has to end next to
+ *        closed   = whether closed tours are being counted
+ */
+struct CountSearch {
+    const CountBoard* board;
+    uint64_t startBit;
+    bool closed;
+};
+
+/*
+ * Struct: CountTask
+ * @desc: A path the search was split at: everything below it is counted as one task.
+ *        search   = which start's search it belongs to (an index into the searches)
+ *        current  = the square the knight is on
+ *        previous = the square before that
+ *        unvisited = the squares still to visit
+ */
+struct CountTask {
+    int search;
+    int current;
+    int previous;
+    uint64_t unvisited;
+};
+
+/*
+ * Struct: CountProgress
+ * @desc: One thread's running totals, kept apart from the other threads' (and on a cache line of their own) so
+ *        counting never touches memory another thread is writing.
+ */
+struct alignas(64) CountProgress {
+    std::vector<uint64_t> tours;
+    uint64_t nodes = 0;
+    uint64_t pruned = 0;
+    uint64_t steals = 0;
+    double cpuSeconds = 0;
+};
+
+/*
+ * Struct: TaskQueue
+ * @desc: One thread's tasks. The owner takes from the back, and other threads steal from the front, so a thief takes
+ *        the tasks the owner would have got to last.
+ */
+struct TaskQueue {
+    std::mutex mutex;
+    std::deque<CountTask> tasks;
+};
+
+/*
+ * Function: readThreadCpuSeconds()
+ * @desc: Reads how much CPU time the calling thread has used. Unlike the time on the clock, this does not go up while
+ *        the thread is waiting for a core, so it measures the work done even when there are more threads than cores.
+ * @return: The time, in seconds.
+ */
+double readThreadCpuSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Function: buildCountBoard()
+ * @desc: Lays out a board for counting.
+ * @param1/param2: The board's X/Y dimensions. There must be no more than MAX_COUNT_SQUARES squares.
+ * @param3: Filled with the board, passed by reference
+ */
+void buildCountBoard(int boardX, int boardY, CountBoard& board) {
+    board.boardX = boardX;
+    board.boardY = boardY;
+    board.squares = boardX * boardY;
+    for (int move = 0; move < 8; move++) {
+        uint64_t sources = 0;
+        for (int square = 0; square < board.squares; square++) {
+            int row = square / boardY + MOVE_DX[move];
+            int col = square % boardY + MOVE_DY[move];
+            if (isOnBoard(row, col, boardX, boardY)) {
+                sources |= 1ull << square;
+                board.neighbours[square] |= 1ull << (row * boardY + col);
+            }
+        }
+        //moves that never fit are left out, which also keeps every shift below 64
+        if (sources != 0) {
+            board.shifts[board.moveCount] = MOVE_DX[move] * boardY + MOVE_DY[move];
+            board.sources[board.moveCount] = sources;
+            board.moveCount++;
+        }
+    }
+}
+
+/*
+ * Function: expandSquares()
+ * @desc: Finds every square a knight can reach in one move from a set of squares, all at once, by shifting the whole
+ *        set for each move.
+ * @param1: The board, passed by reference
+ * @param2: The squares
+ * @return: The squares reachable from them.
+ */
+uint64_t expandSquares(const CountBoard& board, uint64_t squares) {
+    uint64_t reached = 0;
+    for (int move = 0; move < board.moveCount; move++) {
+        uint64_t from = squares & board.sources[move];
+        int shift = board.shifts[move];
+        reached |= shift > 0 ? from << shift : from >> -shift;
+    }
+    return reached;
+}
+
+/*
+ * Function: isDeadEnd()
+ * @desc: Finds if the rest of the board can no longer be toured from where the knight is, so the search can give up on
+ *        it. Two things rule a tour out:
+ *        - A square that cannot be entered and left. Each unvisited square needs two free neighbours (counting the
+ *          knight's square, and the start for a closed tour, since it is the last step), apart from an open tour's
+ *          last square, which needs one, so two squares with only one mean there is no tour. Only the neighbours of
+ *          the square just left can have lost one, so only they are checked.
+ *        - The unvisited squares not all being reachable from the knight's square without crossing visited ones.
+ * @param1: The search, passed by reference
+ * @param2: The square the knight is on
+ * @param3: The square it was on before, or -1 at the start
+ * @param4: The squares still to visit (at least one)
+ * @return: Returns true if no tour can be finished from here, false if one might.
+ */
+bool isDeadEnd(const CountSearch& search, int current, int previous, uint64_t unvisited) {
+    const CountBoard& board = *search.board;
+    uint64_t open = unvisited | (1ull << current);
+    if (previous >= 0) {
+        uint64_t usable = search.closed ? open | search.startBit : open;
+        int needed = search.closed ? 2 : 1;
+        int ends = 0;
+        for (uint64_t touched = board.neighbours[previous] & unvisited; touched != 0; touched &= touched - 1) {
+            int degree = __builtin_popcountll(board.neighbours[__builtin_ctzll(touched)] & usable);
+            if (degree < needed) return true;
+            if (degree == 1 && ++ends > 1) return true;
+        }
+    }
+    uint64_t reached = 1ull << current;
+    for (;;) {
+        uint64_t grown = (reached | expandSquares(board, reached)) & open;
+        if (grown == reached) break;
+        reached = grown;
+    }
+    return (unvisited & ~reached) != 0;
+}
+
+/*
+ * Function: countPaths()
+ * @desc: Counts every way of finishing the tour from a position, by trying every move in turn.
+ * @param1: The search, passed by reference
+ * @param2: The square the knight is on
+ * @param3: The square it was on before, or -1 at the start
+ * @param4: The squares still to visit
+ * @param5: The thread's totals, passed by reference
+ * @return: How many tours finish from here.
+ */
+uint64_t countPaths(const CountSearch& search, int current, int previous, uint64_t unvisited, CountProgress& progress) {
+    progress.nodes++;
+    if (unvisited == 0) {
+        return !search.closed || (search.board->neighbours[current] & search.startBit) != 0;
+    }
+    if (isDeadEnd(search, current, previous, unvisited)) {
+        progress.pruned++;
+        return 0;
+    }
+    uint64_t tours = 0;
+    for (uint64_t moves = search.board->neighbours[current] & unvisited; moves != 0; moves &= moves - 1) {
+        int next = __builtin_ctzll(moves);
+        tours += countPaths(search, next, current, unvisited & ~(1ull << next), progress);
+    }
+    return tours;
+}
+
+/*
+ * Function: splitPaths()
+ * @desc: The first few moves of countPaths(): every position splitDepth moves in becomes a task rather than being
+ *        counted straight away. Tours shorter than that are counted here.
+ * @param1: The searches, passed by reference
+ * @param2: Which search this is
+ * @param3/param4/param5: The position, as for countPaths()
+ * @param6: How many moves have been made
+ * @param7: How many moves in to split
+ * @param8: Has the tasks added to it, passed by reference
+ * @param9: Has the tours counted here added to it, passed by reference
+ */
+void splitPaths(const std::vector<CountSearch>& searches, int search, int current, int previous, uint64_t unvisited, int depth,
+                int splitDepth, std::vector<CountTask>& tasks, CountProgress& progress) {
+    if (depth >= splitDepth && unvisited != 0) {
+        tasks.push_back({ search, current, previous, unvisited });
+        return;
+    }
+    progress.nodes++;
+    if (unvisited == 0) {
+        progress.tours[search] += !searches[search].closed || (searches[search].board->neighbours[current] & searches[search].startBit) != 0;
+        return;
+    }
+    if (isDeadEnd(searches[search], current, previous, unvisited)) {
+        progress.pruned++;
+        return;
+    }
+    for (uint64_t moves = searches[search].board->neighbours[current] & unvisited; moves != 0; moves &= moves - 1) {
+        int next = __builtin_ctzll(moves);
+        splitPaths(searches, search, next, current, unvisited & ~(1ull << next), depth + 1, splitDepth, tasks, progress);
+    }
+}
+
+/*
+ * Function: takeCountTask()
+ * @desc: Gets a thread its next task: the newest one in its own queue, or failing that the oldest one in the first
+ *        other queue that has any. Every task exists before the threads start, so once every queue is empty the
+ *        counting is done.
+ * @param1: Every thread's queue, passed by reference
+ * @param2: Which thread is asking
+ * @param3: Set to the task, passed by reference
+ * @param4: The thread's totals, passed by reference (for counting steals)
+ * @return: Returns true if there was a task, false if there are none left.
+ */
+bool takeCountTask(std::vector<TaskQueue>& queues, int worker, CountTask& task, CountProgress& progress) {
+    {
+        TaskQueue& own = queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+        TaskQueue& victim = queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            progress.steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Function: countTours()
+ * @desc: Counts every open (or closed) tour from each of a list of starting squares. Each start is counted on the
+ *        board in its canonical orientation (see canonicaliseProblem()), so starts that are symmetric to each other are
+ *        only counted once.
+ * @param1/param2: The board's X/Y dimensions
+ * @param3: The starting squares (indexed from 0), passed by reference
+ * @param4: How to count, passed by reference
+ * @param5: Filled with the counts and how the work went, passed by reference
+ * @return: Returns true if the tours were counted, false if the board has more than MAX_COUNT_SQUARES squares.
+ */
+bool countTours(int boardX, int boardY, const std::vector<std::pair<int,int>>& starts, const CountOptions& options, CountReport& report) {
+    if (boardX < 1 || boardY < 1 || boardX * boardY > MAX_COUNT_SQUARES) return false;
+    std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+    report = CountReport();
+    CountBoard board;
+    buildCountBoard(std::min(boardX, boardY), std::max(boardX, boardY), board);
+    uint64_t allSquares = board.squares == 64 ? ~0ull : (1ull << board.squares) - 1;
+
+    std::vector<CountSearch> searches;
+    std::vector<int> canonicalStarts;
+    std::vector<int> startSearch;
+    for (std::pair<int,int> start : starts) {
+        std::pair<int,int> canonical = canonicaliseProblem(boardX, boardY, start).start;
+        int square = canonical.first * board.boardY + canonical.second;
+        size_t search = std::find(canonicalStarts.begin(), canonicalStarts.end(), square) - canonicalStarts.begin();
+        if (search == canonicalStarts.size()) {
+            canonicalStarts.push_back(square);
+            searches.push_back({ &board, 1ull << square, options.closed });
+        }
+        startSearch.push_back(search);
+    }
+
+    int threadCount = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<CountProgress> progress(threadCount);
+    for (CountProgress& thread : progress) {
+        thread.tours.assign(searches.size(), 0);
+    }
+    std::vector<CountTask> tasks;
+    for (size_t search = 0; search < searches.size(); search++) {
+        int square = canonicalStarts[search];
+        splitPaths(searches, search, square, -1, allSquares & ~(1ull << square), 0, options.splitDepth, tasks, progress[0]);
+    }
+    //dealt out in turn, so every thread starts with some of each start's tasks
+    std::vector<TaskQueue> queues(threadCount);
+    for (size_t i = 0; i < tasks.size(); i++) {
+        queues[i % threadCount].tasks.push_back(tasks[i]);
+    }
+
+    auto countTasks = [&](int worker) {
+        CountProgress& mine = progress[worker];
+        double cpuBegan = readThreadCpuSeconds();
+        CountTask task;
+        while (takeCountTask(queues, worker, task, mine)) {
+            TraceScope trace("countTask", "search", task.search);
+            mine.tours[task.search] += countPaths(searches[task.search], task.current, task.previous, task.unvisited, mine);
+        }
+        mine.cpuSeconds += readThreadCpuSeconds() - cpuBegan;
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threadCount; t++) {
+        workers.emplace_back([&, t]() {
+            nameTraceThread("count worker");
+            countTasks(t);
+        });
+    }
+    countTasks(0);
+    for (std::thread& worker : workers) worker.join();
+
+    report.tours.assign(starts.size(), 0);
+    for (const CountProgress& thread : progress) {
+        for (size_t i = 0; i < starts.size(); i++) {
+            report.tours[i] += thread.tours[startSearch[i]];
+        }
+        report.nodes += thread.nodes;
+        report.pruned += thread.pruned;
+        report.steals += thread.steals;
+        report.cpuSeconds += thread.cpuSeconds;
+    }
+    report.tasks = tasks.size();
+    report.threads = threadCount;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+    return true;
+}
@@ -0,0 +1,63 @@
+/* Author: Nathan Burrows
+ * File: TourCounter.h
+ *
+ * Exact counting of knight's tours on small boards (see --count): every open tour, or every closed tour, from each
+ * starting square. The search is an exhaustive depth-first one over a 64-bit bitboard of the unvisited squares, cut
+ * short wherever the rest of the board can no longer be toured (see isDeadEnd()). It is split a few moves in into
+ * independent tasks, which a pool of threads works through, each taking from its own queue first and stealing from the
+ * others when that runs dry.
+ */
+
+#ifndef TOURCOUNTER_H
+#define TOURCOUNTER_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//The largest board that can be counted: one bit per square in a uint64_t.
+const int MAX_COUNT_SQUARES = 64;
+
+/*
+ * Struct: CountOptions
+ * @desc: How to count.
+ *        closed     = count closed tours (ones that end a knight's move from the start) instead of open ones
+ *        splitDepth = how many moves in the search is split into tasks. Deeper gives more, smaller tasks, which share
+ *                     out between threads more evenly but cost more to set up.
+ *        threads    = how many threads to count on. 0 means one per core.
+ */
+struct CountOptions {
+    bool closed = false;
+    int splitDepth = 8;
+    int threads = 0;
+};
+
+/*
+ * Struct: CountReport
+ * @desc: What counting found, and how the work went.
+ *        tours       = how many directed tours start from each of the starts asked for, in the same order. A closed
+ *                      tour is counted once in each direction, so the board has half this many.
+ *        nodes       = how many positions the search visited
+ *        pruned      = how many of those it gave up on because the rest of the board could not be toured
+ *        tasks       = how many tasks the search was split into
+ *        steals      = how many tasks a thread took from another thread's queue
+ *        threads     = how many threads counted
+ *        seconds     = how long counting took
+ *        cpuSeconds  = the CPU time the threads spent counting, added up. This is about what one thread would have
+ *                      taken, so cpuSeconds / seconds is the speedup and that over threads is the scaling efficiency.
+ */
+struct CountReport {
+    std::vector<uint64_t> tours;
+    uint64_t nodes = 0;
+    uint64_t pruned = 0;
+    uint64_t tasks = 0;
+    uint64_t steals = 0;
+    int threads = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;
+};
+
+bool countTours(int boardX, int boardY, const std::vector<std::pair<int,int>>& starts, const CountOptions& options, CountReport& report);
+double readThreadCpuSeconds();
+
+#endif
@@ -0,0 +1,610 @@
+/* Author: Nathan Burrows
+ * File: TourDiagram.cpp
+ *
+ * Counting closed tours with a frontier-based decision diagram (see TourDiagram.h).
+ *
+ * The squares are numbered along rows as wide as the board's short side, and the edges are decided in order of their
+ * lower square, then their higher one, which keeps the frontier to about two rows. A node's key gives each frontier
+ * square (in square order) a code:
+ *     0      no tour moves yet
+ *     1      two tour moves (finished)
+ *     2 + k  one tour move, on a path whose other end is the frontier square with the same k
+ * The path numbers k are given out in order of first appearance, so every state has one key. The codes are packed as
+ * the digits of a number in base 2 + (the most paths the frontier can hold), which is 4 bits each up to 16 squares and
+ * still fits 64 bits at 18. A square joins the frontier with its first edge and leaves it after its last one, and it
+ * has to have two tour moves by then.
+ */
+
+#include "TourDiagram.h"
+#include "TourCounter.h"
+#include "KnightTourSolver.h"
+#include "TourStore.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const int DIAGRAM_SHARD_BITS = 8;
+const int DIAGRAM_SHARDS = 1 << DIAGRAM_SHARD_BITS;
+//the first chunk of an arena holds 2^10 nodes, and each one after that twice as many as the one before, up to 2^16
+const int ARENA_FIRST_CHUNK_BITS = 10;
+const int ARENA_LARGEST_CHUNK_BITS = 16;
+const int ARENA_GROWING_CHUNKS = ARENA_LARGEST_CHUNK_BITS - ARENA_FIRST_CHUNK_BITS + 1;
+const size_t ARENA_GROWING_NODES = (((size_t)1 << ARENA_GROWING_CHUNKS) - 1) << ARENA_FIRST_CHUNK_BITS;
+//how many new nodes a thread holds back for each shard before taking its lock to add them all
+const size_t DIAGRAM_BATCH = 128;
+//how many nodes are read from a spill file at a time
+const size_t SPILL_READ_NODES = 4096;
+
+/*
+ * Struct: DiagramNode
+ * @desc: One node of a level: the frontier state (see the top of this file), and how many ways of deciding the edges
+ *        before the level lead to it.
+ */
+struct DiagramNode {
+    uint64_t key;
+    uint64_t count;
+};
+
+/*
+ * Struct: DiagramMemory
+ * @desc: How much memory the node arenas and hash tables have right now, and the most they have had, kept up to date
+ *        by every thread as it allocates and frees.
+ */
+struct DiagramMemory {
+    std::atomic<size_t> bytes{0};
+    std::atomic<size_t> peak{0};
+
+    void add(size_t amount) {
+        size_t now = bytes += amount;
+        size_t seen = peak.load();
+        while (now > seen && !peak.compare_exchange_weak(seen, now)) {}
+    }
+
+    void remove(size_t amount) {
+        bytes -= amount;
+    }
+};
+
+/*
+ * Struct: NodeArena
+ * @desc: Where one shard keeps its nodes: chunks that are handed out in order and never moved, so adding a node never
+ *        copies the others. They double in size up to ARENA_LARGEST_CHUNK_BITS, so a small shard wastes at most half
+ *        its memory and a big one at most a chunk. The chunks are only freed all at once, when the level has been used.
+ */
+struct NodeArena {
+    std::vector<std::unique_ptr<DiagramNode[]>> chunks;
+    size_t size = 0;
+
+    DiagramNode& operator[](size_t index) {
+        if (index >= ARENA_GROWING_NODES) {
+            index -= ARENA_GROWING_NODES;
+            return chunks[ARENA_GROWING_CHUNKS + (index >> ARENA_LARGEST_CHUNK_BITS)][index & (((size_t)1 << ARENA_LARGEST_CHUNK_BITS) - 1)];
+        }
+        size_t position = (index >> ARENA_FIRST_CHUNK_BITS) + 1;
+        int chunk = 63 - __builtin_clzll(position);
+        return chunks[chunk][index - (((size_t)1 << chunk) - 1) * ((size_t)1 << ARENA_FIRST_CHUNK_BITS)];
+    }
+
+    size_t capacity() const {
+        if (chunks.size() > (size_t)ARENA_GROWING_CHUNKS) {
+            return ARENA_GROWING_NODES + ((chunks.size() - ARENA_GROWING_CHUNKS) << ARENA_LARGEST_CHUNK_BITS);
+        }
+        return (((size_t)1 << chunks.size()) - 1) << ARENA_FIRST_CHUNK_BITS;
+    }
+
+    size_t add(const DiagramNode& node, DiagramMemory& memory) {
+        if (size == capacity()) {
+            size_t chunkSize = (size_t)1 << std::min<size_t>(ARENA_FIRST_CHUNK_BITS + chunks.size(), ARENA_LARGEST_CHUNK_BITS);
+            chunks.emplace_back(new DiagramNode[chunkSize]);
+            memory.add(chunkSize * sizeof(DiagramNode));
+        }
+        (*this)[size] = node;
+        return size++;
+    }
+
+    void release(DiagramMemory& memory) {
+        memory.remove(capacity() * sizeof(DiagramNode));
+        chunks.clear();
+        size = 0;
+    }
+};
+
+/*
+ * Struct: DiagramShard
+ * @desc: The nodes of one level whose keys hash to the same shard, with an open addressing hash table over them (each
+ *        slot is a node's index + 1, or 0 if empty) so a state that turns up again just adds to its node's count. The
+ *        table is only needed while the level is being built. When spilling, path is the shard's spill file, spilled
+ *        says whether it has nodes in it, and spilledNodes how many once it has been merged (see mergeDiagramShard()).
+ */
+struct alignas(64) DiagramShard {
+    std::mutex lock;
+    NodeArena nodes;
+    std::vector<uint32_t> table;
+    std::string path;
+    bool spilled = false;
+    size_t spilledNodes = 0;
+};
+
+/*
+ * Struct: DiagramSpill
+ * @desc: Where the shards of a level go when it is too big for memory (see DiagramOptions::spillDirectory).
+ *        shardBytes = how much memory a shard of the level being built may take before it is spilled
+ *        written    = how many bytes have been written to the spill files
+ *        failed     = set once a spill file could not be written or read
+ */
+struct DiagramSpill {
+    size_t shardBytes = 0;
+    std::atomic<uint64_t> written{0};
+    std::atomic<bool> failed{false};
+};
+
+/*
+ * Struct: PendingNode
+ * @desc: A new node a thread is holding back until it has a batch for the node's shard.
+ */
+struct PendingNode {
+    DiagramNode node;
+    uint64_t hash;
+};
+
+/*
+ * Struct: DiagramLevel
+ * @desc: What deciding one edge does to the frontier. While the edge is decided, the squares in play are the work
+ *        squares: the frontier so far, plus any square this is the first edge of. Everything else refers to those.
+ *        from/to   = the edge's two squares
+ *        work      = the work squares, in order
+ *        state     = where in work each square of the level's key is
+ *        remaining = how many edges each work square has after this one
+ *        next      = where in work each square of the next level's key is
+ *        allJoined = whether every square on the board has joined the frontier by now, which a tour has to wait for
+ *                    before it can close
+ */
+struct DiagramLevel {
+    int from;
+    int to;
+    std::vector<int> work;
+    std::vector<int> state;
+    std::vector<int> remaining;
+    std::vector<int> next;
+    bool allJoined;
+};
+
+/*
+ * Function: hashDiagramKey()
+ * @desc: Mixes a node key into a hash. The top bits pick the shard and the bottom bits the table slot.
+ * @param: The key
+ * @return: The hash.
+ */
+uint64_t hashDiagramKey(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    return key ^ (key >> 31);
+}
+
+/*
+ * Function: spillDiagramShard()
+ * @desc: Appends a shard's nodes to its spill file, then frees them and its hash table. A key can end up in the file
+ *        more than once, from different spills, until mergeDiagramShard() adds them together.
+ * @param1: The shard, passed by reference. The caller holds its lock, if other threads can reach it.
+ * @param2: The memory in use, passed by reference
+ * @param3: The spill, passed by reference
+ * @return: Returns true if the nodes were written, false if not (and they are gone either way).
+ */
+bool spillDiagramShard(DiagramShard& shard, DiagramMemory& memory, DiagramSpill& spill) {
+    FILE* file = fopen(shard.path.c_str(), "ab");
+    bool written = file != nullptr;
+    for (size_t i = 0; written && i < shard.nodes.size; i++) {
+        written = fwrite(&shard.nodes[i], sizeof(DiagramNode), 1, file) == 1;
+    }
+    if (file != nullptr) written = fclose(file) == 0 && written;
+    spill.written += shard.nodes.size * sizeof(DiagramNode);
+    shard.spilled = true;
+    shard.nodes.release(memory);
+    memory.remove(shard.table.size() * sizeof(uint32_t));
+    std::vector<uint32_t>().swap(shard.table);
+    return written;
+}
+
+/*
+ * Function: addDiagramNodes()
+ * @desc: Adds a batch of nodes to a shard, adding each one's count to the node already there with the same key, if
+ *        there is one. The table is doubled whenever it gets three quarters full. When spilling, a shard that has
+ *        grown past its share of the memory is spilled straight afterwards.
+ * @param1: The shard, passed by reference. The caller holds its lock.
+ * @param2: The nodes, passed by reference
+ * @param3: The memory in use, passed by reference
+ * @param4: The spill, or nullptr to keep everything in memory
+ */
+void addDiagramNodes(DiagramShard& shard, const std::vector<PendingNode>& pending, DiagramMemory& memory, DiagramSpill* spill) {
+    for (const PendingNode& added : pending) {
+        if (4 * (shard.nodes.size + 1) > 3 * shard.table.size()) {
+            std::vector<uint32_t> table(std::max<size_t>(1024, 2 * shard.table.size()), 0);
+            memory.add(table.size() * sizeof(uint32_t));
+            size_t mask = table.size() - 1;
+            for (size_t i = 0; i < shard.nodes.size; i++) {
+                size_t slot = hashDiagramKey(shard.nodes[i].key) & mask;
+                while (table[slot] != 0) slot = (slot + 1) & mask;
+                table[slot] = i + 1;
+            }
+            memory.remove(shard.table.size() * sizeof(uint32_t));
+            shard.table.swap(table);
+        }
+        size_t mask = shard.table.size() - 1;
+        size_t slot = added.hash & mask;
+        while (true) {
+            if (shard.table[slot] == 0) {
+                shard.table[slot] = shard.nodes.add(added.node, memory) + 1;
+                break;
+            }
+            DiagramNode& node = shard.nodes[shard.table[slot] - 1];
+            if (node.key == added.node.key) {
+                node.count += added.node.count;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+    size_t bytes = shard.nodes.capacity() * sizeof(DiagramNode) + shard.table.size() * sizeof(uint32_t);
+    if (spill != nullptr && bytes > spill->shardBytes && !spillDiagramShard(shard, memory, *spill)) spill->failed = true;
+}
+
+/*
+ * Function: readDiagramShard()
+ * @desc: Reads a shard's spill file back into memory and deletes it.
+ * @param1: The shard, passed by reference. Only the calling thread can reach it.
+ * @param2: The memory in use, passed by reference
+ * @param3: Whether the file can have a key more than once (straight after the level was built), so the nodes have to
+ *          go through the hash table, or not (after mergeDiagramShard()), so they can just be added to the arena
+ * @return: Returns true if the file was read, false if not.
+ */
+bool readDiagramShard(DiagramShard& shard, DiagramMemory& memory, bool merge) {
+    FILE* file = fopen(shard.path.c_str(), "rb");
+    if (file == nullptr) return false;
+    std::vector<DiagramNode> buffer(SPILL_READ_NODES);
+    std::vector<PendingNode> pending;
+    size_t read;
+    while ((read = fread(buffer.data(), sizeof(DiagramNode), buffer.size(), file)) > 0) {
+        if (!merge) {
+            for (size_t i = 0; i < read; i++) shard.nodes.add(buffer[i], memory);
+            continue;
+        }
+        pending.resize(read);
+        for (size_t i = 0; i < read; i++) {
+            pending[i].node = buffer[i];
+            pending[i].hash = hashDiagramKey(buffer[i].key);
+        }
+        addDiagramNodes(shard, pending, memory, nullptr);
+    }
+    bool valid = !ferror(file);
+    fclose(file);
+    std::remove(shard.path.c_str());
+    shard.spilled = false;
+    return valid;
+}
+
+/*
+ * Function: mergeDiagramShard()
+ * @desc: Once a level has been built, adds together the nodes a spilled shard has in its file and in memory, so every
+ *        key is there once, and writes them back to the file for the next level to read.
+ * @param1: The shard, passed by reference. Only the calling thread can reach it.
+ * @param2: The memory in use, passed by reference
+ * @param3: The spill, passed by reference
+ * @return: Returns true if the shard was merged, false if its file could not be read or written.
+ */
+bool mergeDiagramShard(DiagramShard& shard, DiagramMemory& memory, DiagramSpill& spill) {
+    if (!readDiagramShard(shard, memory, true)) return false;
+    shard.spilledNodes = shard.nodes.size;
+    return spillDiagramShard(shard, memory, spill);
+}
+
+/*
+ * Function: planDiagramLevels()
+ * @desc: Lists the board's edges in the order they are decided, and works out the frontier for each.
+ * @param1/param2: The board's X/Y dimensions, with X the long side (the squares are numbered along rows of Y)
+ * @param3: Filled with one level per edge, passed by reference
+ * @return: The most squares any level's key has.
+ */
+int planDiagramLevels(int boardX, int boardY, std::vector<DiagramLevel>& levels) {
+    int squares = boardX * boardY;
+    std::vector<std::pair<int,int>> edges;
+    for (int square = 0; square < squares; square++) {
+        for (int move = 0; move < 8; move++) {
+            int row = square / boardY + MOVE_DX[move];
+            int col = square % boardY + MOVE_DY[move];
+            int other = row * boardY + col;
+            if (isOnBoard(row, col, boardX, boardY) && other > square) edges.push_back(std::pair<int,int>(square, other));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    std::vector<int> firstEdge(squares, -1);
+    std::vector<int> lastEdge(squares, -1);
+    for (size_t i = 0; i < edges.size(); i++) {
+        for (int square : { edges[i].first, edges[i].second }) {
+            if (firstEdge[square] < 0) firstEdge[square] = i;
+            lastEdge[square] = i;
+        }
+    }
+    int lastJoin = *std::max_element(firstEdge.begin(), firstEdge.end());
+
+    int widest = 0;
+    std::vector<int> frontier;
+    levels.resize(edges.size());
+    for (size_t i = 0; i < edges.size(); i++) {
+        DiagramLevel& level = levels[i];
+        level.work = frontier;
+        for (int square : { edges[i].first, edges[i].second }) {
+            if (firstEdge[square] == (int)i) level.work.push_back(square);
+        }
+        std::sort(level.work.begin(), level.work.end());
+        auto findWork = [&](int square) {
+            return (int)(std::lower_bound(level.work.begin(), level.work.end(), square) - level.work.begin());
+        };
+        level.from = findWork(edges[i].first);
+        level.to = findWork(edges[i].second);
+        for (int square : frontier) level.state.push_back(findWork(square));
+        std::vector<int> next;
+        for (int square : level.work) {
+            if (lastEdge[square] != (int)i) next.push_back(square);
+            int remaining = 0;
+            for (size_t j = i + 1; j <= (size_t)lastEdge[square]; j++) {
+                remaining += edges[j].first == square || edges[j].second == square;
+            }
+            level.remaining.push_back(remaining);
+        }
+        for (int square : next) level.next.push_back(findWork(square));
+        level.allJoined = lastJoin <= (int)i;
+        widest = std::max(widest, (int)next.size());
+        frontier.swap(next);
+    }
+    return widest;
+}
+
+/*
+ * Function: encodeDiagramKey()
+ * @desc: Packs the work squares that go on to the next level into a node key.
+ * @param1: The level, passed by reference
+ * @param2: The base the codes are packed in
+ * @param3/param4: Each work square's number of tour moves, and the work square at the other end of its path
+ * @param5: Set to the key, passed by reference
+ * @return: Returns true if the state is still possible: the edge's squares have enough edges left to make their two
+ *          tour moves (so if either is leaving the frontier, it has them already). No other square's moves or edges
+ *          left have changed since its own last decided edge, when it was checked.
+ */
+bool encodeDiagramKey(const DiagramLevel& level, uint64_t radix, const int* degree, const int* mate, uint64_t& key) {
+    if (degree[level.from] + level.remaining[level.from] < 2 || degree[level.to] + level.remaining[level.to] < 2) return false;
+    int labels[MAX_DIAGRAM_FRONTIER + 2];
+    int codes[MAX_DIAGRAM_FRONTIER];
+    int nextLabel = 0;
+    for (size_t slot = 0; slot < level.next.size(); slot++) {
+        int square = level.next[slot];
+        if (degree[square] == 1) {
+            //the key is in square order, so the end with the lower square is the one seen first
+            labels[square] = (mate[square] > square) ? nextLabel++ : labels[mate[square]];
+            codes[slot] = 2 + labels[square];
+        }
+        else {
+            codes[slot] = degree[square] == 2;
+        }
+    }
+    key = 0;
+    for (size_t slot = level.next.size(); slot-- > 0;) {
+        key = key * radix + codes[slot];
+    }
+    return true;
+}
+
+/*
+ * Function: countDiagramTours()
+ * @desc: Counts the closed tours on a board by building its decision diagram, a level per edge. Each thread takes
+ *        shards of the current level in turn and works out both children of each of their nodes, adding them to the
+ *        next level's shards in batches, then frees the shard it took. A child that puts in an edge closing the only
+ *        path left on a board with every other square finished is a closed tour, and is counted instead of kept. With
+ *        a spill directory, shards that outgrow their share of the memory limit are spilled, and merged once the level
+ *        is built, so at most one shard of a spilled level is in memory per thread.
+ * @param1/param2: The board's X/Y dimensions
+ * @param3: How to build it, passed by reference
+ * @param4: Filled with the count and how the work went, passed by reference
+ * @return: Returns true if the tours were counted, false if the board's frontier would have more than
+ *          MAX_DIAGRAM_FRONTIER squares or a spill file could not be written or read (see DiagramReport::spillFailed).
+ */
+bool countDiagramTours(int boardX, int boardY, const DiagramOptions& options, DiagramReport& report) {
+    std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+    report = DiagramReport();
+    int threadCount = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    report.threads = threadCount;
+    //a square with fewer than two moves (or an odd number of squares) rules out a closed tour before building anything
+    if (boardX < 1 || boardY < 1 || findImpossibility(boardX, boardY, std::pair<int,int>(0, 0), true) != nullptr) {
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+        return true;
+    }
+    std::vector<DiagramLevel> levels;
+    report.frontier = planDiagramLevels(std::max(boardX, boardY), std::min(boardX, boardY), levels);
+    report.edges = levels.size();
+    if (report.frontier > MAX_DIAGRAM_FRONTIER) return false;
+    uint64_t radix = (report.frontier <= 16) ? 16 : 2 + report.frontier / 2;
+
+    DiagramMemory memory;
+    std::unique_ptr<DiagramShard[]> current(new DiagramShard[DIAGRAM_SHARDS]);
+    std::unique_ptr<DiagramShard[]> next(new DiagramShard[DIAGRAM_SHARDS]);
+    std::unique_ptr<DiagramSpill> spill;
+    if (!options.spillDirectory.empty()) {
+        spill.reset(new DiagramSpill());
+        spill->shardBytes = options.memoryLimit / DIAGRAM_SHARDS;
+        for (int s = 0; s < DIAGRAM_SHARDS; s++) {
+            std::string path = options.spillDirectory + "/knighttour-diagram-" + std::to_string(s);
+            current[s].path = path + "-a";
+            next[s].path = path + "-b";
+        }
+    }
+    auto removeSpills = [&]() {
+        for (DiagramShard* shards : { current.get(), next.get() }) {
+            for (int s = 0; s < DIAGRAM_SHARDS; s++) {
+                if (shards[s].spilled) std::remove(shards[s].path.c_str());
+            }
+        }
+    };
+    std::vector<PendingNode> first(1);
+    first[0].node = { 0, 1 };
+    first[0].hash = hashDiagramKey(0);
+    addDiagramNodes(current[first[0].hash >> (64 - DIAGRAM_SHARD_BITS)], first, memory, nullptr);
+    std::vector<uint64_t> tours(threadCount, 0);
+    std::vector<double> cpuSeconds(threadCount, 0);
+    //runs work(thread) on every thread, this one included, and waits for them all
+    auto runWorkers = [&](const std::function<void(int)>& work) {
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threadCount; t++) {
+            workers.emplace_back([&, t]() {
+                nameTraceThread("diagram worker");
+                work(t);
+            });
+        }
+        work(0);
+        for (std::thread& worker : workers) worker.join();
+    };
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const DiagramLevel& level = levels[i];
+        TraceScope trace("diagramLevel", "search", i);
+        std::atomic<int> nextShard(0);
+        auto buildLevel = [&](int worker) {
+            double cpuBegan = readThreadCpuSeconds();
+            std::vector<std::vector<PendingNode>> pending(DIAGRAM_SHARDS);
+            auto addChild = [&](uint64_t key, uint64_t count) {
+                PendingNode child;
+                child.node = { key, count };
+                child.hash = hashDiagramKey(key);
+                int s = child.hash >> (64 - DIAGRAM_SHARD_BITS);
+                pending[s].push_back(child);
+                if (pending[s].size() >= DIAGRAM_BATCH) {
+                    std::lock_guard<std::mutex> guard(next[s].lock);
+                    addDiagramNodes(next[s], pending[s], memory, spill.get());
+                    pending[s].clear();
+                }
+            };
+            int degree[MAX_DIAGRAM_FRONTIER + 2];
+            int mate[MAX_DIAGRAM_FRONTIER + 2];
+            int labelSquare[MAX_DIAGRAM_FRONTIER / 2];
+            for (int s = nextShard++; s < DIAGRAM_SHARDS; s = nextShard++) {
+                DiagramShard& shard = current[s];
+                if (shard.spilled && !readDiagramShard(shard, memory, false)) spill->failed = true;
+                for (size_t n = 0; n < shard.nodes.size; n++) {
+                    const DiagramNode& node = shard.nodes[n];
+                    for (size_t square = 0; square < level.work.size(); square++) {
+                        degree[square] = 0;
+                        mate[square] = square;
+                    }
+                    std::fill(labelSquare, labelSquare + MAX_DIAGRAM_FRONTIER / 2, -1);
+                    uint64_t rest = node.key;
+                    for (size_t slot = 0; slot < level.state.size(); slot++) {
+                        int square = level.state[slot];
+                        int code;
+                        if (radix == 16) {
+                            code = rest & 15;
+                            rest >>= 4;
+                        }
+                        else {
+                            code = rest % radix;
+                            rest /= radix;
+                        }
+                        if (code == 1) {
+                            degree[square] = 2;
+                        }
+                        else if (code >= 2) {
+                            degree[square] = 1;
+                            int& other = labelSquare[code - 2];
+                            if (other < 0) {
+                                other = square;
+                            }
+                            else {
+                                mate[square] = other;
+                                mate[other] = square;
+                            }
+                        }
+                    }
+
+                    uint64_t key;
+                    //leave the edge out
+                    if (encodeDiagramKey(level, radix, degree, mate, key)) addChild(key, node.count);
+                    //put it in
+                    int from = level.from;
+                    int to = level.to;
+                    if (degree[from] == 2 || degree[to] == 2) continue;
+                    if (degree[from] == 1 && mate[from] == to) {
+                        bool finished = level.allJoined;
+                        for (size_t square = 0; finished && square < level.work.size(); square++) {
+                            finished = (int)square == from || (int)square == to || degree[square] == 2;
+                        }
+                        if (finished) tours[worker] += node.count;
+                        continue;
+                    }
+                    int fromEnd = mate[from];
+                    int toEnd = mate[to];
+                    mate[fromEnd] = toEnd;
+                    mate[toEnd] = fromEnd;
+                    degree[from]++;
+                    degree[to]++;
+                    if (encodeDiagramKey(level, radix, degree, mate, key)) addChild(key, node.count);
+                }
+                //nothing else reads this shard now
+                shard.nodes.release(memory);
+            }
+            for (int s = 0; s < DIAGRAM_SHARDS; s++) {
+                if (pending[s].empty()) continue;
+                std::lock_guard<std::mutex> guard(next[s].lock);
+                addDiagramNodes(next[s], pending[s], memory, spill.get());
+            }
+            cpuSeconds[worker] += readThreadCpuSeconds() - cpuBegan;
+        };
+        runWorkers(buildLevel);
+        if (spill != nullptr) {
+            //a spilled shard can have a key both in its file and in memory, or more than once in its file
+            std::atomic<int> mergeShard(0);
+            runWorkers([&](int worker) {
+                double cpuBegan = readThreadCpuSeconds();
+                for (int s = mergeShard++; s < DIAGRAM_SHARDS; s = mergeShard++) {
+                    if (next[s].spilled && !mergeDiagramShard(next[s], memory, *spill)) spill->failed = true;
+                }
+                cpuSeconds[worker] += readThreadCpuSeconds() - cpuBegan;
+            });
+            if (spill->failed) {
+                removeSpills();
+                report.spillFailed = true;
+                return false;
+            }
+        }
+
+        uint64_t levelNodes = 0;
+        for (int s = 0; s < DIAGRAM_SHARDS; s++) {
+            levelNodes += next[s].nodes.size + (next[s].spilled ? next[s].spilledNodes : 0);
+            memory.remove(next[s].table.size() * sizeof(uint32_t));
+            std::vector<uint32_t>().swap(next[s].table);
+        }
+        trace.setValue(levelNodes);
+        report.nodes += levelNodes;
+        if (levelNodes > report.peakNodes) {
+            report.peakNodes = levelNodes;
+            report.peakLevel = i + 1;
+        }
+        if (options.progress) options.progress(i + 1, levelNodes, memory.bytes);
+        current.swap(next);
+    }
+
+    removeSpills();
+    for (int t = 0; t < threadCount; t++) {
+        report.tours += tours[t];
+        report.cpuSeconds += cpuSeconds[t];
+    }
+    report.peakBytes = memory.peak;
+    report.spilledBytes = spill != nullptr ? spill->written.load() : 0;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+    return true;
+}
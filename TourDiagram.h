@@ -0,0 +1,77 @@
+/* Author: Nathan Burrows
+ * File: TourDiagram.h
+ *
+ * Counting closed tours on boards too big to search (see --count --diagram). A closed tour is a Hamiltonian cycle of
+ * the knight graph, so it is the set of edges (knight moves) it uses. The edges are decided one at a time, in a fixed
+ * order, as a decision diagram: each node is the state of the squares that have some edges decided and some still to
+ * come (the frontier), and a node has one child for leaving its edge out and one for putting it in. All a node needs
+ * to know is how many tour moves each frontier square has so far, and which of them the paths chosen so far join up,
+ * so every partial tour that reaches the same state shares one node (hash-consing), and only its count is kept.
+ *
+ * The diagram is built a level (edge) at a time. Each level's nodes live in arenas split into shards by hash, so the
+ * threads building the next level only ever wait for each other when they add a node to the same shard at once. On
+ * boards whose levels outgrow memory, shards can be spilled to files and merged back a shard at a time.
+ */
+
+#ifndef TOURDIAGRAM_H
+#define TOURDIAGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+//The most squares the frontier can have, for its state to fit in a 64 bit node key (see TourDiagram.cpp).
+const int MAX_DIAGRAM_FRONTIER = 18;
+
+/*
+ * Struct: DiagramOptions
+ * @desc: How to build the diagram.
+ *        threads        = how many threads build each level. 0 means one per core.
+ *        progress       = if set, called after each level is built with the level's number (from 1), how many nodes
+ *                         it has, and how much memory is in use
+ *        spillDirectory = if set, where the nodes of a level go once they pass memoryLimit, instead of staying in memory
+ *        memoryLimit    = how many bytes the nodes of the level being built may take before they are spilled. Each
+ *                         shard gets an equal share, and the level before can take as much again.
+ */
+struct DiagramOptions {
+    int threads = 0;
+    std::function<void(int, uint64_t, size_t)> progress;
+    std::string spillDirectory;
+    size_t memoryLimit = (size_t)2 << 30;
+};
+
+/*
+ * Struct: DiagramReport
+ * @desc: What the diagram found, and what it took.
+ *        tours        = how many closed tours the board has (each counted once, not once per direction), modulo 2^64
+ *        edges        = how many knight moves the board has, which is the number of levels in the diagram
+ *        frontier     = the most squares a level's frontier had
+ *        nodes        = how many nodes were made, over every level
+ *        peakNodes    = the most nodes one level had
+ *        peakLevel    = which level that was
+ *        peakBytes    = the most memory the node arenas and hash tables took up at once
+ *        spilledBytes = how many bytes of nodes were written to spillDirectory, over every level
+ *        spillFailed  = whether a spill file could not be written or read back (and so nothing was counted)
+ *        threads      = how many threads built the levels
+ *        seconds      = how long it took
+ *        cpuSeconds   = the CPU time the threads spent building levels, added up (see CountReport)
+ */
+struct DiagramReport {
+    uint64_t tours = 0;
+    int edges = 0;
+    int frontier = 0;
+    uint64_t nodes = 0;
+    uint64_t peakNodes = 0;
+    int peakLevel = 0;
+    size_t peakBytes = 0;
+    uint64_t spilledBytes = 0;
+    bool spillFailed = false;
+    int threads = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;
+};
+
+bool countDiagramTours(int boardX, int boardY, const DiagramOptions& options, DiagramReport& report);
+
+#endif
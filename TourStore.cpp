@@ -0,0 +1,380 @@
+/* Author: Nathan Burrows
+ * File: TourStore.cpp
+ *
+ * Packing tours, the on-disk tour cache, and the tour database (see TourStore.h).
+ */
+
+#include "TourStore.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Function: packTour()
+ * @desc: Packs a tour into 3 bits per move. Each move is stored as which of the 8 knight's moves it was (an index
+ *        into MOVE_DX/MOVE_DY), so with the starting square known the whole tour can be rebuilt. 3 bits is 64 times
+ *        smaller than storing each square as a pair of ints.
+ * @param1: The tour, as square indexes, passed by reference
+ * @param2: The board's Y dimension
+ * @return: The packed moves, (3 * moves + 7) / 8 bytes long.
+ */
+std::vector<uint8_t> packTour(const std::vector<uint32_t>& tour, int boardY) {
+    size_t moves = tour.empty() ? 0 : tour.size() - 1;
+    std::vector<uint8_t> packed((3 * moves + 7) / 8);
+    for (size_t i = 0; i < moves; i++) {
+        int rows = (int)(tour[i + 1] / boardY) - (int)(tour[i] / boardY);
+        int cols = (int)(tour[i + 1] % boardY) - (int)(tour[i] % boardY);
+        int direction = 0;
+        while (MOVE_DX[direction] != rows || MOVE_DY[direction] != cols) {
+            direction++;
+        }
+        size_t bit = 3 * i;
+        packed[bit / 8] |= direction << (bit % 8);
+        if (bit % 8 > 5) packed[bit / 8 + 1] |= direction >> (8 - bit % 8);
+    }
+    return packed;
+}
+
+/*
+ * Function: unpackTour()
+ * @desc: The inverse of packTour(). Rebuilds the tour from its starting square and packed moves.
+ * @param1: The starting square
+ * @param2: The packed moves
+ * @param3: How many moves were packed
+ * @param4: The board's Y dimension
+ * @param5: Filled with the tour, as square indexes, passed by reference
+ */
+void unpackTour(uint32_t start, const uint8_t* packed, size_t moves, int boardY, std::vector<uint32_t>& tour) {
+    tour.clear();
+    tour.push_back(start);
+    for (size_t i = 0; i < moves; i++) {
+        size_t bit = 3 * i;
+        int direction = packed[bit / 8] >> (bit % 8);
+        if (bit % 8 > 5) direction |= packed[bit / 8 + 1] << (8 - bit % 8);
+        direction &= 7;
+        start += MOVE_DX[direction] * boardY + MOVE_DY[direction];
+        tour.push_back(start);
+    }
+}
+
+/*
+ * Struct: TourFileHeader
+ * @desc: The start of every cache file, followed by the packed moves. The key is stored in full, so a file whose name
+ *        collides with another key's hash is never mistaken for it.
+ */
+struct TourFileHeader {
+    char magic[4] = { 'K', 'T', 'C', '1' };
+    TourKey key;
+    uint32_t reserved = 0;
+    uint64_t moves;
+};
+
+/*
+ * Function: makeTourKey()
+ * @desc: Builds the cache key for a canonical problem.
+ * @param1: The canonical problem, passed by reference
+ * @param2: How it is being searched, passed by reference
+ * @param3: Whether the search is for a closed tour
+ * @return: The key.
+ */
+TourKey makeTourKey(const CanonicalProblem& problem, const SolveOptions& options, bool closed) {
+    TourKey key;
+    key.boardX = problem.boardX;
+    key.boardY = problem.boardY;
+    key.startRow = problem.start.first;
+    key.startCol = problem.start.second;
+    key.algorithm = (uint8_t)options.algorithm;
+    key.heuristic = (uint8_t)options.heuristic;
+    key.closed = closed ? 1 : 0;
+    return key;
+}
+
+/*
+ * Function: findCachePath()
+ * @desc: Works out which file a key lives in, from a 64-bit FNV-1a hash of the key.
+ * @param1: The cache, passed by reference
+ * @param2: The key, passed by reference
+ * @return: The path of the file.
+ */
+std::string findCachePath(const TourCache& cache, const TourKey& key) {
+    uint64_t hash = 14695981039346656037ull;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&key);
+    for (size_t i = 0; i < sizeof(key); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx.tour", (unsigned long long)hash);
+    return cache.directory + "/" + name;
+}
+
+/*
+ * Function: readCachedTour()
+ * @desc: Looks a key up in the cache. The file is memory mapped read-only and decoded straight from the mapping, so
+ *        nothing is locked and nothing but the tour itself is copied.
+ * @param1: The cache, passed by reference
+ * @param2: The key, passed by reference
+ * @param3: Filled with the canonical tour (as square indexes) if it was found, passed by reference
+ * @return: Returns true if the tour was in the cache, false if not.
+ */
+bool readCachedTour(const TourCache& cache, const TourKey& key, std::vector<uint32_t>& tour) {
+    int fd = open(findCachePath(cache, key).c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    bool found = false;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(TourFileHeader)) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            TourFileHeader header;
+            memcpy(&header, mapping, sizeof(header));
+            if (memcmp(header.magic, "KTC1", 4) == 0 && memcmp(&header.key, &key, sizeof(key)) == 0
+                && header.moves < (uint64_t)key.boardX * key.boardY
+                && sizeof(header) + (3 * header.moves + 7) / 8 <= (uint64_t)info.st_size) {
+                unpackTour(key.startRow * key.boardY + key.startCol, static_cast<const uint8_t*>(mapping) + sizeof(header), header.moves, key.boardY, tour);
+                found = true;
+            }
+            munmap(mapping, info.st_size);
+        }
+    }
+    close(fd);
+    return found;
+}
+
+/*
+ * Function: writeCachedTour()
+ * @desc: Stores a tour in the cache. It is written to a temporary file in the same directory, flushed to disk, then
+ *        renamed over the real name, so a crash part way through never leaves a half written tour behind, and readers
+ *        always see either no file or a whole one. Failures are ignored, since the cache is only a shortcut.
+ * @param1: The cache, passed by reference
+ * @param2: The key, passed by reference
+ * @param3: The canonical tour, as square indexes, passed by reference
+ */
+void writeCachedTour(const TourCache& cache, const TourKey& key, const std::vector<uint32_t>& tour) {
+    std::string path = findCachePath(cache, key);
+    std::string temporary = path + "." + std::to_string(getpid()) + "-" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    TourFileHeader header;
+    header.key = key;
+    header.moves = tour.size() - 1;
+    std::vector<uint8_t> packed = packTour(tour, key.boardY);
+    bool written = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header)
+                   && write(fd, packed.data(), packed.size()) == (ssize_t)packed.size()
+                   && fsync(fd) == 0;
+    close(fd);
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return;
+    }
+    //make the rename itself durable
+    int directory = open(cache.directory.c_str(), O_RDONLY);
+    if (directory >= 0) {
+        fsync(directory);
+        close(directory);
+    }
+}
+
+
+/*
+ * Struct: TourDatabaseHeader
+ * @desc: The start of a tour database file.
+ */
+struct TourDatabaseHeader {
+    char magic[4] = { 'K', 'T', 'D', '1' };
+    uint32_t version = SEARCH_VERSION;
+    uint32_t maxSize = 0;
+    uint8_t algorithm = 0;
+    uint8_t heuristic = 0;
+    uint16_t padding = 0;
+};
+
+/*
+ * Function: openTourDatabase()
+ * @desc: Memory maps a tour database file and checks it was built by this version of the searches.
+ * @param1: The path of the file, passed by reference
+ * @param2: Filled with the database, passed by reference
+ * @return: Returns true if the database can be used, false if not.
+ */
+bool openTourDatabase(const std::string& path, TourDatabase& database) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(TourDatabaseHeader)) {
+        mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    TourDatabaseHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    size_t tableEnd = sizeof(header) + (size_t)header.maxSize * header.maxSize * sizeof(uint64_t);
+    if (memcmp(header.magic, "KTD1", 4) != 0 || header.version != SEARCH_VERSION || tableEnd > (size_t)info.st_size) {
+        munmap(mapping, info.st_size);
+        return false;
+    }
+    database.data = static_cast<const uint8_t*>(mapping);
+    database.size = info.st_size;
+    database.maxSize = header.maxSize;
+    database.algorithm = (Algorithm)header.algorithm;
+    database.heuristic = (Heuristic)header.heuristic;
+    return true;
+}
+
+/*
+ * Function: closeTourDatabase()
+ * @desc: Unmaps a tour database.
+ * @param: The database, passed by reference
+ */
+void closeTourDatabase(TourDatabase& database) {
+    if (database.data != nullptr) {
+        munmap(const_cast<uint8_t*>(database.data), database.size);
+    }
+    database = TourDatabase();
+}
+
+/*
+ * Function: readDatabaseOffset()
+ * @desc: Reads one 64-bit offset out of a tour database, checking it is inside the file.
+ * @param1: The database, passed by reference
+ * @param2: Where the offset is stored
+ * @return: The offset, or 0 if it is missing or does not point inside the file.
+ */
+uint64_t readDatabaseOffset(const TourDatabase& database, uint64_t position) {
+    if (position + sizeof(uint64_t) > database.size) return 0;
+    uint64_t offset;
+    memcpy(&offset, database.data + position, sizeof(offset));
+    return (offset + sizeof(uint64_t) <= database.size) ? offset : 0;
+}
+
+/*
+ * Function: readDatabaseTour()
+ * @desc: Looks up the tour for a canonical problem in a tour database. The problem has to match what the database
+ *        was built for (same algorithm and heuristic, board within its size).
+ * @param1: The database, passed by reference
+ * @param2: The canonical problem, passed by reference (for a closed tour, its start is always the corner)
+ * @param3: How it is being searched, passed by reference
+ * @param4: Whether the search is for a closed tour
+ * @param5: Filled with the canonical tour (as square indexes) if it was found, passed by reference
+ * @return: Returns true if the tour was in the database, false if not.
+ */
+bool readDatabaseTour(const TourDatabase& database, const CanonicalProblem& problem, const SolveOptions& options, bool closed,
+                      std::vector<uint32_t>& tour) {
+    if (database.data == nullptr || options.algorithm != database.algorithm || options.heuristic != database.heuristic
+        || problem.boardY > database.maxSize) {
+        return false;
+    }
+    uint64_t boardOffset = readDatabaseOffset(database, sizeof(TourDatabaseHeader)
+                                              + ((uint64_t)(problem.boardX - 1) * database.maxSize + (problem.boardY - 1)) * sizeof(uint64_t));
+    if (boardOffset == 0) return false;
+    uint64_t slot = closed ? (uint64_t)problem.boardX * problem.boardY : (uint64_t)problem.start.first * problem.boardY + problem.start.second;
+    uint64_t tourOffset = readDatabaseOffset(database, boardOffset + slot * sizeof(uint64_t));
+    if (tourOffset == 0) return false;
+    uint64_t moves;
+    memcpy(&moves, database.data + tourOffset, sizeof(moves));
+    if (moves >= (uint64_t)problem.boardX * problem.boardY || tourOffset + sizeof(moves) + (3 * moves + 7) / 8 > database.size) {
+        return false;
+    }
+    unpackTour(problem.start.first * problem.boardY + problem.start.second, database.data + tourOffset + sizeof(moves), moves, problem.boardY, tour);
+    return true;
+}
+
+
+/*
+ * Function: buildTourDatabase()
+ * @desc: Generates a tour database (see TourDatabase) by running the search over every canonical board up to
+ *        maxSize x maxSize: every start in the fundamental domain (see fundamentalStartSquares()), plus the closed tour.
+ *        Problems findImpossibility() rules out are left out, since they never get as far as a lookup. Each board's
+ *        tours are solved on a pool of threads, then written out before the next board starts, so only one board's
+ *        worth is ever held in memory. The file is written under a temporary name and renamed when it is complete.
+ * @param1: The path of the file to make, passed by reference
+ * @param2: The largest board side to include
+ * @param3: The algorithm and heuristic to build it for, passed by reference
+ * @param4: How many threads to solve on. 0 means one per core.
+ * @return: Returns true if the database was written, false if not.
+ */
+bool buildTourDatabase(const std::string& path, int maxSize, const SolveOptions& options, int threadCount) {
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) return false;
+    TourDatabaseHeader header;
+    header.maxSize = maxSize;
+    header.algorithm = (uint8_t)options.algorithm;
+    header.heuristic = (uint8_t)options.heuristic;
+    std::vector<uint64_t> boardTable((size_t)maxSize * maxSize);
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(boardTable.data(), sizeof(uint64_t), boardTable.size(), file);
+    uint64_t position = sizeof(header) + boardTable.size() * sizeof(uint64_t);
+    if (threadCount <= 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int boardX = 1; boardX <= maxSize; boardX++) {
+        for (int boardY = boardX; boardY <= maxSize; boardY++) {
+            //every fundamental start, then the closed tour (which is always searched for from the corner)
+            std::vector<std::pair<int,int>> starts;
+            for (std::pair<int,int> start : fundamentalStartSquares(boardX, boardY)) {
+                if (findImpossibility(boardX, boardY, start, false) == nullptr) starts.push_back(start);
+            }
+            bool closed = findImpossibility(boardX, boardY, std::pair<int,int>(0, 0), true) == nullptr;
+            size_t jobCount = starts.size() + (closed ? 1 : 0);
+            std::vector<std::vector<uint32_t>> tours(jobCount);
+            std::shared_ptr<const Geometry> geometry = findGeometry(boardX, boardY);
+            std::atomic<size_t> nextJob(0);
+            auto solveJobs = [&]() {
+                SearchState state;
+                SearchState scratch;
+                for (size_t i = nextJob.fetch_add(1); i < jobCount; i = nextJob.fetch_add(1)) {
+                    std::pair<int,int> start = i < starts.size() ? starts[i] : std::pair<int,int>(0, 0);
+                    resetSearchState(*geometry, state);
+                    searchTour(*geometry, state, scratch, start.first * boardY + start.second, options, i >= starts.size());
+                    tours[i] = state.tour;
+                }
+            };
+            std::vector<std::thread> workers;
+            for (int t = 1; t < threadCount; t++) {
+                workers.emplace_back([&]() {
+                    nameTraceThread("database worker");
+                    solveJobs();
+                });
+            }
+            solveJobs();
+            for (std::thread& worker : workers) worker.join();
+
+            size_t slots = (size_t)boardX * boardY + 1;
+            std::vector<uint64_t> offsets(slots);
+            boardTable[(size_t)(boardX - 1) * maxSize + (boardY - 1)] = position;
+            uint64_t entry = position + slots * sizeof(uint64_t);
+            std::vector<std::vector<uint8_t>> packed(jobCount);
+            for (size_t i = 0; i < jobCount; i++) {
+                size_t slot = i < starts.size() ? (size_t)starts[i].first * boardY + starts[i].second : slots - 1;
+                offsets[slot] = entry;
+                packed[i] = packTour(tours[i], boardY);
+                entry += sizeof(uint64_t) + packed[i].size();
+            }
+            fwrite(offsets.data(), sizeof(uint64_t), slots, file);
+            for (size_t i = 0; i < jobCount; i++) {
+                uint64_t moves = tours[i].size() - 1;
+                fwrite(&moves, sizeof(moves), 1, file);
+                fwrite(packed[i].data(), 1, packed[i].size(), file);
+            }
+            position = entry;
+        }
+    }
+    fseek(file, sizeof(header), SEEK_SET);
+    fwrite(boardTable.data(), sizeof(uint64_t), boardTable.size(), file);
+    bool written = fflush(file) == 0 && fsync(fileno(file)) == 0 && !ferror(file);
+    fclose(file);
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
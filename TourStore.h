@@ -0,0 +1,87 @@
+/* Author: Nathan Burrows
+ * File: TourStore.h
+ *
+ * Storing tours outside a single run: packing tours into 3 bits per move, the on-disk tour cache, and the precomputed
+ * tour database (and the builder that makes one).
+ */
+
+#ifndef TOURSTORE_H
+#define TOURSTORE_H
+
+#include "KnightTourSolver.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Bumped whenever a change to the searches would give different tours for the same problem, so tours cached by an
+//older version are never handed back.
+const uint32_t SEARCH_VERSION = 6;
+
+//The knight's moves, in the same order findMovesFromSquare() tries them. A stored tour is a list of indexes into these.
+const int MOVE_DX[] = { 2, 1, -1, -2, -2, -1, 1, 2 };
+const int MOVE_DY[] = { 1, 2, 2, 1, -1, -2, -2, -1 };
+
+/*
+ * Struct: TourCache
+ * @desc: A tour cache on disk. Each tour is stored in its own file in the directory, named after a hash of its key
+ *        (see TourKey), so the name alone says where a tour lives and no index has to be kept in sync. Files are only
+ *        ever replaced whole, with a rename, so readers never need a lock.
+ */
+struct TourCache {
+    std::string directory;
+};
+
+/*
+ * Struct: TourKey
+ * @desc: Everything that decides which tour a search finds: the canonical problem, the algorithm and heuristic, and
+ *        whether it was a closed tour search. Two searches with the same key always find the same tour.
+ */
+struct TourKey {
+    int32_t boardX;
+    int32_t boardY;
+    int32_t startRow;
+    int32_t startCol;
+    uint8_t algorithm;
+    uint8_t heuristic;
+    uint8_t closed;
+    uint8_t padding = 0;
+    uint32_t version = SEARCH_VERSION;
+};
+
+/*
+ * Struct: TourDatabase
+ * @desc: A precomputed database of tours, memory mapped from a file made by buildTourDatabase(). It holds the tour
+ *        for every canonical board up to maxSize x maxSize, from every start in the fundamental domain, plus one closed
+ *        tour per board. All for a single algorithm and heuristic.
+ *        The file is laid out as:
+ *          header (TourDatabaseHeader)
+ *          board table: maxSize * maxSize offsets, one per (rows, cols), 0 if the board is not in the file
+ *          for each board: rows * cols + 1 offsets, one per starting square then one for the closed tour, 0 if there
+ *                          is no tour, followed by the tours themselves (a 64-bit move count, then the packed moves)
+ *        so finding a tour is two table reads, and decoding it is unpackTour().
+ */
+struct TourDatabase {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    int maxSize = 0;
+    Algorithm algorithm = Algorithm::Warnsdorff;
+    Heuristic heuristic = Heuristic::Warnsdorff;
+};
+
+std::vector<uint8_t> packTour(const std::vector<uint32_t>& tour, int boardY);
+void unpackTour(uint32_t start, const uint8_t* packed, size_t moves, int boardY, std::vector<uint32_t>& tour);
+
+TourKey makeTourKey(const CanonicalProblem& problem, const SolveOptions& options, bool closed);
+std::string findCachePath(const TourCache& cache, const TourKey& key);
+bool readCachedTour(const TourCache& cache, const TourKey& key, std::vector<uint32_t>& tour);
+void writeCachedTour(const TourCache& cache, const TourKey& key, const std::vector<uint32_t>& tour);
+
+bool openTourDatabase(const std::string& path, TourDatabase& database);
+void closeTourDatabase(TourDatabase& database);
+bool readDatabaseTour(const TourDatabase& database, const CanonicalProblem& problem, const SolveOptions& options, bool closed,
+                      std::vector<uint32_t>& tour);
+bool buildTourDatabase(const std::string& path, int maxSize, const SolveOptions& options, int threadCount);
+
+#endif
@@ -0,0 +1,174 @@
+/* Author: Nathan Burrows
+ * File: Trace.cpp
+ *
+ * Recording trace events and writing them out (see Trace.h).
+ */
+
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> tracing(false);
+
+/*
+ * Struct: TraceBuffer
+ * @desc: One thread's events. Only the thread that owns it writes to it. recorded counts every event ever recorded, so
+ *        event i lives at events[i % TRACE_BUFFER_EVENTS], and the ones before recorded - TRACE_BUFFER_EVENTS are gone.
+ *        thread = the id the thread is shown with
+ *        name   = what the thread is called in the trace, or nullptr for "thread N"
+ */
+struct TraceBuffer {
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> recorded{0};
+    int thread = 0;
+    const char* name = nullptr;
+};
+
+/*
+ * Struct: TraceSession
+ * @desc: Everything tracing shares between threads: every thread's buffer, when tracing started, and the file the trace
+ *        goes to. The mutex is only taken when a thread records its first event and its buffer is added.
+ */
+struct TraceSession {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::chrono::steady_clock::time_point began;
+    FILE* file = nullptr;
+};
+
+/*
+ * Function: traceSession()
+ * @desc: Gets the session. It is never freed, so it is still there when the trace is written at exit, whatever order
+ *        everything else is torn down in.
+ * @return: The session.
+ */
+TraceSession& traceSession() {
+    static TraceSession* session = new TraceSession();
+    return *session;
+}
+
+/*
+ * Function: threadTraceBuffer()
+ * @desc: Gets the calling thread's buffer, making it the first time the thread records anything.
+ * @return: The buffer.
+ */
+TraceBuffer& threadTraceBuffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        std::unique_ptr<TraceBuffer> created(new TraceBuffer());
+        created->events.resize(TRACE_BUFFER_EVENTS);
+        TraceSession& session = traceSession();
+        std::lock_guard<std::mutex> lock(session.mutex);
+        created->thread = session.buffers.size() + 1;
+        buffer = created.get();
+        session.buffers.push_back(std::move(created));
+    }
+    return *buffer;
+}
+
+/*
+ * Function: writeTraceAtExit()
+ * @desc: writeTrace() in the form std::atexit() takes.
+ */
+void writeTraceAtExit() {
+    writeTrace();
+}
+
+/*
+ * Function: startTracing()
+ * @desc: Turns tracing on. The file is opened straight away, so a path that cannot be written is found before any work
+ *        is done, and the trace is written to it when the program exits.
+ * @param: The path to write the trace to, passed by reference
+ * @return: Returns true if tracing was started, false if the file could not be opened.
+ */
+bool startTracing(const std::string& path) {
+    TraceSession& session = traceSession();
+    session.file = fopen(path.c_str(), "w");
+    if (session.file == nullptr) return false;
+    session.began = std::chrono::steady_clock::now();
+    tracing.store(true, std::memory_order_relaxed);
+    std::atexit(writeTraceAtExit);
+    return true;
+}
+
+/*
+ * Function: traceNow()
+ * @desc: Gets the time on the trace's clock.
+ * @return: Nanoseconds since tracing started.
+ */
+uint64_t traceNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceSession().began).count();
+}
+
+/*
+ * Function: recordTraceEvent()
+ * @desc: Adds an event to the calling thread's buffer. Nothing is shared with any other thread, so there is no lock.
+ * @param1/param2: The event's name and category (string literals)
+ * @param3/param4: When it started and how long it took, in nanoseconds on the trace's clock
+ * @param5: Something to say about it, or -1 for nothing
+ */
+void recordTraceEvent(const char* name, const char* category, uint64_t start, uint64_t duration, int64_t value) {
+    TraceBuffer& buffer = threadTraceBuffer();
+    uint64_t recorded = buffer.recorded.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer.events[recorded % TRACE_BUFFER_EVENTS];
+    event.name = name;
+    event.category = category;
+    event.start = start;
+    event.duration = duration;
+    event.value = value;
+    buffer.recorded.store(recorded + 1, std::memory_order_release);
+}
+
+/*
+ * Function: nameTraceThread()
+ * @desc: Sets what the calling thread is called in the trace. Does nothing if tracing is off.
+ * @param: The name (a string literal)
+ */
+void nameTraceThread(const char* name) {
+    if (tracingEnabled()) threadTraceBuffer().name = name;
+}
+
+/*
+ * Function: writeTrace()
+ * @desc: Turns tracing off and writes every thread's events to the trace file as Chrome trace JSON: one complete ("X")
+ *        event each, times in microseconds, plus a name for every thread. It runs by itself at exit, once every other
+ *        thread has finished; calling it again does nothing.
+ * @return: Returns true if the trace was written, false if not.
+ */
+bool writeTrace() {
+    TraceSession& session = traceSession();
+    if (session.file == nullptr) return false;
+    tracing.store(false, std::memory_order_relaxed);
+    FILE* file = session.file;
+    session.file = nullptr;
+    std::lock_guard<std::mutex> lock(session.mutex);
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"KnightTour\"}}");
+    for (const std::unique_ptr<TraceBuffer>& buffer : session.buffers) {
+        uint64_t recorded = buffer->recorded.load(std::memory_order_acquire);
+        uint64_t first = recorded > TRACE_BUFFER_EVENTS ? recorded - TRACE_BUFFER_EVENTS : 0;
+        if (buffer->name != nullptr) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\",\"dropped\":%llu}}",
+                    buffer->thread, buffer->name, (unsigned long long)first);
+        }
+        else {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\",\"dropped\":%llu}}",
+                    buffer->thread, buffer->thread, (unsigned long long)first);
+        }
+        for (uint64_t i = first; i < recorded; i++) {
+            const TraceEvent& event = buffer->events[i % TRACE_BUFFER_EVENTS];
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+                    event.name, event.category, event.start / 1000.0, event.duration / 1000.0, buffer->thread);
+            if (event.value >= 0) fprintf(file, ",\"args\":{\"value\":%lld}", (long long)event.value);
+            fprintf(file, "}");
+        }
+    }
+    fprintf(file, "\n]}\n");
+    bool written = fflush(file) == 0 && !ferror(file);
+    return fclose(file) == 0 && written;
+}
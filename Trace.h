@@ -0,0 +1,87 @@
+/* Author: Nathan Burrows
+ * File: Trace.h
+ *
+ * A timeline of what the solver is doing on every thread, written as Chrome trace JSON (the format chrome://tracing and
+ * ui.perfetto.dev open) when the program exits (see --trace). Tracing is off unless startTracing() is called, and then
+ * a TraceScope costs a single check. Once it is on, each thread records into its own ring buffer, so recording never
+ * takes a lock or waits on another thread; when a buffer fills, its oldest events are overwritten.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//How many events each thread keeps. Older ones are overwritten once a thread has recorded more than this.
+const size_t TRACE_BUFFER_EVENTS = 1 << 16;
+
+//How many levels of the backtracking search get their own event (see searchClosedTour()). Deeper levels are far too
+//many and too short to be worth recording.
+const int TRACE_SUBTREE_DEPTH = 3;
+
+/*
+ * Struct: TraceEvent
+ * @desc: One thing that happened on a thread. Names and categories are string literals, so only the pointer is kept.
+ *        name     = what happened
+ *        category = which part of the program it was in (setup, search, restart, backtrack, render or output)
+ *        start    = when it started, in nanoseconds since tracing started
+ *        duration = how long it took, in nanoseconds
+ *        value    = something to say about it (a board size, a tour length, a depth), or -1 for nothing
+ */
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    uint64_t start;
+    uint64_t duration;
+    int64_t value;
+};
+
+extern std::atomic<bool> tracing;
+
+/*
+ * Function: tracingEnabled()
+ * @desc: Finds if events are being recorded.
+ * @return: Returns true if they are, false if not.
+ */
+inline bool tracingEnabled() {
+    return tracing.load(std::memory_order_relaxed);
+}
+
+bool startTracing(const std::string& path);
+uint64_t traceNow();
+void recordTraceEvent(const char* name, const char* category, uint64_t start, uint64_t duration, int64_t value);
+void nameTraceThread(const char* name);
+bool writeTrace();
+
+/*
+ * Class: TraceScope
+ * @desc: Records an event that lasts from its construction to its destruction, if tracing is on.
+ */
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* category, int64_t value = -1)
+        : name(name), category(category), value(value), active(tracingEnabled()), began(active ? traceNow() : 0) {}
+    ~TraceScope() {
+        if (active) recordTraceEvent(name, category, began, traceNow() - began, value);
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    /*
+     * Function: setValue()
+     * @desc: Changes what the event says about itself, for when it is only known at the end (like a tour's length).
+     * @param: The value
+     */
+    void setValue(int64_t newValue) { value = newValue; }
+
+private:
+    const char* name;
+    const char* category;
+    int64_t value;
+    bool active;
+    uint64_t began;
+};
+
+#endif
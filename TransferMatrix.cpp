@@ -0,0 +1,684 @@
+/* Author: Nathan Burrows
+ * File: TransferMatrix.cpp
+ *
+ * The strip automaton, and counting and finding tours with it (see TransferMatrix.h).
+ *
+ * A profile is taken at the boundary before column i, once every tour move from the columns before i has been
+ * decided. Those columns are then finished with, and the squares of columns i and i + 1 (the frontier) are the only
+ * ones that can still gain moves. The tour so far is a set of paths, and for each frontier square the profile records
+ * 4 bits:
+ *     0      no tour moves yet
+ *     1      two tour moves (finished, in the middle of a path)
+ *     2      one tour move, on a path whose other end is one of the tour's two ends (an open tour's first or last
+ *            square), already in a finished column
+ *     3 + k  one tour move, on a path whose other end is the frontier square with the same k
+ * The squares are numbered column * rows + row, and the path numbers k are renumbered in order of first appearance, so
+ * every profile has one encoding. Above those bits, the profile keeps how many ends of an open tour have been finished
+ * with, and whether the tour is already complete.
+ */
+
+#include "TransferMatrix.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+const int PROFILE_BITS = 4;
+const int PROFILE_ENDPOINTS_SHIFT = 32;
+const uint64_t PROFILE_DONE = 1ull << 34;
+const uint32_t NO_PROFILE = UINT32_MAX;
+
+/*
+ * Struct: StripFrontier
+ * @desc: A profile unpacked while a column is stepped over, covering the three columns i to i + 2 (squares numbered
+ *        column * rows + row, with column counted from i).
+ *        degree    = how many tour moves each square has
+ *        label     = for a square with one, which path it ends (0 for one whose other end is an end of the tour)
+ *        endpoints = how many ends of an open tour have been finished with
+ *        done      = whether the tour is complete, so no more moves can be added
+ *        nextLabel = the next unused path number
+ */
+struct StripFrontier {
+    int rows;
+    int degree[12];
+    int label[12];
+    int endpoints;
+    bool done;
+    int nextLabel;
+};
+
+/*
+ * Function: decodeProfile()
+ * @desc: Unpacks a profile. The third column starts with no moves.
+ * @param1: The profile
+ * @param2: The strip's height
+ * @param3: Filled with the frontier, passed by reference
+ */
+void decodeProfile(uint64_t profile, int rows, StripFrontier& frontier) {
+    frontier.rows = rows;
+    frontier.nextLabel = 1;
+    for (int square = 0; square < 3 * rows; square++) {
+        int code = square < 2 * rows ? (profile >> (PROFILE_BITS * square)) & 15 : 0;
+        frontier.degree[square] = code == 0 ? 0 : (code == 1 ? 2 : 1);
+        frontier.label[square] = code >= 2 ? code - 2 : 0;
+        frontier.nextLabel = std::max(frontier.nextLabel, frontier.label[square] + 1);
+    }
+    frontier.endpoints = (profile >> PROFILE_ENDPOINTS_SHIFT) & 3;
+    frontier.done = (profile & PROFILE_DONE) != 0;
+}
+
+/*
+ * Function: encodeProfile()
+ * @desc: Packs the last two columns of a frontier into the profile for the next boundary, renumbering the paths.
+ * @param: The frontier, passed by reference
+ * @return: The profile.
+ */
+uint64_t encodeProfile(const StripFrontier& frontier) {
+    int renumbered[13] = {};
+    int next = 1;
+    uint64_t profile = 0;
+    for (int square = 0; square < 2 * frontier.rows; square++) {
+        int from = square + frontier.rows;
+        uint64_t code = 0;
+        if (frontier.degree[from] == 2) {
+            code = 1;
+        }
+        else if (frontier.degree[from] == 1) {
+            int label = frontier.label[from];
+            if (label != 0 && renumbered[label] == 0) renumbered[label] = next++;
+            code = 2 + (label == 0 ? 0 : renumbered[label]);
+        }
+        profile |= code << (PROFILE_BITS * square);
+    }
+    profile |= (uint64_t)frontier.endpoints << PROFILE_ENDPOINTS_SHIFT;
+    if (frontier.done) profile |= PROFILE_DONE;
+    return profile;
+}
+
+/*
+ * Function: findPathEnd()
+ * @desc: Finds the other frontier end of the path a square ends.
+ * @param1: The frontier, passed by reference
+ * @param2: The square (one move, on a path numbered other than 0)
+ * @return: The other end.
+ */
+int findPathEnd(const StripFrontier& frontier, int square) {
+    for (int other = 0; other < 3 * frontier.rows; other++) {
+        if (other != square && frontier.degree[other] == 1 && frontier.label[other] == frontier.label[square]) return other;
+    }
+    return -1;
+}
+
+/*
+ * Function: hasLoosePath()
+ * @desc: Finds if any frontier square still ends a path, which rules out the tour having just been completed.
+ * @param: The frontier, passed by reference
+ * @return: Returns true if one does, false if not.
+ */
+bool hasLoosePath(const StripFrontier& frontier) {
+    for (int square = 0; square < 3 * frontier.rows; square++) {
+        if (frontier.degree[square] == 1) return true;
+    }
+    return false;
+}
+
+/*
+ * Function: joinSquares()
+ * @desc: Adds a tour move between two frontier squares, joining up the paths they are on. Joining the two ends of the
+ *        same path closes a cycle, and joining two paths that both already end at ends of the tour completes an open
+ *        tour; either is only allowed as the very last move, with nothing else left loose.
+ * @param1: The frontier, passed by reference
+ * @param2/param3: The squares
+ * @param4: Whether the tour is closed
+ * @return: Returns true if the move can be made, false if not.
+ */
+bool joinSquares(StripFrontier& frontier, int a, int b, bool closed) {
+    if (frontier.done || frontier.degree[a] == 2 || frontier.degree[b] == 2) return false;
+    if (frontier.degree[a] == 0 && frontier.degree[b] == 0) {
+        frontier.label[a] = frontier.label[b] = frontier.nextLabel++;
+        frontier.degree[a] = frontier.degree[b] = 1;
+        return true;
+    }
+    if (frontier.degree[a] == 0 || frontier.degree[b] == 0) {
+        int fresh = frontier.degree[a] == 0 ? a : b;
+        int end = fresh == a ? b : a;
+        frontier.label[fresh] = frontier.label[end];
+        frontier.degree[fresh] = 1;
+        frontier.degree[end] = 2;
+        return true;
+    }
+    int labelA = frontier.label[a];
+    int labelB = frontier.label[b];
+    int endA = labelA != 0 ? findPathEnd(frontier, a) : -1;
+    int endB = labelB != 0 ? findPathEnd(frontier, b) : -1;
+    frontier.degree[a] = frontier.degree[b] = 2;
+    if ((labelA != 0 && labelA == labelB) || (labelA == 0 && labelB == 0)) {
+        if (labelA != 0 && !closed) return false;
+        frontier.done = true;
+        return !hasLoosePath(frontier);
+    }
+    if (labelA == 0) frontier.label[endB] = 0;
+    else if (labelB == 0) frontier.label[endA] = 0;
+    else frontier.label[endB] = labelA;
+    return true;
+}
+
+/*
+ * Function: finishSquare()
+ * @desc: Finishes with a square of the column being stepped over, which can gain no more moves. It has to have two,
+ *        unless it is one of an open tour's two ends (which the start has to be). Finishing the second end of a path
+ *        whose other end is already an end of the tour completes the tour.
+ * @param1: The frontier, passed by reference
+ * @param2: The square
+ * @param3: Whether it is the start of an open tour
+ * @param4: Whether the tour is closed
+ * @return: Returns true if the square can be finished with, false if not.
+ */
+bool finishSquare(StripFrontier& frontier, int square, bool start, bool closed) {
+    int degree = frontier.degree[square];
+    if (degree == 0 || (start && degree != 1)) return false;
+    if (degree == 2) return true;
+    if (closed || frontier.endpoints == 2) return false;
+    frontier.endpoints++;
+    frontier.degree[square] = 2;
+    if (frontier.label[square] == 0) {
+        frontier.done = true;
+        return !hasLoosePath(frontier);
+    }
+    frontier.label[findPathEnd(frontier, square)] = 0;
+    return true;
+}
+
+/*
+ * Function: stepProfile()
+ * @desc: Steps over a column: makes the given tour moves from it, then finishes with its squares.
+ * @param1: The automaton, passed by reference (for its height, kind of tour and moves)
+ * @param2: The profile before the column
+ * @param3: The moves to make, as bits
+ * @param4: The row the start of an open tour is on in this column, or -1
+ * @param5: Set to the profile after the column, passed by reference
+ * @return: Returns true if the step is possible, false if not.
+ */
+bool stepProfile(const StripAutomaton& automaton, uint64_t profile, uint32_t edges, int startRow, uint64_t& next) {
+    StripFrontier frontier;
+    decodeProfile(profile, automaton.rows, frontier);
+    for (size_t i = 0; i < automaton.moves.size(); i++) {
+        if ((edges >> i & 1) == 0) continue;
+        const StripMove& move = automaton.moves[i];
+        if (!joinSquares(frontier, move.fromRow, move.columns * automaton.rows + move.toRow, automaton.closed)) return false;
+    }
+    for (int row = 0; row < automaton.rows; row++) {
+        if (!finishSquare(frontier, row, row == startRow, automaton.closed)) return false;
+    }
+    next = encodeProfile(frontier);
+    return true;
+}
+
+/*
+ * Function: buildStripAutomaton()
+ * @desc: Builds the automaton, by stepping every profile found so far over every kind of column with every set of
+ *        moves, starting from the empty profile, until no new ones turn up.
+ * @param1: The strip's height (3 or 4)
+ * @param2: Whether it is for closed tours
+ * @return: The automaton.
+ */
+std::shared_ptr<StripAutomaton> buildStripAutomaton(int rows, bool closed) {
+    TraceScope trace("buildStripAutomaton", "setup", rows);
+    std::shared_ptr<StripAutomaton> automaton(new StripAutomaton());
+    automaton->rows = rows;
+    automaton->closed = closed;
+    for (int row = 0; row < rows; row++) {
+        for (int columns = 1; columns <= 2; columns++) {
+            for (int direction = -1; direction <= 1; direction += 2) {
+                int toRow = row + direction * (columns == 1 ? 2 : 1);
+                if (toRow >= 0 && toRow < rows) automaton->moves.push_back({ row, toRow, columns });
+            }
+        }
+    }
+    uint32_t nearEdges = 0;
+    for (size_t i = 0; i < automaton->moves.size(); i++) {
+        if (automaton->moves[i].columns == 1) nearEdges |= 1u << i;
+    }
+    uint32_t stepEdges[STRIP_STEP_COUNT] = { (1u << automaton->moves.size()) - 1, nearEdges, 0 };
+    int startRows = closed ? 0 : rows;
+    for (int step = 0; step < STRIP_STEP_COUNT; step++) {
+        automaton->transitions[step].resize(startRows + 1);
+    }
+
+    //how many of each set of moves land on (or leave) each square of the three columns
+    size_t moveSets = (size_t)1 << automaton->moves.size();
+    std::vector<uint8_t> moveCounts(moveSets * 3 * rows, 0);
+    for (size_t edges = 0; edges < moveSets; edges++) {
+        for (size_t i = 0; i < automaton->moves.size(); i++) {
+            if ((edges >> i & 1) == 0) continue;
+            moveCounts[edges * 3 * rows + automaton->moves[i].fromRow]++;
+            moveCounts[edges * 3 * rows + automaton->moves[i].columns * rows + automaton->moves[i].toRow]++;
+        }
+    }
+
+    std::unordered_map<uint64_t, uint32_t> index;
+    automaton->profiles.push_back(0);
+    index[0] = 0;
+    std::vector<uint32_t> candidates;
+    for (uint32_t profile = 0; profile < automaton->profiles.size(); profile++) {
+        uint64_t code = automaton->profiles[profile];
+        //sets of moves that would give a square three moves, or leave a square of the column with none (or, for a closed
+        //tour, one) can never be stepped, so they are ruled out before trying them properly
+        int degrees[12] = {};
+        for (int square = 0; square < 2 * rows; square++) {
+            int squareCode = (code >> (PROFILE_BITS * square)) & 15;
+            degrees[square] = squareCode == 0 ? 0 : (squareCode == 1 ? 2 : 1);
+        }
+        candidates.clear();
+        for (size_t edges = moveSets; edges-- > 0;) {
+            const uint8_t* counts = &moveCounts[edges * 3 * rows];
+            bool possible = true;
+            for (int square = 0; square < 3 * rows && possible; square++) {
+                int degree = degrees[square] + counts[square];
+                possible = degree <= 2 && (square >= rows || degree >= (closed ? 2 : 1));
+            }
+            if (possible) candidates.push_back(edges);
+        }
+        for (int step = 0; step < STRIP_STEP_COUNT; step++) {
+            for (int start = -1; start < startRows; start++) {
+                StripTransitions& transitions = automaton->transitions[step][start + 1];
+                transitions.offsets.push_back(transitions.targets.size());
+                //every subset of the moves this kind of column allows
+                uint32_t allowed = stepEdges[step];
+                for (uint32_t edges : candidates) {
+                    uint64_t next;
+                    if ((edges & ~allowed) == 0 && stepProfile(*automaton, code, edges, start, next)) {
+                        std::unordered_map<uint64_t, uint32_t>::iterator found = index.find(next);
+                        if (found == index.end()) {
+                            found = index.emplace(next, automaton->profiles.size()).first;
+                            automaton->profiles.push_back(next);
+                        }
+                        transitions.targets.push_back(found->second);
+                        transitions.edges.push_back(edges);
+                    }
+                }
+            }
+        }
+    }
+    for (int step = 0; step < STRIP_STEP_COUNT; step++) {
+        for (StripTransitions& transitions : automaton->transitions[step]) {
+            transitions.offsets.push_back(transitions.targets.size());
+        }
+    }
+    uint64_t accepting = PROFILE_DONE | (closed ? 0 : 2ull << PROFILE_ENDPOINTS_SHIFT);
+    std::unordered_map<uint64_t, uint32_t>::iterator found = index.find(accepting);
+    automaton->accepting = found == index.end() ? NO_PROFILE : found->second;
+    trace.setValue(automaton->profiles.size());
+    return automaton;
+}
+
+/*
+ * Function: findStripAutomaton()
+ * @desc: Gets the automaton for a strip height and kind of tour, building it the first time it is asked for. They are
+ *        kept for the rest of the run and shared between threads.
+ * @param1: The strip's height (3 or 4)
+ * @param2: Whether it is for closed tours
+ * @return: The automaton.
+ */
+std::shared_ptr<const StripAutomaton> findStripAutomaton(int rows, bool closed) {
+    static std::mutex mutex;
+    static std::map<std::pair<int,bool>, std::shared_ptr<const StripAutomaton>> automata;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<const StripAutomaton>& automaton = automata[std::pair<int,bool>(rows, closed)];
+    if (automaton == nullptr) automaton = buildStripAutomaton(rows, closed);
+    return automaton;
+}
+
+/*
+ * Function: powerModulo()
+ * @desc: Raises a number to a power, modulo a number below 2^32.
+ * @param1/param2: The number and the power
+ * @param3: The modulus
+ * @return: The result.
+ */
+uint64_t powerModulo(uint64_t base, uint64_t exponent, uint64_t modulus) {
+    uint64_t result = 1 % modulus;
+    base %= modulus;
+    for (; exponent > 0; exponent >>= 1) {
+        if (exponent & 1) result = result * base % modulus;
+        base = base * base % modulus;
+    }
+    return result;
+}
+
+/*
+ * Function: findRecurrence()
+ * @desc: Finds the shortest linear recurrence a sequence follows, modulo a prime (the Berlekamp-Massey algorithm): the
+ *        coefficients c with s[n] = c[0] * s[n - 1] + c[1] * s[n - 2] + ... for every n past the recurrence's length.
+ *        A sequence made by a walk through an automaton with P profiles follows one no longer than P, so 2P terms of
+ *        it are enough to find it.
+ * @param1: The sequence, passed by reference
+ * @param2: The prime modulus (below 2^32)
+ * @return: The coefficients.
+ */
+std::vector<uint64_t> findRecurrence(const std::vector<uint64_t>& sequence, uint64_t modulus) {
+    std::vector<uint64_t> current(1, 1);
+    std::vector<uint64_t> previous(1, 1);
+    int length = 0;
+    int shift = 1;
+    uint64_t previousDiscrepancy = 1;
+    for (size_t n = 0; n < sequence.size(); n++) {
+        uint64_t discrepancy = 0;
+        for (int i = 0; i <= length && i < (int)current.size(); i++) {
+            discrepancy = (discrepancy + current[i] * sequence[n - i]) % modulus;
+        }
+        if (discrepancy == 0) {
+            shift++;
+            continue;
+        }
+        std::vector<uint64_t> saved = current;
+        uint64_t scale = discrepancy * powerModulo(previousDiscrepancy, modulus - 2, modulus) % modulus;
+        if (current.size() < previous.size() + shift) current.resize(previous.size() + shift, 0);
+        for (size_t i = 0; i < previous.size(); i++) {
+            current[i + shift] = (current[i + shift] + modulus - scale * previous[i] % modulus) % modulus;
+        }
+        if (2 * length <= (int)n) {
+            length = n + 1 - length;
+            previous = saved;
+            previousDiscrepancy = discrepancy;
+            shift = 1;
+        }
+        else {
+            shift++;
+        }
+    }
+    current.resize(length + 1, 0);
+    std::vector<uint64_t> coefficients(length);
+    for (int i = 0; i < length; i++) {
+        coefficients[i] = (modulus - current[i + 1]) % modulus;
+    }
+    return coefficients;
+}
+
+/*
+ * Function: reduceByRecurrence()
+ * @desc: Reduces a polynomial in x modulo the recurrence's characteristic polynomial, x^d = c[0] x^(d-1) + ... + c[d-1].
+ * @param1: The polynomial (lowest power first), passed by reference. It is left with d coefficients.
+ * @param2: The recurrence, passed by reference
+ * @param3: The modulus
+ */
+void reduceByRecurrence(std::vector<uint64_t>& polynomial, const std::vector<uint64_t>& recurrence, uint64_t modulus) {
+    size_t order = recurrence.size();
+    for (size_t power = polynomial.size(); power-- > order;) {
+        uint64_t coefficient = polynomial[power];
+        if (coefficient == 0) continue;
+        for (size_t i = 0; i < order; i++) {
+            polynomial[power - 1 - i] = (polynomial[power - 1 - i] + coefficient * recurrence[i]) % modulus;
+        }
+    }
+    polynomial.resize(order, 0);
+}
+
+/*
+ * Function: findRecurrenceTerm()
+ * @desc: Finds a far-off term of a linear recurrence without stepping through the ones before it: x^n is worked out
+ *        modulo the characteristic polynomial by repeated squaring, and its coefficients say how the term is made
+ *        from the first d. This is the same as raising the transfer matrix to the nth power, but on the recurrence's
+ *        d coefficients instead of a matrix over every profile, so it costs O(d^2 log n) rather than O(P^3 log n).
+ * @param1: The sequence's first terms (at least as many as the recurrence is long), passed by reference
+ * @param2: The recurrence, passed by reference
+ * @param3: Which term to find
+ * @param4: The modulus
+ * @return: The term.
+ */
+uint64_t findRecurrenceTerm(const std::vector<uint64_t>& sequence, const std::vector<uint64_t>& recurrence, uint64_t n, uint64_t modulus) {
+    size_t order = recurrence.size();
+    if (n < sequence.size()) return sequence[n];
+    if (order == 0) return 0;
+    std::vector<uint64_t> result(1, 1 % modulus);
+    std::vector<uint64_t> base(2, 0);
+    base[1] = 1 % modulus;
+    reduceByRecurrence(base, recurrence, modulus);
+    reduceByRecurrence(result, recurrence, modulus);
+    auto multiply = [&](const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+        std::vector<uint64_t> product(2 * order, 0);
+        for (size_t i = 0; i < order; i++) {
+            if (a[i] == 0) continue;
+            for (size_t j = 0; j < order; j++) {
+                product[i + j] = (product[i + j] + a[i] * b[j]) % modulus;
+            }
+        }
+        reduceByRecurrence(product, recurrence, modulus);
+        return product;
+    };
+    for (; n > 0; n >>= 1) {
+        if (n & 1) result = multiply(result, base);
+        base = multiply(base, base);
+    }
+    uint64_t term = 0;
+    for (size_t i = 0; i < order; i++) {
+        term = (term + result[i] * sequence[i]) % modulus;
+    }
+    return term;
+}
+
+/*
+ * Function: countStripTours()
+ * @desc: Counts the tours on a strip, modulo a prime. Each tour is counted once, whichever end it is followed from (so
+ *        open tours followed from either end are twice this many). The count for n columns is the number of walks
+ *        through the automaton that step over n - 2 full columns, then the last two, and end complete. Those counts
+ *        follow a linear recurrence in n, which is found from the first few and then jumped along to n.
+ * @param1: The strip's height (3 or 4)
+ * @param2: How many columns it has
+ * @param3: Whether to count closed tours
+ * @param4: The prime to count modulo (below 2^32)
+ * @return: The number of tours, modulo the prime.
+ */
+uint64_t countStripTours(int rows, uint64_t length, bool closed, uint64_t modulus) {
+    TraceScope trace("countStripTours", "search", rows);
+    std::shared_ptr<const StripAutomaton> automaton = findStripAutomaton(rows, closed);
+    size_t profiles = automaton->profiles.size();
+    if (automaton->accepting == NO_PROFILE || length == 0) return 0;
+    const StripTransitions& last = automaton->transitions[STRIP_LAST][0];
+    if (length == 1) {
+        uint64_t count = 0;
+        for (uint32_t i = last.offsets[0]; i < last.offsets[1]; i++) count += last.targets[i] == automaton->accepting;
+        return count % modulus;
+    }
+    //how many ways each profile has of finishing over the last two columns
+    std::vector<uint64_t> finishing(profiles, 0);
+    const StripTransitions& near = automaton->transitions[STRIP_NEAR][0];
+    for (size_t profile = 0; profile < profiles; profile++) {
+        for (uint32_t i = near.offsets[profile]; i < near.offsets[profile + 1]; i++) {
+            uint32_t target = near.targets[i];
+            for (uint32_t j = last.offsets[target]; j < last.offsets[target + 1]; j++) {
+                if (last.targets[j] == automaton->accepting) finishing[profile]++;
+            }
+        }
+        finishing[profile] %= modulus;
+    }
+    //only profiles a walk can reach from the start over full columns, and still finish from, matter; the recurrence
+    //is no longer than how many of those there are
+    const StripTransitions& full = automaton->transitions[STRIP_FULL][0];
+    std::vector<uint8_t> reached(profiles, 0);
+    std::vector<uint32_t> order(1, 0);
+    reached[0] = 1;
+    for (size_t i = 0; i < order.size(); i++) {
+        for (uint32_t j = full.offsets[order[i]]; j < full.offsets[order[i] + 1]; j++) {
+            if (!reached[full.targets[j]]) {
+                reached[full.targets[j]] = 1;
+                order.push_back(full.targets[j]);
+            }
+        }
+    }
+    std::vector<uint8_t> finishable(profiles, 0);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t profile : order) {
+            if (finishable[profile]) continue;
+            bool leads = finishing[profile] != 0;
+            for (uint32_t j = full.offsets[profile]; j < full.offsets[profile + 1] && !leads; j++) {
+                leads = finishable[full.targets[j]] != 0;
+            }
+            if (leads) {
+                finishable[profile] = 1;
+                changed = true;
+            }
+        }
+    }
+    std::vector<uint32_t> useful;
+    for (uint32_t profile : order) {
+        if (finishable[profile]) useful.push_back(profile);
+    }
+
+    std::vector<uint64_t> walks(profiles, 0);
+    std::vector<uint64_t> stepped(profiles, 0);
+    walks[0] = 1;
+    std::vector<uint64_t> sequence;
+    for (size_t m = 0; m < 2 * useful.size() + 2 && m <= length - 2; m++) {
+        uint64_t term = 0;
+        for (uint32_t profile : useful) {
+            term = (term + walks[profile] * finishing[profile]) % modulus;
+        }
+        sequence.push_back(term);
+        for (uint32_t profile : useful) {
+            if (walks[profile] == 0) continue;
+            for (uint32_t i = full.offsets[profile]; i < full.offsets[profile + 1]; i++) {
+                stepped[full.targets[i]] = (stepped[full.targets[i]] + walks[profile]) % modulus;
+            }
+            walks[profile] = 0;
+        }
+        walks.swap(stepped);
+    }
+    return findRecurrenceTerm(sequence, findRecurrence(sequence, modulus), length - 2, modulus);
+}
+
+/*
+ * Struct: StripRun
+ * @desc: A run of columns that are all stepped over the same way, and the sets of profiles a tour can still be
+ *        finished from at each boundary in it. The sets are worked out backwards from the end of the run; since each
+ *        one only depends on the one after it, they soon start repeating, so only the ones up to the first repeat are
+ *        kept.
+ *        step/startRow = how its columns are stepped over
+ *        begin/end     = its columns
+ *        sets          = sets[t] is the set at the boundary t columns before end, up to the first repeat
+ *        cycleStart    = where the repeating part of sets starts (sets[t] for t >= sets.size() is sets[cycleStart +
+ *                        (t - cycleStart) % (sets.size() - cycleStart)])
+ */
+struct StripRun {
+    int step;
+    int startRow;
+    int begin;
+    int end;
+    std::vector<std::vector<uint64_t>> sets;
+    size_t cycleStart = 0;
+
+    const std::vector<uint64_t>& setBefore(int column) const {
+        size_t t = end - column;
+        if (t < sets.size()) return sets[t];
+        return sets[cycleStart + (t - cycleStart) % (sets.size() - cycleStart)];
+    }
+};
+
+/*
+ * Function: findStripTour()
+ * @desc: Finds a tour on a strip, or shows there is none. The columns are split into runs that are stepped over the
+ *        same way (the start's column, if there is one, and the last two are runs of their own), the sets of profiles
+ *        the tour can be finished from are worked out backwards over them, then the tour is walked forwards, taking at
+ *        each column the first step that keeps it finishable. The moves the steps made are then followed from the
+ *        start to give the tour in order.
+ * @param1: The strip's height (3 or 4), which is the board's number of rows
+ * @param2: How many columns it has (at least 2)
+ * @param3/param4: The start's row/col (ignored for a closed tour, which starts in the corner)
+ * @param5: Whether to find a closed tour
+ * @param6: Filled with the tour as square indexes (row * length + col), passed by reference
+ * @return: Returns true if a tour was found, false if there is none.
+ */
+bool findStripTour(int rows, int length, int startRow, int startCol, bool closed, std::vector<uint32_t>& tour) {
+    TraceScope trace("findStripTour", "search", length);
+    std::shared_ptr<const StripAutomaton> automaton = findStripAutomaton(rows, closed);
+    size_t profiles = automaton->profiles.size();
+    if (automaton->accepting == NO_PROFILE || length < 2) return false;
+    if (closed) startCol = -1;
+
+    std::vector<StripRun> runs;
+    auto addRun = [&](int step, int row, int begin, int end) {
+        if (begin < end) runs.push_back({ step, row, begin, end, {}, 0 });
+    };
+    int fullEnd = length - 2;
+    if (startCol >= 0 && startCol < fullEnd) {
+        addRun(STRIP_FULL, -1, 0, startCol);
+        addRun(STRIP_FULL, startRow, startCol, startCol + 1);
+        addRun(STRIP_FULL, -1, startCol + 1, fullEnd);
+    }
+    else {
+        addRun(STRIP_FULL, -1, 0, fullEnd);
+    }
+    addRun(STRIP_NEAR, startCol == length - 2 ? startRow : -1, length - 2, length - 1);
+    addRun(STRIP_LAST, startCol == length - 1 ? startRow : -1, length - 1, length);
+
+    size_t words = (profiles + 63) / 64;
+    std::vector<uint64_t> after(words, 0);
+    after[automaton->accepting / 64] |= 1ull << (automaton->accepting % 64);
+    for (size_t r = runs.size(); r-- > 0;) {
+        StripRun& run = runs[r];
+        const StripTransitions& transitions = automaton->transitions[run.step][run.startRow + 1];
+        std::map<std::vector<uint64_t>, size_t> seen;
+        run.sets.push_back(after);
+        seen[after] = 0;
+        for (int t = 1; t <= run.end - run.begin; t++) {
+            const std::vector<uint64_t>& next = run.sets.back();
+            std::vector<uint64_t> set(words, 0);
+            for (size_t profile = 0; profile < profiles; profile++) {
+                for (uint32_t i = transitions.offsets[profile]; i < transitions.offsets[profile + 1]; i++) {
+                    uint32_t target = transitions.targets[i];
+                    if (next[target / 64] >> (target % 64) & 1) {
+                        set[profile / 64] |= 1ull << (profile % 64);
+                        break;
+                    }
+                }
+            }
+            std::map<std::vector<uint64_t>, size_t>::iterator found = seen.find(set);
+            if (found != seen.end()) {
+                run.cycleStart = found->second;
+                break;
+            }
+            seen[set] = run.sets.size();
+            run.sets.push_back(set);
+        }
+        after = run.setBefore(run.begin);
+    }
+    if ((after[0] & 1) == 0) return false;
+
+    //each square's tour moves, as the squares they go to
+    size_t squares = (size_t)rows * length;
+    std::vector<uint32_t> links(2 * squares, UINT32_MAX);
+    auto link = [&](uint32_t a, uint32_t b) {
+        links[2 * a + (links[2 * a] != UINT32_MAX)] = b;
+        links[2 * b + (links[2 * b] != UINT32_MAX)] = a;
+    };
+    uint32_t profile = 0;
+    for (const StripRun& run : runs) {
+        const StripTransitions& transitions = automaton->transitions[run.step][run.startRow + 1];
+        for (int column = run.begin; column < run.end; column++) {
+            const std::vector<uint64_t>& next = run.setBefore(column + 1);
+            uint32_t i = transitions.offsets[profile];
+            while (!(next[transitions.targets[i] / 64] >> (transitions.targets[i] % 64) & 1)) i++;
+            for (size_t move = 0; move < automaton->moves.size(); move++) {
+                if ((transitions.edges[i] >> move & 1) == 0) continue;
+                const StripMove& strip = automaton->moves[move];
+                link(strip.fromRow * length + column, strip.toRow * length + column + strip.columns);
+            }
+            profile = transitions.targets[i];
+        }
+    }
+
+    tour.clear();
+    tour.reserve(squares);
+    uint32_t square = closed ? 0 : startRow * length + startCol;
+    uint32_t previous = UINT32_MAX;
+    for (size_t i = 0; i < squares; i++) {
+        tour.push_back(square);
+        uint32_t next = links[2 * square] != previous ? links[2 * square] : links[2 * square + 1];
+        previous = square;
+        square = next;
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+/* Author: Nathan Burrows
+ * File: TransferMatrix.h
+ *
+ * Tours on boards with a side of 3 or 4 (strips), worked out column by column (see --algorithm transfer). Since a
+ * knight never jumps more than two columns, everything a partly built tour needs to remember at a column boundary is a
+ * profile of the two columns either side of it: how many tour moves each of their squares has so far, and which of
+ * them are joined to which by the tour so far. There are only a few hundred such profiles, and how one leads to the
+ * next is the same for every column, so they make a finite automaton that is built once per strip height, and a tour
+ * of a 3xn or 4xn board is a walk of n steps through it.
+ *
+ * That gives exact answers where Warnsdorff's rule is weakest: whether a tour exists (from a given start), an actual
+ * tour for strips millions of columns long, and how many tours there are (modulo a prime) for any n up to 10^18.
+ */
+
+#ifndef TRANSFERMATRIX_H
+#define TRANSFERMATRIX_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//The prime counts are taken modulo by default.
+const uint64_t STRIP_COUNT_MODULUS = 1000000007;
+
+/*
+ * Enum: StripStep
+ * @desc: What the columns after the one being stepped over look like: both of the next two there (Full), only the next
+ *        one (Near, the second to last column), or neither (Last).
+ */
+enum StripStep { STRIP_FULL, STRIP_NEAR, STRIP_LAST, STRIP_STEP_COUNT };
+
+/*
+ * Struct: StripTransitions
+ * @desc: Every step the automaton can take over one kind of column, with the start (for an open tour) on a given row
+ *        of it or not. The steps from profile p are targets/edges[offsets[p]] up to [offsets[p + 1]].
+ *        targets = the profile each step leads to
+ *        edges   = the tour moves each step makes from the column, as bits (see StripAutomaton::moves)
+ */
+struct StripTransitions {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<uint16_t> edges;
+};
+
+/*
+ * Struct: StripMove
+ * @desc: One of the knight moves from a column towards the columns after it.
+ *        fromRow = the row it leaves from
+ *        toRow   = the row it lands on
+ *        columns = how many columns on it lands (1 or 2)
+ */
+struct StripMove {
+    int fromRow;
+    int toRow;
+    int columns;
+};
+
+/*
+ * Struct: StripAutomaton
+ * @desc: The automaton for one strip height and kind of tour.
+ *        profiles    = every profile a tour can pass through, encoded (see TransferMatrix.cpp). Profile 0 is the start.
+ *        accepting   = the profile a finished tour ends in
+ *        moves       = the knight moves from a column to the next two
+ *        transitions = the steps for each kind of column, and each row the start can be on (index 0 for no start, r + 1
+ *                      for row r; only open tours have a start)
+ */
+struct StripAutomaton {
+    int rows = 0;
+    bool closed = false;
+    std::vector<uint64_t> profiles;
+    uint32_t accepting = 0;
+    std::vector<StripMove> moves;
+    std::vector<StripTransitions> transitions[STRIP_STEP_COUNT];
+};
+
+std::shared_ptr<const StripAutomaton> findStripAutomaton(int rows, bool closed);
+uint64_t countStripTours(int rows, uint64_t length, bool closed, uint64_t modulus = STRIP_COUNT_MODULUS);
+bool findStripTour(int rows, int length, int startRow, int startCol, bool closed, std::vector<uint32_t>& tour);
+
+#endif
@@ -0,0 +1,364 @@
+/* Author: Nathan Burrows
+ * File: KnightTourBench.cpp
+ *
+ * Benchmarks for the tour engine, printed as JSON so results can be kept and compared over time.
+ * Microbenchmarks time the pieces of the search on their own: findMovesFromSquare(), findMinimumIndex(), the degree
+ * update (visitSquare()/unvisitSquare()) and move selection. Macrobenchmarks time whole tours through
+ * KnightTourSolver, on square boards from 8x8 up to 4096x4096, and sweeps over the starting squares of a board (one
+ * of each set that are the same under the board's symmetries, see fundamentalStartSquares()).
+ * Every result has its moves per second, nanoseconds per move and the peak RSS so far, plus the hardware counters
+ * per move (cycles, instructions, L1 and last level cache misses, branch mispredicts) where the machine allows them
+ * (see PerfCounters.h). For the microbenchmarks a "move" is one call of the piece being timed. Macrobenchmarks also
+ * say how many of their tours covered the whole board, since a tour that gets stuck early makes fewer, cheaper moves.
+ */
+
+#include "KnightTourSolver.h"
+#include "PerfCounters.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+
+/*
+ * Struct: BenchOptions
+ * @desc: What the command line asked for.
+ *        filter     = only run benchmarks whose name contains this
+ *        maxSize    = the largest board side the macrobenchmarks go up to
+ *        minSeconds = how long each benchmark repeats for, at least
+ *        heuristic  = the tie-break the macrobenchmarks solve with. Roth's, since Warnsdorff's gets stuck on most large
+ *                     boards (after 869,355 of the 1,000,000 squares on 1000x1000).
+ *        counters   = the hardware counters to wrap every run in, or nullptr for none
+ */
+struct BenchOptions {
+    std::string filter;
+    int maxSize = 4096;
+    double minSeconds = 0.5;
+    Heuristic heuristic = Heuristic::Roth;
+    PerfCounters* counters = nullptr;
+};
+
+/*
+ * Struct: BenchResult
+ * @desc: One benchmark's result.
+ *        iterations = how many times the body ran
+ *        moves      = how many moves (or calls, for microbenchmarks) all of those made between them
+ *        seconds    = how long they took
+ *        peakRssKb  = the process's peak resident memory once it finished
+ *        counters   = what the hardware counters counted over all the iterations
+ *        tours      = for macrobenchmarks, how many tours all of the iterations solved
+ *        fullTours  = how many of those covered the whole board
+ */
+struct BenchResult {
+    std::string name;
+    std::string kind;
+    long long iterations = 0;
+    long long moves = 0;
+    double seconds = 0;
+    long peakRssKb = 0;
+    PerfSample counters;
+    long long tours = 0;
+    long long fullTours = 0;
+};
+
+/*
+ * Function: keepValue()
+ * @desc: Stops the compiler from optimising away a value a benchmark computed but never uses.
+ * @param: The value
+ */
+template<typename T>
+void keepValue(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/*
+ * Function: findPeakRssKb()
+ * @desc: Reads the process's peak resident memory so far.
+ * @return: The peak, in KB.
+ */
+long findPeakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/*
+ * Function: runBenchmark()
+ * @desc: Runs a benchmark body over and over until it has taken at least minSeconds (and at least once), and adds its
+ *        result to the list. Benchmarks the filter leaves out are skipped.
+ * @param1: The options, passed by reference
+ * @param2: The list to add the result to, passed by reference
+ * @param3: The benchmark's name
+ * @param4: "micro" or "macro"
+ * @param5: How long to keep repeating, in seconds
+ * @param6: The body. It runs one iteration and returns how many moves that made.
+ */
+template<typename Body>
+void runBenchmark(const BenchOptions& options, std::vector<BenchResult>& results, const std::string& name,
+                  const std::string& kind, double minSeconds, Body body) {
+    if (name.find(options.filter) == std::string::npos) return;
+    BenchResult result;
+    result.name = name;
+    result.kind = kind;
+    if (options.counters != nullptr) options.counters->start();
+    std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+    do {
+        result.moves += body();
+        result.iterations++;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+    } while (result.seconds < minSeconds);
+    if (options.counters != nullptr) result.counters = options.counters->stop();
+    result.peakRssKb = findPeakRssKb();
+    results.push_back(result);
+}
+
+/*
+ * Function: countMoves()
+ * @desc: Finds how many moves a tour has, from what solve() returned.
+ * @param: The tour's length, in squares (0 if there was none)
+ * @return: The number of moves.
+ */
+long long countMoves(size_t length) {
+    return length > 0 ? (long long)length - 1 : 0;
+}
+
+/*
+ * Function: printResult()
+ * @desc: Prints one result as a JSON object (without a trailing comma or newline). The hardware counters go in
+ *        "perMove", divided by the number of moves, leaving out any that were not available. If none were, it is null.
+ *        Macrobenchmarks also get "tours" and "fullTours".
+ * @param: The result, passed by reference
+ */
+void printResult(const BenchResult& result) {
+    double movesPerSecond = result.seconds > 0 ? result.moves / result.seconds : 0;
+    double nsPerMove = result.moves > 0 ? result.seconds * 1e9 / result.moves : 0;
+    printf("    {\"name\":\"%s\",\"kind\":\"%s\",\"iterations\":%lld,\"moves\":%lld,\"seconds\":%.6f,"
+           "\"movesPerSecond\":%.1f,\"nsPerMove\":%.3f,\"peakRssKb\":%ld,",
+           result.name.c_str(), result.kind.c_str(), result.iterations, result.moves, result.seconds,
+           movesPerSecond, nsPerMove, result.peakRssKb);
+    if (result.kind == "macro") printf("\"tours\":%lld,\"fullTours\":%lld,", result.tours, result.fullTours);
+    printf("\"perMove\":");
+    bool first = true;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (!result.counters.available[i]) continue;
+        printf("%s\"%s\":%.4f", first ? "{" : ",", PERF_COUNTER_NAMES[i],
+               result.moves > 0 ? (double)result.counters.values[i] / result.moves : 0.0);
+        first = false;
+    }
+    printf(first ? "null}" : "}}");
+}
+
+/*
+ * Function: runMicroBenchmarks()
+ * @desc: Times the pieces of the search on their own, on a 64x64 board.
+ * @param1: The options, passed by reference
+ * @param2: The list to add the results to, passed by reference
+ */
+void runMicroBenchmarks(const BenchOptions& options, std::vector<BenchResult>& results) {
+    const int size = 64;
+    std::vector<std::vector<int>> Board(size, std::vector<int>(size));
+    std::shared_ptr<const Geometry> geometry = findGeometry(size, size);
+    size_t squares = geometry->degrees.size();
+
+    runBenchmark(options, results, "findMovesFromSquare", "micro", options.minSeconds, [&]() {
+        for (int i = 0; i < size; i++) {
+            for (int j = 0; j < size; j++) {
+                std::vector<std::pair<int,int>> moves = findMovesFromSquare(i, j, size, size, Board);
+                keepValue(moves);
+            }
+        }
+        return (long long)squares;
+    });
+
+    //every combination of continuing moves a square can see, in a fixed pseudo-random order
+    std::vector<int> sizeLists(8 * 4096);
+    unsigned int seed = 12345;
+    for (int& value : sizeLists) {
+        seed = seed * 1103515245u + 12345u;
+        value = (seed >> 16) % 9;
+    }
+    runBenchmark(options, results, "findMinimumIndex", "micro", options.minSeconds, [&]() {
+        int total = 0;
+        for (size_t i = 0; i < sizeLists.size(); i += 8) {
+            total += findMinimumIndex(&sizeLists[i], 1 + (int)(i / 8) % 8);
+        }
+        keepValue(total);
+        return (long long)(sizeLists.size() / 8);
+    });
+
+    //visiting then unvisiting every square, along a knight's path so the neighbours are realistic
+    SearchState state;
+    resetSearchState(*geometry, state);
+    makeMove(*geometry, state, 0);
+    std::vector<uint32_t> path = state.tour;
+    runBenchmark(options, results, "degreeUpdate", "micro", options.minSeconds, [&]() {
+        resetSearchState(*geometry, state);
+        for (uint32_t square : path) {
+            visitSquare(*geometry, state, square);
+        }
+        for (size_t i = 0; i < path.size(); i++) {
+            unvisitSquare(*geometry, state);
+        }
+        return (long long)(2 * path.size());
+    });
+
+    //picking the next move from every square of a half finished tour, the way makeMove() does
+    resetSearchState(*geometry, state);
+    for (size_t i = 0; i < path.size() / 2; i++) {
+        visitSquare(*geometry, state, path[i]);
+    }
+    for (Heuristic heuristic : { Heuristic::Warnsdorff, Heuristic::Roth }) {
+        std::string name = (heuristic == Heuristic::Roth) ? "moveSelection/roth" : "moveSelection/warnsdorff";
+        runBenchmark(options, results, name, "micro", options.minSeconds, [&]() {
+            uint32_t moves[8];
+            int sizes[8];
+            long long total = 0;
+            for (uint32_t knight = 0; knight < squares; knight++) {
+                int count = 0;
+                for (uint32_t i = geometry->neighbourStart[knight]; i < geometry->neighbourStart[knight + 1]; i++) {
+                    uint32_t square = geometry->neighbours[i];
+                    if (state.visited[square]) continue;
+                    moves[count] = square;
+                    sizes[count] = state.degrees[square];
+                    count++;
+                }
+                if (count == 0) continue;
+                total += (heuristic == Heuristic::Roth) ? findFurthestMinimumIndex(sizes, moves, count, size, size)
+                                                        : findMinimumIndex(sizes, count);
+            }
+            keepValue(total);
+            return (long long)squares;
+        });
+    }
+}
+
+/*
+ * Function: runMacroBenchmarks()
+ * @desc: Times whole tours with KnightTourSolver, from the corner of every square board from 8x8 up to maxSize (doubling
+ *        each time), then sweeps over the starting squares of the smaller boards. A sweep only solves the fundamental
+ *        starts (see fundamentalStartSquares()), since every other start is one of them rotated or reflected, and
+ *        solve() maps it onto that same search. The board's geometry and starts are set up before the timing starts,
+ *        so only the solving is timed.
+ * @param1: The options, passed by reference
+ * @param2: The list to add the results to, passed by reference
+ */
+void runMacroBenchmarks(const BenchOptions& options, std::vector<BenchResult>& results) {
+    SolveOptions solveOptions;
+    solveOptions.heuristic = options.heuristic;
+    KnightTourSolver solver(solveOptions);
+    std::vector<uint32_t> tour;
+    long long tours = 0;
+    long long fullTours = 0;
+    auto solveFrom = [&](std::pair<int,int> start) {
+        size_t length = solver.solve(start.first, start.second, tour.data());
+        tours++;
+        fullTours += (length == solver.squares()) ? 1 : 0;
+        return countMoves(length);
+    };
+    //the filter has already been checked, so the benchmark just run is the last result
+    auto recordTours = [&]() {
+        results.back().tours = tours;
+        results.back().fullTours = fullTours;
+        tours = 0;
+        fullTours = 0;
+    };
+    for (int size = 8; size <= options.maxSize; size *= 2) {
+        std::string name = "tour/" + std::to_string(size) + "x" + std::to_string(size);
+        if (name.find(options.filter) == std::string::npos) continue;
+        solver.setGeometry(size, size);
+        tour.resize(solver.squares());
+        //big boards take long enough that one run is plenty
+        double minSeconds = (size >= 1024) ? 0 : options.minSeconds;
+        runBenchmark(options, results, name, "macro", minSeconds, [&]() {
+            return solveFrom(std::pair<int,int>(0, 0));
+        });
+        recordTours();
+    }
+    for (int size : { 8, 16, 32, 64 }) {
+        std::string name = "sweep/" + std::to_string(size) + "x" + std::to_string(size);
+        if (size > options.maxSize || name.find(options.filter) == std::string::npos) continue;
+        solver.setGeometry(size, size);
+        tour.resize(solver.squares());
+        std::vector<std::pair<int,int>> starts = fundamentalStartSquares(size, size);
+        runBenchmark(options, results, name, "macro", options.minSeconds, [&]() {
+            long long moves = 0;
+            for (std::pair<int,int> start : starts) {
+                moves += solveFrom(start);
+            }
+            return moves;
+        });
+        recordTours();
+    }
+}
+
+/*
+ * Function: printUsage()
+ * @desc: Prints the command line options.
+ * @param: The name the program was run as
+ */
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --filter TEXT      only run benchmarks whose name contains TEXT\n"
+              << "  --max-size N       the largest board side for the tour benchmarks (default 4096)\n"
+              << "  --min-time S       repeat each benchmark for at least S seconds (default 0.5)\n"
+              << "  --heuristic NAME   roth (default) or warnsdorff, for the tour benchmarks\n"
+              << "  --no-counters      do not read the hardware performance counters" << std::endl;
+}
+
+//Runs the benchmarks asked for, and prints the results as one JSON object.
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    bool useCounters = true;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (option == "--no-counters") {
+            useCounters = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Unknown option or missing value: " << option << " (see --help)" << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--filter") options.filter = value;
+        else if (option == "--max-size") options.maxSize = std::atoi(value.c_str());
+        else if (option == "--min-time") options.minSeconds = std::atof(value.c_str());
+        else if (option == "--heuristic" && (value == "warnsdorff" || value == "roth")) {
+            options.heuristic = (value == "roth") ? Heuristic::Roth : Heuristic::Warnsdorff;
+        }
+        else {
+            std::cerr << "Invalid option: " << option << " " << value << " (see --help)" << std::endl;
+            return 1;
+        }
+    }
+
+    PerfCounters counters;
+    if (useCounters && counters.anyAvailable()) {
+        options.counters = &counters;
+    }
+    else if (useCounters) {
+        std::cerr << "Hardware performance counters are not available here (see perf_event_paranoid), timing only" << std::endl;
+    }
+
+    std::vector<BenchResult> results;
+    runMicroBenchmarks(options, results);
+    runMacroBenchmarks(options, results);
+
+    printf("{\n  \"counters\": %s,\n  \"benchmarks\": [\n", options.counters != nullptr ? "true" : "false");
+    for (size_t i = 0; i < results.size(); i++) {
+        printResult(results[i]);
+        printf(i + 1 < results.size() ? ",\n" : "\n");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,707 @@
+/* Author: Nathan Burrows
+ * File: KnightTourCheck.cpp
+ *
+ * The correctness checks. The exact searches (counting, the transfer matrix and the decision diagram) and the
+ * bookkeeping the backtracking search depends on are easy to break without anything looking wrong, so this runs each of
+ * them on problems whose answers are known, and exits with 1 if any answer is off. ctest runs it (each group of checks
+ * is a test of its own), and no check takes more than a second or so.
+ *
+ *     count/...    the exhaustive tour counter (TourCounter.h), against published counts, over split depths and threads
+ *     strip/...    the transfer matrix (TransferMatrix.h): its counts against the exhaustive counter's, its recurrence
+ *                  against stepping the automaton column by column, and its tours on long strips
+ *     diagram/...  the closed tour decision diagram (TourDiagram.h), against published counts and the transfer matrix's,
+ *                  kept in memory and spilled to files
+ *     search/...   the backtracking search's DegreeIndex and bitboard, against the board after every one of a long run of
+ *                  random moves and undos, its pruning, against a brute force search on small boards with holes, the
+ *                  limited discrepancy search, from the starts where Warnsdorff's rule gets stuck, the closed tours of
+ *                  large boards, which have to be found quickly, holes that leave the colours unbalanced, and the tours
+ *                  read back from the tour cache, against the ones searched for
+ *     abi/...      the C interface (KnightTourC.h): its argument and buffer checks, the move numbers it fills in, and its
+ *                  stats
+ */
+
+#include "KnightTourSolver.h"
+#include "KnightTourC.h"
+#include "TourCounter.h"
+#include "TourDiagram.h"
+#include "TourStore.h"
+#include "TransferMatrix.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Struct: Check
+ * @desc: One check. body runs it, and returns true if it passed, or false with why not in its argument.
+ */
+struct Check {
+    std::string name;
+    std::function<bool(std::string&)> body;
+};
+
+/*
+ * Function: expectCount()
+ * @desc: A helper that compares a count with the known one, and says what went wrong if they differ.
+ * @param1: What was counted, for the message
+ * @param2/param3: The count found and the one expected
+ * @param4: Set to the message if they differ, passed by reference
+ * @return: Returns true if they are the same, false if not.
+ */
+bool expectCount(const std::string& what, uint64_t found, uint64_t expected, std::string& failure) {
+    if (found == expected) return true;
+    failure = what + " is " + std::to_string(found) + ", expected " + std::to_string(expected);
+    return false;
+}
+
+/*
+ * Function: checkTourCounts()
+ * @desc: Counts tours with countTours() and checks them. The counts must not depend on how the search is split up, so
+ *        each board is counted with the default split depth, with none, and with a shallow one over a few threads.
+ * @param1/param2: The board's X/Y dimensions
+ * @param3: Whether to count closed tours
+ * @param4: The starts to count from (row/col, indexed from 0), passed by reference
+ * @param5: The tours expected from each start (directed), passed by reference
+ * @param6: Set to what went wrong, passed by reference
+ * @return: Returns true if every count was right, false if not.
+ */
+bool checkTourCounts(int boardX, int boardY, bool closed, const std::vector<std::pair<int,int>>& starts,
+                     const std::vector<uint64_t>& expected, std::string& failure) {
+    const int splits[][2] = { { 8, 1 }, { 0, 1 }, { 2, 3 } };
+    for (const int* split : splits) {
+        CountOptions options;
+        options.closed = closed;
+        options.splitDepth = split[0];
+        options.threads = split[1];
+        CountReport report;
+        if (!countTours(boardX, boardY, starts, options, report) || report.tours.size() != starts.size()) {
+            failure = "countTours() failed";
+            return false;
+        }
+        for (size_t i = 0; i < starts.size(); i++) {
+            std::string what = "tours from " + std::to_string(starts[i].first + 1) + "," + std::to_string(starts[i].second + 1)
+                               + " (split depth " + std::to_string(split[0]) + ", " + std::to_string(split[1]) + " threads)";
+            if (!expectCount(what, report.tours[i], expected[i], failure)) return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Function: stepStripCount()
+ * @desc: Counts a strip's tours the slow way, by stepping through the automaton one column at a time and adding up the
+ *        walks, as countStripTours() would without its recurrence.
+ * @param1: The automaton, passed by reference
+ * @param2: How many columns the strip has (at least 2)
+ * @return: The number of tours, modulo STRIP_COUNT_MODULUS.
+ */
+uint64_t stepStripCount(const StripAutomaton& automaton, int length) {
+    const StripTransitions& full = automaton.transitions[STRIP_FULL][0];
+    const StripTransitions& near = automaton.transitions[STRIP_NEAR][0];
+    const StripTransitions& last = automaton.transitions[STRIP_LAST][0];
+    size_t profiles = automaton.profiles.size();
+    std::vector<uint64_t> walks(profiles, 0);
+    walks[0] = 1;
+    for (int column = 0; column < length - 2; column++) {
+        std::vector<uint64_t> next(profiles, 0);
+        for (size_t profile = 0; profile < profiles; profile++) {
+            if (walks[profile] == 0) continue;
+            for (uint32_t i = full.offsets[profile]; i < full.offsets[profile + 1]; i++) {
+                next[full.targets[i]] = (next[full.targets[i]] + walks[profile]) % STRIP_COUNT_MODULUS;
+            }
+        }
+        walks.swap(next);
+    }
+    uint64_t count = 0;
+    for (size_t profile = 0; profile < profiles; profile++) {
+        for (uint32_t i = near.offsets[profile]; i < near.offsets[profile + 1]; i++) {
+            uint32_t target = near.targets[i];
+            for (uint32_t j = last.offsets[target]; j < last.offsets[target + 1]; j++) {
+                if (last.targets[j] == automaton.accepting) count = (count + walks[profile]) % STRIP_COUNT_MODULUS;
+            }
+        }
+    }
+    return count;
+}
+
+/*
+ * Function: checkStripTour()
+ * @desc: Finds a tour on a strip with findStripTour() and checks it is one: every square once, knight moves all the
+ *        way, from the start asked for (or for a closed tour, back round to its first square).
+ * @param1/param2: The strip's height and length
+ * @param3/param4: The start's row/col
+ * @param5: Whether to find a closed tour
+ * @param6: Set to what went wrong, passed by reference
+ * @return: Returns true if a valid tour was found, false if not.
+ */
+bool checkStripTour(int rows, int length, int startRow, int startCol, bool closed, std::string& failure) {
+    std::string what = std::to_string(rows) + "x" + std::to_string(length) + (closed ? " closed" : " open") + " tour";
+    std::vector<uint32_t> tour;
+    if (!findStripTour(rows, length, startRow, startCol, closed, tour)) {
+        failure = "no " + what + " found";
+        return false;
+    }
+    size_t squares = (size_t)rows * length;
+    std::vector<uint8_t> seen(squares, 0);
+    bool valid = tour.size() == squares && (closed || tour[0] == (uint32_t)(startRow * length + startCol));
+    for (size_t i = 0; valid && i < tour.size(); i++) {
+        valid = tour[i] < squares && !seen[tour[i]]++ && (i == 0 || isNextToSquare(tour[i - 1], tour[i], length));
+    }
+    valid = valid && (!closed || isNextToSquare(tour.back(), tour.front(), length));
+    if (!valid) failure = what + " is not a valid tour";
+    return valid;
+}
+
+/*
+ * Function: findClosedTourByBruteForce()
+ * @desc: The search searchClosedTour()'s pruning is checked against: every path from the start, in any order, with
+ *        nothing cut short, until one closes.
+ * @param1: The board's geometry, passed by reference
+ * @param2: Which squares are taken (holes and the path so far), passed by reference. It is left as it was.
+ * @param3/param4: The path's last and first squares
+ * @param5: How many squares the path still has to take
+ * @return: Returns true if the path can be finished into a closed tour, false if not.
+ */
+bool findClosedTourByBruteForce(const Geometry& geometry, std::vector<uint8_t>& taken, uint32_t square, uint32_t start, size_t left) {
+    if (left == 0) return isNextToSquare(square, start, geometry.boardY);
+    for (uint32_t i = geometry.neighbourStart[square]; i < geometry.neighbourStart[square + 1]; i++) {
+        uint32_t next = geometry.neighbours[i];
+        if (taken[next]) continue;
+        taken[next] = 1;
+        bool found = findClosedTourByBruteForce(geometry, taken, next, start, left - 1);
+        taken[next] = 0;
+        if (found) return true;
+    }
+    return false;
+}
+
+/*
+ * Function: checkClosedPruning()
+ * @desc: Checks searchClosedTour() finds a closed tour exactly when there is one, on a small board with random holes,
+ *        from a random start. It prunes paths with isDeadPath() (and isFloodSplit() under it) and, with holes,
+ *        isCutApart(), so a prune that cuts off a tour shows up as a miss. The holes take a light square, then a dark one,
+ *        and so on, so boards with an even number of squares and an even number of holes (or odd and odd) keep their
+ *        colours balanced (see findHoleImpossibility()), and most of them still have a tour.
+ * @param1/param2: The board's X/Y dimensions
+ * @param3: How many holes to take
+ * @param4: How many boards to try
+ * @param5: Set to what went wrong, passed by reference
+ * @return: Returns true if the search and the brute force always agreed, false if not.
+ */
+bool checkClosedPruning(int boardX, int boardY, int holeCount, int trials, std::string& failure) {
+    std::shared_ptr<const Geometry> geometry = findGeometry(boardX, boardY);
+    std::mt19937 random(boardX * 1000 + boardY * 10 + holeCount);
+    SearchState state;
+    for (int trial = 0; trial < trials; trial++) {
+        std::vector<uint8_t> taken(geometry->degrees.size(), 0);
+        std::vector<uint32_t> holes;
+        while ((int)holes.size() < holeCount) {
+            uint32_t square = random() % (boardX * boardY);
+            if (!taken[square] && (square / boardY + square % boardY) % 2 == holes.size() % 2) {
+                taken[square] = 1;
+                holes.push_back(square);
+            }
+        }
+        uint32_t start;
+        do start = random() % (boardX * boardY); while (taken[start]);
+        taken[start] = 1;
+        bool expected = findClosedTourByBruteForce(*geometry, taken, start, start, boardX * boardY - holes.size() - 1);
+        for (Heuristic heuristic : { Heuristic::Warnsdorff, Heuristic::Roth }) {
+            resetSearchState(*geometry, state);
+            for (uint32_t hole : holes) blockSquare(*geometry, state, hole);
+            visitSquare(*geometry, state, start);
+            bool found = searchClosedTour(*geometry, state, heuristic, 1ll << 40);
+            if (found != expected || (found && !isClosedTour(boardX, boardY, state.tour.data(), state.tour.size(), state.tour.size()))) {
+                failure = "on " + std::to_string(boardX) + "x" + std::to_string(boardY) + " with " + std::to_string(holes.size())
+                          + " holes from square " + std::to_string(start) + ", the search " + (found ? "found" : "missed")
+                          + " a closed tour the brute force " + (expected ? "found" : "did not");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Function: checkCachedTours()
+ * @desc: Solves every start on every board up to maxSize x maxSize twice with a tour cache (the first solve writes it,
+ *        the second reads it back) and once without, and checks all three give the same tour. Then it checks a file
+ *        holding more moves than its board has squares is never read. The cache lives in a directory made for it, which
+ *        is removed afterwards.
+ * @param1: The largest board side
+ * @param2: Whether to ask for closed tours
+ * @param3: Set to what went wrong, passed by reference
+ * @return: Returns true if the tours all matched, false if not.
+ */
+bool checkCachedTours(int maxSize, bool closed, std::string& failure) {
+    char directory[] = "knighttour-cache-XXXXXX";
+    if (mkdtemp(directory) == nullptr) {
+        failure = "could not make a directory for the cache";
+        return false;
+    }
+    TourCache cache;
+    cache.directory = directory;
+    SolveOptions options;
+    options.closed = closed;
+    KnightTourSolver searched(options);
+    KnightTourSolver cached(options);
+    cached.setCache(&cache);
+    bool passed = true;
+    for (int boardX = 1; passed && boardX <= maxSize; boardX++) {
+        for (int boardY = 1; passed && boardY <= maxSize; boardY++) {
+            searched.setGeometry(boardX, boardY);
+            cached.setGeometry(boardX, boardY);
+            std::vector<uint32_t> expected(boardX * boardY);
+            std::vector<uint32_t> tour(boardX * boardY);
+            for (int square = 0; passed && square < boardX * boardY; square++) {
+                size_t length = searched.solve(square / boardY, square % boardY, expected.data());
+                expected.resize(length);
+                for (int pass = 0; passed && pass < 2; pass++) {
+                    tour.assign(boardX * boardY, 0);
+                    tour.resize(cached.solve(square / boardY, square % boardY, tour.data()));
+                    passed = tour == expected && cached.closed() == searched.closed();
+                }
+                expected.resize(boardX * boardY);
+                if (!passed) {
+                    failure = "the cached tour on " + std::to_string(boardX) + "x" + std::to_string(boardY) + " from square "
+                              + std::to_string(square) + " differs from the one searched for";
+                }
+            }
+        }
+    }
+    //nine moves back and forth between two squares of a 3x3 board
+    TourKey key = makeTourKey(canonicaliseProblem(3, 3, std::pair<int,int>(0, 0)), options, closed);
+    std::vector<uint32_t> bouncing = { 0, 5, 0, 5, 0, 5, 0, 5, 0, 5 };
+    writeCachedTour(cache, key, bouncing);
+    if (passed && readCachedTour(cache, key, bouncing)) {
+        failure = "a cached tour longer than its board was read";
+        passed = false;
+    }
+    DIR* listing = opendir(directory);
+    if (listing != nullptr) {
+        while (struct dirent* entry = readdir(listing)) {
+            if (entry->d_name[0] != '.') unlink((cache.directory + "/" + entry->d_name).c_str());
+        }
+        closedir(listing);
+    }
+    rmdir(directory);
+    return passed;
+}
+
+/*
+ * Function: checkSolvedTour()
+ * @desc: Solves one problem with a KnightTourSolver and checks the tour it gives: every square off the holes once,
+ *        knight moves all the way from the start asked for and, if one was asked for, a closed tour, within a time limit.
+ * @param1: The solver, with its board (and any holes) and options already set, passed by reference
+ * @param2/param3: The start's row/col
+ * @param4: How many seconds the solve may take
+ * @param5: Set to what went wrong, passed by reference
+ * @return: Returns true if the solve gave a valid tour in time, false if not.
+ */
+bool checkSolvedTour(KnightTourSolver& solver, int startRow, int startCol, double seconds, std::string& failure) {
+    bool closed = solver.solveOptions().closed;
+    std::string what = std::to_string(solver.boardX()) + "x" + std::to_string(solver.boardY())
+                       + (closed ? " closed" : " open") + " tour";
+    std::vector<uint32_t> tour(solver.squares());
+    auto started = std::chrono::steady_clock::now();
+    size_t length = solver.solve(startRow, startCol, tour.data());
+    double taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (length != solver.tourSquares() || solver.impossible() || (closed && !solver.closed())) {
+        failure = "no " + what + " found (" + std::to_string(length) + " squares)";
+        return false;
+    }
+    std::vector<uint8_t> seen(solver.squares(), 0);
+    bool valid = tour[0] == (uint32_t)(startRow * solver.boardY() + startCol);
+    for (size_t i = 0; valid && i < length; i++) {
+        valid = tour[i] < seen.size() && !seen[tour[i]]++ && (i == 0 || isNextToSquare(tour[i - 1], tour[i], solver.boardY()));
+    }
+    valid = valid && isClosedTour(solver.boardX(), solver.boardY(), tour.data(), length, solver.tourSquares()) == solver.closed();
+    if (!valid) {
+        failure = what + " is not a valid tour";
+        return false;
+    }
+    if (taken > seconds) {
+        failure = what + " took " + std::to_string(taken) + "s, more than " + std::to_string(seconds) + "s";
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Function: findIndexFault()
+ * @desc: Checks the search state's DegreeIndex (and bitboard, if the board has one) against the board: every square is
+ *        where slot says, the visited squares (tour and holes) come first, every unvisited square is in the bucket of
+ *        its degree, and every degree is what counting its unvisited neighbours gives.
+ * @param1: The board's geometry, passed by reference
+ * @param2: The search state, passed by reference
+ * @return: What is wrong, or an empty string if nothing is.
+ */
+std::string findIndexFault(const Geometry& geometry, const SearchState& state) {
+    const DegreeIndex& index = state.degreeIndex;
+    size_t squares = geometry.degrees.size();
+    if (index.bucketStart[0] != state.tour.size() + state.holes.size()) return "the visited squares are not all before bucket 0";
+    for (int degree = 1; degree < 9; degree++) {
+        if (index.bucketStart[degree] < index.bucketStart[degree - 1]) return "the buckets are out of order";
+    }
+    if (index.bucketStart[8] > squares) return "bucket 8 starts past the end";
+    for (uint32_t at = 0; at < squares; at++) {
+        uint32_t square = index.squares[at];
+        if (index.slot[square] != at) return "square " + std::to_string(square) + " is not where its slot says";
+        int bucket = -1;
+        while (bucket < 8 && at >= index.bucketStart[bucket + 1]) bucket++;
+        int degree = 0;
+        for (uint32_t i = geometry.neighbourStart[square]; i < geometry.neighbourStart[square + 1]; i++) {
+            degree += state.visited[geometry.neighbours[i]] ? 0 : 1;
+        }
+        if (state.degrees[square] != degree) return "square " + std::to_string(square) + " has the wrong degree";
+        if (bucket != (state.visited[square] ? -1 : degree)) return "square " + std::to_string(square) + " is in the wrong bucket";
+        if (geometry.bitboardWords > 0 && ((state.unvisitedBits[square / 64] >> (square % 64)) & 1) == state.visited[square]) {
+            return "square " + std::to_string(square) + " is wrong in the bitboard";
+        }
+    }
+    return "";
+}
+
+/*
+ * Function: checkDegreeIndex()
+ * @desc: Makes a long run of random moves (onto any unvisited square, not just a knight's move away, to reach as many
+ *        different boards as possible) and undos with visitSearchSquare()/unvisitSearchSquare(), and checks the
+ *        DegreeIndex with findIndexFault() after every one.
+ * @param1/param2: The board's X/Y dimensions
+ * @param3: Squares to block as holes first, passed by reference
+ * @param4: How many moves and undos to make
+ * @param5: Set to what went wrong, passed by reference
+ * @return: Returns true if the index stayed right the whole way, false if not.
+ */
+bool checkDegreeIndex(int boardX, int boardY, const std::vector<uint32_t>& holes, int operations, std::string& failure) {
+    std::shared_ptr<const Geometry> geometry = findGeometry(boardX, boardY);
+    SearchState state;
+    resetSearchState(*geometry, state);
+    for (uint32_t hole : holes) blockSquare(*geometry, state, hole);
+    visitSquare(*geometry, state, boardX * boardY - 1);
+    buildDegreeIndex(*geometry, state);
+    if (geometry->bitboardWords > 0) {
+        state.unvisitedBits.assign(geometry->bitboardWords, 0);
+        for (size_t square = 0; square < geometry->degrees.size(); square++) {
+            if (!state.visited[square]) state.unvisitedBits[square / 64] |= 1ull << (square % 64);
+        }
+    }
+    size_t squares = countTourSquares(*geometry, state);
+    std::mt19937 random(boardX * 1000 + boardY);
+    std::string what = std::to_string(boardX) + "x" + std::to_string(boardY) + ": ";
+    for (int operation = 0; operation < operations; operation++) {
+        //mostly forwards, so the board fills up, with runs of undos on the way
+        bool undo = state.tour.size() > 1 && (random() % 3 == 0 || state.tour.size() == squares);
+        if (undo) {
+            unvisitSearchSquare(*geometry, state);
+        }
+        else {
+            uint32_t square;
+            do {
+                square = random() % geometry->degrees.size();
+            } while (state.visited[square]);
+            visitSearchSquare(*geometry, state, square);
+        }
+        std::string fault = findIndexFault(*geometry, state);
+        if (!fault.empty()) {
+            failure = what + fault + " after " + std::to_string(operation + 1) + " moves and undos";
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Function: makeChecks()
+ * @desc: Lists every check.
+ * @return: The checks.
+ */
+std::vector<Check> makeChecks() {
+    std::vector<Check> checks;
+    //5x5 has 1728 directed open tours (Jelliss), 304 of them from a corner and 64 from the centre
+    checks.push_back({ "count/5x5-open", [](std::string& failure) {
+        std::vector<std::pair<int,int>> starts;
+        for (int row = 0; row < 5; row++) {
+            for (int col = 0; col < 5; col++) starts.push_back(std::pair<int,int>(row, col));
+        }
+        CountReport report;
+        CountOptions options;
+        options.threads = 1;
+        if (!countTours(5, 5, starts, options, report)) {
+            failure = "countTours() failed";
+            return false;
+        }
+        uint64_t total = 0;
+        for (uint64_t tours : report.tours) total += tours;
+        return expectCount("open tours on 5x5", total, 1728, failure)
+               && checkTourCounts(5, 5, false, { { 0, 0 }, { 2, 2 } }, { 304, 64 }, failure);
+    } });
+    //6x6 has 9862 closed tours, each through every square in both directions
+    checks.push_back({ "count/6x6-closed", [](std::string& failure) {
+        return checkTourCounts(6, 6, true, { { 0, 0 } }, { 2 * 9862 }, failure);
+    } });
+    //3xn tours, each counted once whichever end it is followed from, the same as the exhaustive counter finds
+    checks.push_back({ "strip/3xn-counts", [](std::string& failure) {
+        const uint64_t open[][2] = { { 4, 8 }, { 5, 0 }, { 6, 0 }, { 7, 52 }, { 8, 396 }, { 9, 560 }, { 10, 3048 }, { 12, 57248 } };
+        const uint64_t closed[][2] = { { 8, 0 }, { 10, 16 }, { 11, 0 }, { 12, 176 } };
+        for (const uint64_t* count : open) {
+            if (!expectCount("open tours on 3x" + std::to_string(count[0]), countStripTours(3, count[0], false), count[1], failure)) return false;
+        }
+        for (const uint64_t* count : closed) {
+            if (!expectCount("closed tours on 3x" + std::to_string(count[0]), countStripTours(3, count[0], true), count[1], failure)) return false;
+        }
+        return true;
+    } });
+    checks.push_back({ "strip/4xn-counts", [](std::string& failure) {
+        const uint64_t open[][2] = { { 4, 0 }, { 5, 82 }, { 6, 744 }, { 7, 6378 }, { 8, 31088 } };
+        for (const uint64_t* count : open) {
+            if (!expectCount("open tours on 4x" + std::to_string(count[0]), countStripTours(4, count[0], false), count[1], failure)) return false;
+        }
+        return expectCount("closed tours on 4x8", countStripTours(4, 8, true), 0, failure);
+    } });
+    //the recurrence has to agree with the automaton it was found from, well past the terms it was found with
+    checks.push_back({ "strip/recurrence", [](std::string& failure) {
+        for (int rows = 3; rows <= 4; rows++) {
+            for (bool closed : { false, true }) {
+                const StripAutomaton& automaton = *findStripAutomaton(rows, closed);
+                for (int length : { 2, 3, 17, 250, 1001 }) {
+                    std::string what = std::string(closed ? "closed" : "open") + " tours on " + std::to_string(rows) + "x" + std::to_string(length);
+                    if (!expectCount(what, countStripTours(rows, length, closed), stepStripCount(automaton, length), failure)) return false;
+                }
+            }
+        }
+        return true;
+    } });
+    checks.push_back({ "strip/long-tours", [](std::string& failure) {
+        std::vector<uint32_t> tour;
+        if (findStripTour(3, 7, 1, 3, false, tour)) {
+            failure = "found an open tour from the centre of 3x7, which has none";
+            return false;
+        }
+        return checkStripTour(3, 200000, 0, 0, false, failure) && checkStripTour(3, 200001, 2, 100000, false, failure)
+               && checkStripTour(4, 200000, 0, 77777, false, failure) && checkStripTour(3, 200000, 0, 0, true, failure)
+               && checkStripTour(4, 5, 0, 0, false, failure);
+    } });
+    //6x6 has 9862 closed tours, and 5x6 has 8; on strips it has to agree with the transfer matrix
+    checks.push_back({ "diagram/closed-counts", [](std::string& failure) {
+        const uint64_t counts[][3] = { { 6, 6, 9862 }, { 5, 6, 8 }, { 3, 12, 176 }, { 4, 8, 0 } };
+        for (const uint64_t* count : counts) {
+            for (int threads : { 1, 3 }) {
+                DiagramOptions options;
+                options.threads = threads;
+                DiagramReport report;
+                std::string what = "closed tours on " + std::to_string(count[0]) + "x" + std::to_string(count[1])
+                                   + " (" + std::to_string(threads) + " threads)";
+                if (!countDiagramTours(count[0], count[1], options, report)) {
+                    failure = "countDiagramTours() failed on " + what;
+                    return false;
+                }
+                if (!expectCount(what, report.tours, count[2], failure)) return false;
+            }
+        }
+        return true;
+    } });
+    //spilling every shard of every level to files (in the working directory) must not change the count
+    checks.push_back({ "diagram/spilled", [](std::string& failure) {
+        DiagramOptions options;
+        options.threads = 2;
+        options.spillDirectory = ".";
+        options.memoryLimit = 1 << 20;
+        DiagramReport report;
+        if (!countDiagramTours(6, 6, options, report)) {
+            failure = report.spillFailed ? "could not spill to the working directory" : "countDiagramTours() failed";
+            return false;
+        }
+        //in memory, its levels take 7MB at most
+        if (report.spilledBytes == 0 || report.peakBytes > 2 * options.memoryLimit) {
+            failure = "spilled " + std::to_string(report.spilledBytes) + " bytes and still took " + std::to_string(report.peakBytes);
+            return false;
+        }
+        return expectCount("closed tours on 6x6, spilled", report.tours, 9862, failure);
+    } });
+    //a board with bitboards, one with holes, and one past MAX_BITBOARD_SQUARES (which has none)
+    checks.push_back({ "search/degree-index", [](std::string& failure) {
+        return checkDegreeIndex(7, 9, {}, 200000, failure) && checkDegreeIndex(8, 8, { 9, 27, 28, 36, 50 }, 100000, failure)
+               && checkDegreeIndex(5, 900, {}, 3000, failure);
+    } });
+    //closed tours of large boards are joined from blocks, and once took minutes rotating one long path
+    checks.push_back({ "search/large-closed", [](std::string& failure) {
+        const int boards[][4] = { { 1000, 1000, 0, 0 }, { 130, 401, 64, 200 }, { 301, 200, 150, 99 } };
+        for (const int* board : boards) {
+            for (Heuristic heuristic : { Heuristic::Warnsdorff, Heuristic::Roth }) {
+                SolveOptions options;
+                options.heuristic = heuristic;
+                options.closed = true;
+                KnightTourSolver solver(options);
+                solver.setGeometry(board[0], board[1]);
+                if (!checkSolvedTour(solver, board[2], board[3], 10, failure)) return false;
+            }
+        }
+        return true;
+    } });
+    //holes that unbalance the colours rule a tour out at once, rather than after the search's whole budget
+    checks.push_back({ "search/hole-colours", [](std::string& failure) {
+        std::vector<uint32_t> tour(64);
+        for (bool closed : { false, true }) {
+            SolveOptions options;
+            options.closed = closed;
+            KnightTourSolver solver(options);
+            solver.setGeometry(8, 8);
+            //one light hole: 31 light squares and 32 dark, so an open tour has to start dark and none can be closed
+            solver.setHoles({ { 4, 4 } });
+            solver.solve(0, 0, tour.data());
+            if (!solver.impossible()) {
+                failure = std::string("8x8 with a hole at 4,4 was not ruled out ") + (closed ? "closed" : "open from 0,0");
+                return false;
+            }
+            if (!closed && !checkSolvedTour(solver, 0, 1, 1, failure)) return false;
+            //one of each colour leaves them balanced
+            solver.setHoles({ { 4, 4 }, { 4, 5 } });
+            if (!checkSolvedTour(solver, 0, 0, 1, failure)) return false;
+            //three dark holes on 6x6 leave three more light squares
+            solver.setGeometry(6, 6);
+            solver.setHoles({ { 0, 1 }, { 2, 3 }, { 5, 4 } });
+            solver.solve(0, 0, tour.data());
+            if (!solver.impossible()) {
+                failure = "6x6 with three dark holes was not ruled out";
+                return false;
+            }
+        }
+        return true;
+    } });
+    //pruning may only ever cut off paths that had no closed tour left in them
+    checks.push_back({ "search/closed-pruning", [](std::string& failure) {
+        return checkClosedPruning(5, 6, 0, 4, failure) && checkClosedPruning(5, 6, 2, 20, failure)
+               && checkClosedPruning(5, 5, 1, 30, failure) && checkClosedPruning(5, 5, 3, 30, failure)
+               && checkClosedPruning(3, 10, 2, 30, failure) && checkClosedPruning(4, 7, 2, 30, failure);
+    } });
+    //the greedy pass gets stuck from some starts on these boards (though never on 6x6), and the discrepancy search has to
+    //finish the tour
+    checks.push_back({ "search/discrepancy", [](std::string& failure) {
+        std::vector<std::pair<int,int>> starts;
+        for (int square = 0; square < 25; square++) starts.push_back(std::pair<int,int>(square / 5, square % 5));
+        CountReport report;
+        CountOptions countOptions;
+        countOptions.threads = 1;
+        if (!countTours(5, 5, starts, countOptions, report)) {
+            failure = "countTours() failed";
+            return false;
+        }
+        std::vector<uint32_t> tour(49);
+        for (int side : { 5, 7 }) {
+            int greedyMisses = 0;
+            for (int square = 0; square < side * side; square++) {
+                //every start on 7x7 the oracle allows has a tour
+                std::pair<int,int> start(square / side, square % side);
+                if (findImpossibility(side, side, start, false) != nullptr || (side == 5 && report.tours[square] == 0)) continue;
+                for (Heuristic heuristic : { Heuristic::Warnsdorff, Heuristic::Roth }) {
+                    SolveOptions options;
+                    options.heuristic = heuristic;
+                    KnightTourSolver greedy(options);
+                    greedy.setGeometry(side, side);
+                    greedyMisses += greedy.solve(start.first, start.second, tour.data()) < greedy.squares() ? 1 : 0;
+                    options.algorithm = Algorithm::LimitedDiscrepancy;
+                    KnightTourSolver solver(options);
+                    solver.setGeometry(side, side);
+                    if (!checkSolvedTour(solver, start.first, start.second, 1, failure)) return false;
+                }
+            }
+            if (greedyMisses == 0) {
+                failure = "Warnsdorff's rule never got stuck on " + std::to_string(side) + "x" + std::to_string(side)
+                          + ", so the discrepancy search was never needed";
+                return false;
+            }
+        }
+        return true;
+    } });
+    //a closed search that fails can leave its path running backwards, and the cache stores paths from their start
+    checks.push_back({ "search/cached-tours", [](std::string& failure) {
+        return checkCachedTours(7, false, failure) && checkCachedTours(7, true, failure);
+    } });
+    checks.push_back({ "abi/solve", [](std::string& failure) {
+        KnightTourHandle* handle = knightTourCreate(nullptr);
+        if (handle == nullptr) {
+            failure = "knightTourCreate() failed";
+            return false;
+        }
+        std::vector<uint32_t> moves(25);
+        bool passed = expectCount("the result with room for 24 squares", knightTourSolve(handle, 5, 5, 0, 0, moves.data(), 24),
+                                  (uint64_t)KNIGHT_TOUR_ERROR_BUFFER, failure)
+                      && expectCount("the result on 65535x65535", knightTourSolve(handle, 65535, 65535, 0, 0, moves.data(), (size_t)-1),
+                                     (uint64_t)KNIGHT_TOUR_ERROR_ARGUMENT, failure)
+                      && expectCount("the tour length on 5x5", knightTourSolve(handle, 5, 5, 0, 0, moves.data(), 25), 25, failure);
+        //every move number once, a knight's move from the one before
+        std::vector<uint32_t> squares(26, 25);
+        for (uint32_t square = 0; passed && square < 25; square++) {
+            passed = moves[square] >= 1 && moves[square] <= 25 && squares[moves[square]] == 25;
+            if (passed) squares[moves[square]] = square;
+        }
+        for (uint32_t move = 2; passed && move <= 25; move++) {
+            passed = isNextToSquare(squares[move - 1], squares[move], 5);
+        }
+        if (!passed && failure.empty()) failure = "the move numbers on 5x5 are not a tour";
+        //a 1x1 board has no closed tour, even though its start covers it
+        KnightTourOptions closed = { KNIGHT_TOUR_ALGORITHM_WARNSDORFF, KNIGHT_TOUR_HEURISTIC_WARNSDORFF, 1 };
+        passed = passed && knightTourSetOptions(handle, &closed) == 0
+                 && expectCount("the tour length on 1x1", knightTourSolve(handle, 1, 1, 0, 0, moves.data(), 1), 1, failure);
+        KnightTourStats stats;
+        passed = passed && knightTourGetStats(handle, &stats, sizeof(stats)) == 0
+                 && expectCount("solves", stats.solves, 2, failure) && expectCount("impossible", stats.impossible, 1, failure)
+                 && expectCount("complete", stats.complete, 1, failure) && expectCount("squares", stats.squares, 26, failure)
+                 && expectCount("lastImpossible", stats.lastImpossible, 1, failure);
+        knightTourDestroy(handle);
+        return passed;
+    } });
+    return checks;
+}
+
+/*
+ * Function: printUsage()
+ * @desc: Prints the command line options.
+ * @param: The name the program was run as
+ */
+void printUsage(const char* program) {
+    printf("Usage: %s [--filter TEXT]\n"
+           "  --filter TEXT          only run checks whose name contains TEXT\n", program);
+}
+
+//Runs every check (or those --filter picks), printing each one's result, and exits with 1 if any failed.
+int main(int argc, char* argv[]) {
+    std::string filter;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else {
+            printUsage(argv[0]);
+            return (option == "--help") ? 0 : 2;
+        }
+    }
+    int run = 0;
+    int failed = 0;
+    for (const Check& check : makeChecks()) {
+        if (check.name.find(filter) == std::string::npos) continue;
+        std::string failure;
+        bool passed = check.body(failure);
+        printf("%-30s %s%s\n", check.name.c_str(), passed ? "ok" : "FAILED: ", failure.c_str());
+        fflush(stdout);
+        run++;
+        failed += passed ? 0 : 1;
+    }
+    if (run == 0) {
+        printf("No checks match --filter %s\n", filter.c_str());
+        return 2;
+    }
+    printf("%d of %d checks passed\n", run - failed, run);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,414 @@
+/* Author: Nathan Burrows
+ * File: KnightTourRegress.cpp
+ *
+ * The performance regression check. It runs a fixed, deterministic set of workloads through KnightTourSolver, compares
+ * their nanoseconds per move and solves per second against a baseline kept in the repository (baseline.json), and
+ * exits with 1 if any of them got slower by more than the threshold, so it can gate changes.
+ *
+ *     8x8/all-starts           an open tour from every square of an 8x8 board
+ *     100x100/random-starts    open tours from 1000 starts on a 100x100 board, picked from a fixed seed, with Roth's
+ *                              tie-break and the limited discrepancy search for the few it gets stuck on
+ *     large/NxN                one open tour from the corner of an NxN board with Roth's tie-break: 10000x10000 when a
+ *                              baseline is recorded, otherwise the size the baseline was recorded at, unless
+ *                              --large-size says
+ *     backtracking/closed      closed tours on 5x6, 8x9, 3x12 and 5x10, which need the backtracking search (the last
+ *                              two used to use up its whole budget, before it cut off dead paths)
+ *
+ * Each workload is timed several times (repeating it until it has run for --min-time each time) and the fastest time is
+ * kept, which filters out most of the noise from everything else running on the machine. The moves made are checked
+ * against the baseline too: the workloads are deterministic, so a different count means the searches have changed and
+ * the baseline needs recording again (with --write-baseline). Every tour has to be complete, since a search that gave
+ * up part way would look faster than one that finished.
+ */
+
+#include "KnightTourSolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef KNIGHTTOUR_BASELINE
+#define KNIGHTTOUR_BASELINE "baseline.json"
+#endif
+
+/*
+ * Struct: RegressOptions
+ * @desc: What the command line asked for.
+ *        baselinePath      = the baseline to compare against
+ *        writeBaselinePath = where to write the results as a new baseline instead of comparing, or empty
+ *        threshold         = how much slower (as a fraction) a workload may get before it counts as a regression
+ *        largeSize         = the side of the board the large workload solves, or 0 for the baseline's (10000 when
+ *                            recording one)
+ *        repeats           = how many times each workload is timed (the fastest is kept)
+ *        minSeconds        = how long each timing repeats the workload for, at least
+ *        filter            = only run workloads whose name contains this
+ */
+struct RegressOptions {
+    std::string baselinePath = KNIGHTTOUR_BASELINE;
+    std::string writeBaselinePath;
+    double threshold = 0.15;
+    int largeSize = 0;
+    int repeats = 5;
+    double minSeconds = 0.2;
+    std::string filter;
+};
+
+/*
+ * Struct: Workload
+ * @desc: One workload. body solves the whole thing once and returns how many moves the tours it found have between
+ *        them; solves is how many tours that is, and fullMoves how many moves they would have if every one were complete.
+ */
+struct Workload {
+    std::string name;
+    long long solves;
+    long long fullMoves;
+    std::function<long long()> body;
+};
+
+/*
+ * Struct: RegressResult
+ * @desc: How fast a workload ran (or ran when the baseline was recorded).
+ */
+struct RegressResult {
+    std::string name;
+    long long solves = 0;
+    long long moves = 0;
+    long long fullMoves = 0;
+    double nsPerMove = 0;
+    double solvesPerSecond = 0;
+};
+
+/*
+ * Function: timeWorkload()
+ * @desc: Times a workload: repeats times, it is run over and over until minSeconds have gone by, and the fastest of
+ *        those is kept.
+ * @param1: The workload, passed by reference
+ * @param2: The options, passed by reference
+ * @return: The result.
+ */
+RegressResult timeWorkload(const Workload& workload, const RegressOptions& options) {
+    RegressResult result;
+    result.name = workload.name;
+    result.solves = workload.solves;
+    result.fullMoves = workload.fullMoves;
+    double bestSeconds = -1;
+    for (int repeat = 0; repeat < options.repeats; repeat++) {
+        long long iterations = 0;
+        double seconds = 0;
+        std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+        do {
+            result.moves = workload.body();
+            iterations++;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+        } while (seconds < options.minSeconds);
+        seconds /= iterations;
+        if (bestSeconds < 0 || seconds < bestSeconds) bestSeconds = seconds;
+    }
+    result.nsPerMove = result.moves > 0 ? bestSeconds * 1e9 / result.moves : 0;
+    result.solvesPerSecond = bestSeconds > 0 ? workload.solves / bestSeconds : 0;
+    return result;
+}
+
+/*
+ * Function: countMoves()
+ * @desc: Finds how many moves a tour has, from what solve() returned.
+ * @param: The tour's length, in squares (0 if there was none)
+ * @return: The number of moves.
+ */
+long long countMoves(size_t length) {
+    return length > 0 ? (long long)length - 1 : 0;
+}
+
+/*
+ * Function: makeWorkloads()
+ * @desc: Sets up the workloads. The solvers are made, and their boards built, here, outside the timing.
+ * @param1: The options, passed by reference
+ * @param2: The solvers the workloads use, passed by reference. They have to outlive the workloads.
+ * @param3: Space for the tours, passed by reference
+ * @return: The workloads, in the order they run.
+ */
+std::vector<Workload> makeWorkloads(const RegressOptions& options, std::vector<std::unique_ptr<KnightTourSolver>>& solvers,
+                                    std::vector<uint32_t>& tour) {
+    std::vector<Workload> workloads;
+    tour.resize(100 * 100);
+    auto wanted = [&](const std::string& name) { return name.find(options.filter) != std::string::npos; };
+    auto addSolver = [&](bool closed, Heuristic heuristic, Algorithm algorithm) {
+        SolveOptions solveOptions;
+        solveOptions.closed = closed;
+        solveOptions.heuristic = heuristic;
+        solveOptions.algorithm = algorithm;
+        solvers.emplace_back(new KnightTourSolver(solveOptions));
+        return solvers.back().get();
+    };
+
+    if (wanted("8x8/all-starts")) {
+        KnightTourSolver* small = addSolver(false, Heuristic::Warnsdorff, Algorithm::Warnsdorff);
+        small->setGeometry(8, 8);
+        workloads.push_back({ "8x8/all-starts", 64, 64 * 63, [small, &tour]() {
+            long long moves = 0;
+            for (int i = 0; i < 8; i++) {
+                for (int j = 0; j < 8; j++) {
+                    moves += countMoves(small->solve(i, j, tour.data()));
+                }
+            }
+            return moves;
+        } });
+    }
+
+    if (wanted("100x100/random-starts")) {
+        std::vector<std::pair<int,int>> starts;
+        unsigned int seed = 12345;
+        for (int i = 0; i < 1000; i++) {
+            seed = seed * 1103515245u + 12345u;
+            int row = (seed >> 16) % 100;
+            seed = seed * 1103515245u + 12345u;
+            starts.push_back(std::pair<int,int>(row, (seed >> 16) % 100));
+        }
+        //the greedy search gets stuck from some of these starts (311 with Warnsdorff's tie-break, 7 with Roth's), and a
+        //partial tour would be timed as if it were whole, so the limited discrepancy search finishes those
+        KnightTourSolver* medium = addSolver(false, Heuristic::Roth, Algorithm::LimitedDiscrepancy);
+        medium->setGeometry(100, 100);
+        long long fullMoves = (long long)starts.size() * (100 * 100 - 1);
+        workloads.push_back({ "100x100/random-starts", (long long)starts.size(), fullMoves, [medium, starts, &tour]() {
+            long long moves = 0;
+            for (std::pair<int,int> start : starts) {
+                moves += countMoves(medium->solve(start.first, start.second, tour.data()));
+            }
+            return moves;
+        } });
+    }
+
+    int largeSize = options.largeSize;
+    std::string largeName = "large/" + std::to_string(largeSize) + "x" + std::to_string(largeSize);
+    if (wanted(largeName)) {
+        KnightTourSolver* large = addSolver(false, Heuristic::Roth, Algorithm::Warnsdorff);
+        large->setGeometry(largeSize, largeSize);
+        tour.resize((size_t)largeSize * largeSize);
+        workloads.push_back({ largeName, 1, (long long)largeSize * largeSize - 1, [large, &tour]() {
+            return countMoves(large->solve(0, 0, tour.data()));
+        } });
+    }
+
+    if (wanted("backtracking/closed")) {
+        KnightTourSolver* backtracking = addSolver(true, Heuristic::Warnsdorff, Algorithm::Warnsdorff);
+        workloads.push_back({ "backtracking/closed", 4, 29 + 71 + 35 + 49, [backtracking, &tour]() {
+            long long moves = 0;
+            for (std::pair<int,int> board : { std::pair<int,int>(5, 6), std::pair<int,int>(8, 9), std::pair<int,int>(3, 12), std::pair<int,int>(5, 10) }) {
+                backtracking->setGeometry(board.first, board.second);
+                moves += countMoves(backtracking->solve(0, 0, tour.data()));
+            }
+            return moves;
+        } });
+    }
+    return workloads;
+}
+
+/*
+ * Function: readJsonNumber()
+ * @desc: Reads a number field out of one line of a baseline file.
+ * @param1: The line, passed by reference
+ * @param2: The field's name
+ * @param3: Set to the number, passed by reference
+ * @return: Returns true if the field was there, false if not.
+ */
+bool readJsonNumber(const std::string& line, const std::string& key, double& value) {
+    size_t found = line.find("\"" + key + "\":");
+    if (found == std::string::npos) return false;
+    value = std::atof(line.c_str() + found + key.size() + 3);
+    return true;
+}
+
+/*
+ * Function: readBaseline()
+ * @desc: Reads a baseline written by writeBaseline(). That always puts one workload per line, so the file is read a
+ *        line at a time rather than with a full JSON parser.
+ * @param1: The path, passed by reference
+ * @param2: Filled with the baseline's results, passed by reference
+ * @param3: Set to the size the large workload was recorded at, passed by reference
+ * @return: Returns true if the baseline was read, false if it could not be opened.
+ */
+bool readBaseline(const std::string& path, std::vector<RegressResult>& baseline, int& largeSize) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        double size = 0;
+        if (readJsonNumber(line, "largeSize", size)) largeSize = (int)size;
+        size_t found = line.find("\"name\":\"");
+        if (found == std::string::npos) continue;
+        size_t start = found + 8;
+        RegressResult result;
+        result.name = line.substr(start, line.find('"', start) - start);
+        double solves = 0;
+        double moves = 0;
+        if (!readJsonNumber(line, "solves", solves) || !readJsonNumber(line, "moves", moves)
+            || !readJsonNumber(line, "nsPerMove", result.nsPerMove) || !readJsonNumber(line, "solvesPerSecond", result.solvesPerSecond)) {
+            continue;
+        }
+        result.solves = (long long)solves;
+        result.moves = (long long)moves;
+        baseline.push_back(result);
+    }
+    return true;
+}
+
+/*
+ * Function: writeBaseline()
+ * @desc: Writes results out as a baseline, one workload per line.
+ * @param1: The path, passed by reference
+ * @param2: The results, passed by reference
+ * @param3: The size the large workload ran at
+ * @return: Returns true if it was written, false if not.
+ */
+bool writeBaseline(const std::string& path, const std::vector<RegressResult>& results, int largeSize) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) return false;
+    fprintf(file, "{\n  \"largeSize\": %d,\n  \"workloads\": [\n", largeSize);
+    for (size_t i = 0; i < results.size(); i++) {
+        const RegressResult& result = results[i];
+        fprintf(file, "    {\"name\":\"%s\",\"solves\":%lld,\"moves\":%lld,\"nsPerMove\":%.3f,\"solvesPerSecond\":%.3f}%s\n",
+                result.name.c_str(), result.solves, result.moves, result.nsPerMove, result.solvesPerSecond,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    bool written = fflush(file) == 0 && !ferror(file);
+    return fclose(file) == 0 && written;
+}
+
+/*
+ * Function: compareResults()
+ * @desc: Prints every result next to its baseline, and says which ones regressed: slower per move, or fewer solves per
+ *        second, by more than the threshold, a different number of moves (a changed search), or tours that are no
+ *        longer complete (which would make it look faster).
+ * @param1: The results, passed by reference
+ * @param2: The baseline, passed by reference
+ * @param3: The threshold, as a fraction
+ * @return: How many workloads regressed.
+ */
+int compareResults(const std::vector<RegressResult>& results, const std::vector<RegressResult>& baseline, double threshold) {
+    int regressions = 0;
+    printf("%-24s %12s %12s %8s %14s %14s %8s  %s\n", "workload", "ns/move", "baseline", "change", "solves/s", "baseline", "change", "result");
+    for (const RegressResult& result : results) {
+        const RegressResult* base = nullptr;
+        for (const RegressResult& candidate : baseline) {
+            if (candidate.name == result.name) base = &candidate;
+        }
+        if (base == nullptr) {
+            printf("%-24s %12.3f %12s %8s %14.1f %14s %8s  no baseline\n", result.name.c_str(), result.nsPerMove, "-", "-",
+                   result.solvesPerSecond, "-", "-");
+            continue;
+        }
+        double moveChange = base->nsPerMove > 0 ? result.nsPerMove / base->nsPerMove - 1 : 0;
+        double throughputChange = base->solvesPerSecond > 0 ? result.solvesPerSecond / base->solvesPerSecond - 1 : 0;
+        const char* verdict = "ok";
+        if (result.moves != result.fullMoves) {
+            verdict = "REGRESSION (incomplete tours)";
+        }
+        else if (result.moves != base->moves) {
+            verdict = "REGRESSION (different moves, record the baseline again if the search changed on purpose)";
+        }
+        else if (moveChange > threshold || throughputChange < -threshold) {
+            verdict = "REGRESSION";
+        }
+        else if (moveChange < -threshold) {
+            verdict = "faster";
+        }
+        if (verdict[0] == 'R') regressions++;
+        printf("%-24s %12.3f %12.3f %+7.1f%% %14.1f %14.1f %+7.1f%%  %s\n", result.name.c_str(), result.nsPerMove, base->nsPerMove,
+               moveChange * 100, result.solvesPerSecond, base->solvesPerSecond, throughputChange * 100, verdict);
+    }
+    return regressions;
+}
+
+/*
+ * Function: printUsage()
+ * @desc: Prints the command line options.
+ * @param: The name the program was run as
+ */
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --baseline FILE        the baseline to compare against (default: the one in the source tree)\n"
+              << "  --write-baseline FILE  record the results as a new baseline instead of comparing\n"
+              << "  --threshold PERCENT    how much slower a workload may get before it fails (default 15)\n"
+              << "  --large-size N         the side of the board for the large workload (default: the baseline's,\n"
+              << "                         or 10000 when recording one)\n"
+              << "  --repeats N            how many times each workload is timed, keeping the fastest (default 5)\n"
+              << "  --min-time S           repeat each timing for at least S seconds (default 0.2)\n"
+              << "  --filter TEXT          only run workloads whose name contains TEXT" << std::endl;
+}
+
+//Runs the workloads, then either records them as the baseline or compares them against it. Exits with 1 if anything
+//regressed, 2 if the options or the baseline were bad.
+int main(int argc, char* argv[]) {
+    RegressOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Unknown option or missing value: " << option << " (see --help)" << std::endl;
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (option == "--baseline") options.baselinePath = value;
+        else if (option == "--write-baseline") options.writeBaselinePath = value;
+        else if (option == "--threshold") options.threshold = std::atof(value.c_str()) / 100;
+        else if (option == "--large-size") options.largeSize = std::atoi(value.c_str());
+        else if (option == "--repeats") options.repeats = std::atoi(value.c_str());
+        else if (option == "--min-time") options.minSeconds = std::atof(value.c_str());
+        else if (option == "--filter") options.filter = value;
+        else {
+            std::cerr << "Invalid option: " << option << " " << value << " (see --help)" << std::endl;
+            return 2;
+        }
+    }
+    std::vector<RegressResult> baseline;
+    int baselineLargeSize = 10000;
+    if (options.writeBaselinePath.empty() && !readBaseline(options.baselinePath, baseline, baselineLargeSize)) {
+        std::cerr << "Could not read baseline: " << options.baselinePath << std::endl;
+        return 2;
+    }
+    if (options.largeSize == 0) options.largeSize = baselineLargeSize;
+    if (options.largeSize < 8 || options.largeSize > 65535 || options.repeats < 1 || options.threshold <= 0) {
+        std::cerr << "Invalid options (see --help)" << std::endl;
+        return 2;
+    }
+    std::vector<std::unique_ptr<KnightTourSolver>> solvers;
+    std::vector<uint32_t> tour;
+    std::vector<Workload> workloads = makeWorkloads(options, solvers, tour);
+    std::vector<RegressResult> results;
+    for (const Workload& workload : workloads) {
+        results.push_back(timeWorkload(workload, options));
+    }
+
+    if (!options.writeBaselinePath.empty()) {
+        for (const RegressResult& result : results) {
+            if (result.moves == result.fullMoves) continue;
+            std::cerr << result.name << " found incomplete tours (" << result.moves << " of " << result.fullMoves
+                      << " moves), so it cannot be a baseline" << std::endl;
+            return 1;
+        }
+        if (!writeBaseline(options.writeBaselinePath, results, options.largeSize)) {
+            std::cerr << "Could not write baseline: " << options.writeBaselinePath << std::endl;
+            return 2;
+        }
+        return 0;
+    }
+    int regressions = compareResults(results, baseline, options.threshold);
+    if (regressions > 0) {
+        printf("%d workload%s regressed (the threshold is %.1f%%)\n", regressions, regressions == 1 ? "" : "s", options.threshold * 100);
+        return 1;
+    }
+    printf("No regressions over %.1f%%\n", options.threshold * 100);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/* Author: Nathan Burrows
+ * File: PerfCounters.cpp
+ *
+ * Hardware performance counters for the benchmarks (see PerfCounters.h).
+ */
+
+#include "PerfCounters.h"
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const char* const PERF_COUNTER_NAMES[PERF_COUNTER_COUNT] = { "cycles", "instructions", "l1dMisses", "llcMisses", "branchMisses" };
+
+/*
+ * Function: openCounter()
+ * @desc: Opens one counter for the calling thread, disabled, counting user space only.
+ * @param1/param2: The counter's perf_event type and config
+ * @return: The counter's file descriptor, or -1 if it is not available.
+ */
+int openCounter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * Function: PerfCounters::PerfCounters()
+ * @desc: Opens every counter that is available. Each one is opened on its own rather than as a group, so one the
+ *        hardware does not have does not take the others down with it.
+ */
+PerfCounters::PerfCounters() {
+    const uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    fds[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[PERF_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE, l1dReadMiss);
+    fds[PERF_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[PERF_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+}
+
+/*
+ * Function: PerfCounters::~PerfCounters()
+ * @desc: Closes the counters.
+ */
+PerfCounters::~PerfCounters() {
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+/*
+ * Function: PerfCounters::anyAvailable()
+ * @return: Returns true if at least one counter could be opened, false if not.
+ */
+bool PerfCounters::anyAvailable() const {
+    for (int fd : fds) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+/*
+ * Function: PerfCounters::start()
+ * @desc: Zeroes the counters and starts them counting.
+ */
+void PerfCounters::start() {
+    for (int fd : fds) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/*
+ * Function: PerfCounters::stop()
+ * @desc: Stops the counters and reads them.
+ * @return: What they counted since start(). A counter that cannot be read is marked unavailable.
+ */
+PerfSample PerfCounters::stop() {
+    PerfSample sample;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t value;
+        if (read(fds[i], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+            sample.values[i] = value;
+            sample.available[i] = true;
+        }
+    }
+    return sample;
+}
@@ -0,0 +1,50 @@
+/* Author: Nathan Burrows
+ * File: PerfCounters.h
+ *
+ * Hardware performance counters for the benchmarks, read through Linux's perf_event_open(). Counters the machine or
+ * the kernel's settings do not allow (perf_event_paranoid, containers, virtual machines) are simply left out, so the
+ * benchmarks still run everywhere, with whatever counters there are.
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <cstdint>
+
+//The counters that are read, in the order PerfCounters keeps them.
+enum PerfCounter { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_BRANCH_MISSES, PERF_COUNTER_COUNT };
+
+//Their names in the JSON output.
+extern const char* const PERF_COUNTER_NAMES[PERF_COUNTER_COUNT];
+
+/*
+ * Struct: PerfSample
+ * @desc: What the counters counted between a start() and a stop(). available says which counters could be opened;
+ *        the values of the others are 0.
+ */
+struct PerfSample {
+    uint64_t values[PERF_COUNTER_COUNT] = {};
+    bool available[PERF_COUNTER_COUNT] = {};
+};
+
+/*
+ * Class: PerfCounters
+ * @desc: The counters for the calling thread, user space only (so they work with the default perf_event_paranoid of 2).
+ *        They are opened once, in the constructor, then start()/stop() reset, enable and read them around a run.
+ */
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool anyAvailable() const;
+    void start();
+    PerfSample stop();
+
+private:
+    int fds[PERF_COUNTER_COUNT];
+};
+
+#endif